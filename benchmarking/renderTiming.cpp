@@ -22,12 +22,13 @@ void RenderImage(string sceneFilename, string outputFileName, int width, int hei
 		Image image(width, height);
 		scene.Render(image, threads);
 
+		double outputScale = 1.0;
 		if (postprocess)
 		{
-			image.Postprocess();
+			outputScale = image.Postprocess(threads, false);
 		}
 
-		image.WriteToDisk(outputFileName);
+		image.WriteToDisk(outputFileName, threads, outputScale);
 	}
 	catch (const EngineException &e)
 	{
@@ -43,6 +44,13 @@ BENCHMARK(Image, Postprocess, 1, 5)
 }
 
 
+BENCHMARK(Image, Postprocess4K, 1, 3)
+{
+	Image image(3840, 2160);
+	image.Postprocess(ThreadEngine::ThreadPool::GetNumberOfProcessors());
+}
+
+
 BENCHMARK(Scene, Render, 1, 5)
 {
 	RenderImage("../../SceneFiles/bhart_01_2012.xml", "temp.png", 100, 100, false);
@@ -53,3 +61,25 @@ BENCHMARK(Scene, RenderPostprocess, 1, 5)
 {
 	RenderImage("../../SceneFiles/bhart_01_2012.xml", "temp.png", 100, 100, true);
 }
+
+
+BENCHMARK(Scene, DeferredReshade, 1, 5)
+{
+	// Only the first render traces primary rays, the rest shade the kept G-buffer again.
+	try
+	{
+		Scene scene("../../SceneFiles/bhart_01_2012.xml", 4, true, false);
+		scene.RenderingMode = RENDER_DEFERRED;
+		int threads = ThreadEngine::ThreadPool::GetNumberOfProcessors();
+
+		Image image(100, 100);
+		for (int i = 0; i < 4; i++)
+		{
+			scene.Render(image, threads);
+		}
+	}
+	catch (const EngineException &e)
+	{
+		cerr << "Error rendering scene: " << e.what() << endl;
+	}
+}
@@ -122,7 +122,7 @@ Timer::Timer( bool enable_high_res_timer )
       FILE *fp = fopen( "/proc/cpuinfo", "r" );
       
       double cpu_mhz=0.0f;
-      while( fgets( buff, sizeof( buff ), fp ) > 0 )
+      while( fgets( buff, sizeof( buff ), fp ) != NULL )
 	{
 	  if( !strncmp( buff, "cpu MHz", strlen( "cpu MHz" )))
 	    {
@@ -60,6 +60,7 @@ void XMLSceneParser::f_parse()
       // property for determining background
       retrieveProperty("bgColor", cur_node, nodeData["scene_bgcolor"]);  
       retrieveProperty("envmapPrefix", cur_node, nodeData["scene_envmapprefix"]);  
+      retrieveProperty("lightSamples", cur_node, nodeData["scene_lightsamples"]);
 
       // Scene prop creation/initialization
       SceneElementCreator *creator = m_elemCallbackMap["sceneprops"];
@@ -478,6 +479,7 @@ void XMLSceneParser::parseShader(xmlNode *nPtr, std::map<std::string, SceneDataC
   nodeData["shader_phongExp"] = SceneDataContainer::emptyElem("phongExp");
   nodeData["shader_mirrorCoef"] = SceneDataContainer::emptyElem("mirrorCoef");
   nodeData["shader_roughness"] = SceneDataContainer::emptyElem("roughness");
+  nodeData["shader_noiseResolution"] = SceneDataContainer::emptyElem("noiseResolution");
 
   //
   // Attempt to set the correct values in the properties and elements
@@ -495,6 +497,7 @@ void XMLSceneParser::parseShader(xmlNode *nPtr, std::map<std::string, SceneDataC
       retrieveElementData("phongExp", currNodePtr, nodeData["shader_phongExp"]);
       retrieveElementData("mirrorCoef", currNodePtr, nodeData["shader_mirrorCoef"]);
       retrieveElementData("roughness", currNodePtr, nodeData["shader_roughness"]);
+      retrieveElementData("noiseResolution", currNodePtr, nodeData["shader_noiseResolution"]);
       
       currNodePtr = currNodePtr->next;
     }
@@ -27,9 +27,14 @@ using namespace sivelab;
 GraphicsArgs::GraphicsArgs()
 	: verbose(false), width(100), height(100),
 	  aspectRatio(1.0), useShadow(true), bgColor(0.0, 0.0, 0.0),
-	  useDepthOfField(false), doHdr(false),
+	  useDepthOfField(false), doHdr(false), gamma(1.0), bandRows(0),
 	  depthOfFieldDistance(0),
 	  numCpus(-1), rpp(1), splitMethod("objectMedian"),
+	  renderMode("recursive"), sampler("sobol"),
+	  adaptive(false), minRpp(4), adaptiveThreshold(0.01), sampleCountFileName(""),
+	  edgeAware(false), edgeAngle(20.0), edgeReport(false),
+	  lightSamples(-1), rouletteThreshold(0.0), decoupledShading(false), shadingCellSize(-1.0), tileSize(16), tileOrder("hilbert"), hitCacheFileName(""),
+	  progressive(false), timeBudget(0.0), checkpointFileName(""), checkpointInterval(0.0),
 	  inputFileName(""), outputFileName("")
 {
 }
@@ -50,6 +55,28 @@ void GraphicsArgs::process(int argc, char *argv[])
 	argParser.reg("rpp", "rays per pixel (default is 1)", ArgumentParsing::INT, 'r');
 	argParser.reg("split", "split method for bvh construction (default is objectMedian)", ArgumentParsing::STRING, 's');
 	argParser.reg("hdr-bloom", "HDR bloom (default is off)", ArgumentParsing::NONE, 'b');
+	argParser.reg("gamma", "gamma to encode the output image with (default is 1.0, or linear)", ArgumentParsing::FLOAT);
+	argParser.reg("band-rows", "render and write the output a band of this many rows at a time, to keep huge images out of memory (default is 0, or off)", ArgumentParsing::INT);
+	argParser.reg("mode", "rendering mode, either recursive, wavefront or deferred (default is recursive)", ArgumentParsing::STRING, 'm');
+	argParser.reg("sampler", "sampler, either jittered, sobol, halton or bluenoise (default is sobol)", ArgumentParsing::STRING);
+	argParser.reg("adaptive", "adaptive sampling, where rpp is the most rays per pixel (default is off)", ArgumentParsing::NONE);
+	argParser.reg("min-rpp", "rays per pixel before adaptive sampling checks for convergence, and between checks (default is 4)", ArgumentParsing::INT);
+	argParser.reg("adaptive-threshold", "confidence interval of the luminance that stops adaptive sampling (default is 0.01)", ArgumentParsing::FLOAT);
+	argParser.reg("sample-counts", "file name to write an image of the number of samples in each pixel to", ArgumentParsing::STRING);
+	argParser.reg("edge-aware", "only supersample pixels on the edges of objects (default is off)", ArgumentParsing::NONE);
+	argParser.reg("edge-angle", "angle in degrees between neighboring normals that counts as an edge (default is 20)", ArgumentParsing::FLOAT);
+	argParser.reg("edge-report", "render with full supersampling too, and report the time and quality of edge-aware supersampling against it", ArgumentParsing::NONE);
+	argParser.reg("light-samples", "lights picked at random per shading point, overriding the scene's lightSamples (0 uses every light)", ArgumentParsing::INT);
+	argParser.reg("roulette", "reflection throughput below which paths are stopped at random with Russian roulette (default is 0.0, which is off)", ArgumentParsing::FLOAT);
+	argParser.reg("decoupled-shading", "share the shading of samples that hit the same diffuse primitive in a pixel (default is off)", ArgumentParsing::NONE);
+	argParser.reg("shading-cell", "size of the cubes that decoupled shading shares colors within, or 0 for the whole primitive (default is about half a pixel)", ArgumentParsing::FLOAT);
+	argParser.reg("tile-size", "width and height of the tiles that threads render (default is 16)", ArgumentParsing::INT);
+	argParser.reg("tile-order", "order tiles are handed out in, either hilbert, morton or scanline (default is hilbert)", ArgumentParsing::STRING);
+	argParser.reg("hit-cache", "file to keep primary hits and their shadows in between runs, so only shading is redone (implies deferred mode)", ArgumentParsing::STRING);
+	argParser.reg("progressive", "progressive rendering, one sample per pixel at a time until rpp or the time budget is reached (default is off)", ArgumentParsing::NONE);
+	argParser.reg("time-budget", "seconds a progressive render is allowed to take (default is 0, or no limit)", ArgumentParsing::FLOAT);
+	argParser.reg("checkpoint", "file name that progressive rendering writes checkpoints to, on SIGUSR1 or every checkpoint-interval", ArgumentParsing::STRING);
+	argParser.reg("checkpoint-interval", "seconds between progressive rendering checkpoints (default is 0, or only on SIGUSR1)", ArgumentParsing::FLOAT);
 
 	argParser.processCommandLineArgs(argc, argv);
 
@@ -64,6 +91,12 @@ void GraphicsArgs::process(int argc, char *argv[])
 	doHdr = argParser.isSet("hdr-bloom");
 	if (verbose) std::cout << "HDR bloom: ON" << std::endl;
 
+	argParser.isSet("gamma", gamma);
+	if (verbose) std::cout << "Setting output gamma to " << gamma << std::endl;
+
+	argParser.isSet("band-rows", bandRows);
+	if (verbose) std::cout << "Setting band rows to " << bandRows << std::endl;
+
 	argParser.isSet("width", width);
 	if (verbose) std::cout << "Setting width to " << width << std::endl;
 
@@ -88,6 +121,66 @@ void GraphicsArgs::process(int argc, char *argv[])
 	argParser.isSet("split", splitMethod);
 	if (verbose) std::cout << "Setting split method to " << splitMethod << std::endl;
 
+	argParser.isSet("mode", renderMode);
+	if (verbose) std::cout << "Setting render mode to " << renderMode << std::endl;
+
+	argParser.isSet("sampler", sampler);
+	if (verbose) std::cout << "Setting sampler to " << sampler << std::endl;
+
+	adaptive = argParser.isSet("adaptive");
+	if (verbose && adaptive) std::cout << "Adaptive sampling: ON" << std::endl;
+
+	argParser.isSet("min-rpp", minRpp);
+	if (verbose) std::cout << "Setting minimum rays per pixel to " << minRpp << std::endl;
+
+	argParser.isSet("adaptive-threshold", adaptiveThreshold);
+	if (verbose) std::cout << "Setting adaptive threshold to " << adaptiveThreshold << std::endl;
+
+	argParser.isSet("sample-counts", sampleCountFileName);
+	if (verbose) std::cout << "Setting sampleCountFileName to " << sampleCountFileName << std::endl;
+
+	edgeAware = argParser.isSet("edge-aware");
+	if (verbose && edgeAware) std::cout << "Edge-aware supersampling: ON" << std::endl;
+
+	argParser.isSet("edge-angle", edgeAngle);
+	if (verbose) std::cout << "Setting edge angle to " << edgeAngle << std::endl;
+
+	edgeReport = argParser.isSet("edge-report");
+	if (verbose && edgeReport) std::cout << "Edge-aware supersampling report: ON" << std::endl;
+
+	argParser.isSet("light-samples", lightSamples);
+	if (verbose) std::cout << "Setting light samples to " << lightSamples << std::endl;
+
+	argParser.isSet("roulette", rouletteThreshold);
+	if (verbose) std::cout << "Setting roulette threshold to " << rouletteThreshold << std::endl;
+
+	decoupledShading = argParser.isSet("decoupled-shading");
+	if (verbose && decoupledShading) std::cout << "Decoupled shading: ON" << std::endl;
+
+	argParser.isSet("shading-cell", shadingCellSize);
+	if (verbose) std::cout << "Setting shading cell size to " << shadingCellSize << std::endl;
+
+	argParser.isSet("tile-size", tileSize);
+	if (verbose) std::cout << "Setting tile size to " << tileSize << std::endl;
+
+	argParser.isSet("tile-order", tileOrder);
+	if (verbose) std::cout << "Setting tile order to " << tileOrder << std::endl;
+
+	argParser.isSet("hit-cache", hitCacheFileName);
+	if (verbose) std::cout << "Setting hitCacheFileName to " << hitCacheFileName << std::endl;
+
+	progressive = argParser.isSet("progressive");
+	if (verbose && progressive) std::cout << "Progressive rendering: ON" << std::endl;
+
+	argParser.isSet("time-budget", timeBudget);
+	if (verbose) std::cout << "Setting time budget to " << timeBudget << std::endl;
+
+	argParser.isSet("checkpoint", checkpointFileName);
+	if (verbose) std::cout << "Setting checkpointFileName to " << checkpointFileName << std::endl;
+
+	argParser.isSet("checkpoint-interval", checkpointInterval);
+	if (verbose) std::cout << "Setting checkpoint interval to " << checkpointInterval << std::endl;
+
 	argParser.isSet("inputfile", inputFileName);
 	if (verbose) std::cout << "Setting inputFileName to " << inputFileName << std::endl;
 
@@ -46,6 +46,8 @@ namespace sivelab {
     bool useShadow;
     Vector3D bgColor;
 	bool doHdr;
+    float gamma;
+    int bandRows;
     
     bool useDepthOfField;
     float depthOfFieldDistance;
@@ -55,6 +57,31 @@ namespace sivelab {
     int rpp;
     
     std::string splitMethod;
+
+    std::string renderMode;
+    std::string sampler;
+
+    bool adaptive;
+    int minRpp;
+    float adaptiveThreshold;
+    std::string sampleCountFileName;
+
+    bool edgeAware;
+    float edgeAngle;
+    bool edgeReport;
+
+    int lightSamples;
+    float rouletteThreshold;
+    bool decoupledShading;
+    float shadingCellSize;
+    int tileSize;
+    std::string tileOrder;
+    std::string hitCacheFileName;
+
+    bool progressive;
+    float timeBudget;
+    std::string checkpointFileName;
+    float checkpointInterval;
     
     std::string inputFileName;
     std::string outputFileName;
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+#include <ArgumentParsing.h>
+#include <EngineException.h>
+#include <Image.h>
+#include <HdrFile.h>
+#include <ThreadPool.h>
+
+
+using namespace std;
+using namespace sivelab;
+
+
+/**
+ * Tone maps an HDR image written by the raytracer, so that exposure and bloom can be changed without rendering again.
+ * With the same options, the png written matches the one the raytracer would have written: without -b, the image is only
+ * scaled by the exposure, and --tonemap asks for the global tone mapping on its own.
+ */
+int main(int argc, char *argv[])
+{
+	ArgumentParsing argParser;
+	argParser.reg("help", "help/usage information", ArgumentParsing::NONE, '?');
+	argParser.reg("inputfile", "PFM or OpenEXR file to postprocess", ArgumentParsing::STRING, 'i');
+	argParser.reg("outputfile", "output file name to use, either a png, or a PFM or OpenEXR file to keep the result in HDR", ArgumentParsing::STRING, 'o');
+	argParser.reg("numcpus", "num of cores to use", ArgumentParsing::INT, 'n');
+	argParser.reg("hdr-bloom", "HDR bloom and tone mapping, the same as the raytracer's -b (default is off)", ArgumentParsing::NONE, 'b');
+	argParser.reg("exposure", "factor to multiply the image by before tone mapping (default is 1.0)", ArgumentParsing::FLOAT, 'e');
+	argParser.reg("tonemap", "global tone mapping without bloom, which the raytracer never does on its own (default is off)", ArgumentParsing::NONE);
+	argParser.reg("gamma", "gamma to encode a png with (default is 1.0, or linear)", ArgumentParsing::FLOAT);
+	argParser.processCommandLineArgs(argc, argv);
+
+	if (argParser.isSet("help"))
+	{
+		argParser.printUsage();
+		exit(EXIT_SUCCESS);
+	}
+
+	string inputFileName, outputFileName;
+	int threadCount = -1;
+	float exposure = 1.0f;
+	float gamma = 1.0f;
+	argParser.isSet("inputfile", inputFileName);
+	argParser.isSet("outputfile", outputFileName);
+	argParser.isSet("numcpus", threadCount);
+	argParser.isSet("exposure", exposure);
+	argParser.isSet("gamma", gamma);
+	bool bloom = argParser.isSet("hdr-bloom");
+	bool toneMap = argParser.isSet("tonemap");
+
+	if ((inputFileName == "") || (outputFileName == ""))
+	{
+		cerr << "Need input and output files!" << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	if (threadCount <= 0)
+	{
+		threadCount = ThreadEngine::ThreadPool::GetNumberOfProcessors();
+	}
+
+	Image *image = NULL;
+	try
+	{
+		image = HdrFile::Read(inputFileName);
+
+		if (exposure != 1.0f)
+		{
+			image->Scale(exposure);
+		}
+
+		// The last step of the tone mapping is done while a png is written out.
+		double outputScale = 1.0;
+		bool writeHdr = HdrFile::IsHdrFileName(outputFileName);
+		if (bloom)
+		{
+			outputScale = image->Postprocess(threadCount, writeHdr);
+		}
+		else if (toneMap)
+		{
+			image->DoGlobalHDR(threadCount);
+		}
+
+		if (writeHdr)
+		{
+			HdrFile::Write(*image, outputFileName, threadCount);
+		}
+		else
+		{
+			image->WriteToDisk(outputFileName, threadCount, outputScale, gamma);
+		}
+	}
+	catch (EngineException &e)
+	{
+		cerr << "Error postprocessing " << inputFileName << ": " << e.what() << endl;
+		delete image;
+		exit(EXIT_FAILURE);
+	}
+
+	delete image;
+	exit(EXIT_SUCCESS);
+}
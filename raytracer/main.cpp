@@ -1,12 +1,17 @@
 #include <iostream>
 #include <cstdlib>
+#include <algorithm>
 #include <time.h>
+#include <signal.h>
 
 #include <handleGraphicsArgs.h>
 #include <Scene.h>
 #include <EngineException.h>
 #include <Image.h>
+#include <PngStreamWriter.h>
+#include <HdrFile.h>
 #include <ThreadPool.h>
+#include <TaskGraph.h>
 
 
 using namespace std;
@@ -26,6 +31,24 @@ int64_t GetTickCount()
 }
 
 
+/**
+ * The scene being rendered, so that the signal handler can ask it for a checkpoint.
+ */
+Scene *g_checkpointScene = NULL;
+
+
+/**
+ * Asks a progressive render for a checkpoint when the process gets SIGUSR1.
+ */
+void OnCheckpointSignal(int signal)
+{
+	if (g_checkpointScene != NULL)
+	{
+		g_checkpointScene->RequestCheckpoint();
+	}
+}
+
+
 int main(int argc, char *argv[])
 {
 	GraphicsArgs args;
@@ -41,11 +64,18 @@ int main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
 	}
 
-	// Try to read in the given scene file.
+	// See if we need to autodetect the optimal thread count.
+	if (args.numCpus <= 0)
+	{
+		args.numCpus = ThreadEngine::ThreadPool::GetNumberOfProcessors();
+	}
+
+	// Try to read in the given scene file.  Meshes are loaded on the other threads while the rest of the file is parsed.
 	try
 	{
 		int64_t beginTime = GetTickCount();
-		scene = new Scene(args.inputFileName, args.rpp, true, args.verbose);
+		ThreadEngine::TaskGraph loader(args.numCpus);
+		scene = new Scene(args.inputFileName, args.rpp, true, args.verbose, &loader);
 		cout << "Parsing scene took " << (GetTickCount() - beginTime) << " ms." << endl;
 	}
 	catch (EngineException &e)
@@ -54,6 +84,107 @@ int main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
 	}
 
+	// Pick the rendering mode.
+	if (args.renderMode == "recursive")
+	{
+		scene->RenderingMode = RENDER_RECURSIVE;
+	}
+	else if (args.renderMode == "wavefront")
+	{
+		scene->RenderingMode = RENDER_WAVEFRONT;
+	}
+	else if (args.renderMode == "deferred")
+	{
+		scene->RenderingMode = RENDER_DEFERRED;
+	}
+	else
+	{
+		cerr << "Unknown render mode \"" << args.renderMode << "\"!" << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Pick the sampler.
+	if (args.sampler == "jittered")
+	{
+		scene->SamplingMethod = SAMPLER_JITTERED;
+	}
+	else if (args.sampler == "sobol")
+	{
+		scene->SamplingMethod = SAMPLER_SOBOL;
+	}
+	else if (args.sampler == "halton")
+	{
+		scene->SamplingMethod = SAMPLER_HALTON;
+	}
+	else if (args.sampler == "bluenoise")
+	{
+		scene->SamplingMethod = SAMPLER_BLUE_NOISE;
+	}
+	else
+	{
+		cerr << "Unknown sampler \"" << args.sampler << "\"!" << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	scene->AdaptiveSampling = args.adaptive;
+	scene->AdaptiveMinSamples = args.minRpp;
+	scene->AdaptiveThreshold = args.adaptiveThreshold;
+	scene->EdgeAwareSampling = args.edgeAware || args.edgeReport;
+	scene->EdgeAngleThreshold = args.edgeAngle;
+	// Only override the scene's light sampling if it was asked for.
+	if (args.lightSamples >= 0)
+	{
+		scene->LightSampleCount = args.lightSamples;
+	}
+	scene->RouletteThreshold = args.rouletteThreshold;
+	scene->DecoupledShading = args.decoupledShading;
+	scene->ShadingCellSize = args.shadingCellSize;
+
+	// Pick how threads share out the image.
+	if (args.tileSize <= 0)
+	{
+		cerr << "The tile size has to be positive!" << endl;
+		exit(EXIT_FAILURE);
+	}
+	scene->TileSize = args.tileSize;
+
+	if (args.tileOrder == "hilbert")
+	{
+		scene->RenderTileOrder = TILE_ORDER_HILBERT;
+	}
+	else if (args.tileOrder == "morton")
+	{
+		scene->RenderTileOrder = TILE_ORDER_MORTON;
+	}
+	else if (args.tileOrder == "scanline")
+	{
+		scene->RenderTileOrder = TILE_ORDER_SCANLINE;
+	}
+	else
+	{
+		cerr << "Unknown tile order \"" << args.tileOrder << "\"!" << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Only deferred rendering keeps its primary hits around.
+	if (args.hitCacheFileName != "")
+	{
+		scene->PrimaryHitCacheFileName = args.hitCacheFileName;
+		scene->RenderingMode = RENDER_DEFERRED;
+	}
+
+	scene->ProgressiveRendering = args.progressive;
+	scene->ProgressiveTimeBudget = args.timeBudget;
+	scene->CheckpointFileName = args.checkpointFileName;
+	scene->CheckpointInterval = args.checkpointInterval;
+
+	// Let batch schedulers ask a progressive render for its current image with SIGUSR1.
+	if (args.progressive)
+	{
+		g_checkpointScene = scene;
+		signal(SIGUSR1, OnCheckpointSignal);
+	}
+
 	// Make sure they passed in the output filename.
 	if (args.outputFileName == "")
 	{
@@ -68,26 +199,124 @@ int main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
 	}
 
+	// Streaming never has the whole image, which all of these need.
+	if ((args.bandRows > 0) && (args.doHdr || args.edgeReport || (args.sampleCountFileName != "")))
+	{
+		cerr << "Rendering in bands can't be combined with bloom, edge reports or sample counts!" << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// A hit cache is only kept by deferred rendering, which takes every sample.
+	bool usesHitCache = (args.hitCacheFileName != "");
+	if (((args.renderMode == "deferred") || usesHitCache) && args.adaptive)
+	{
+		cerr << "Deferred rendering, which a hit cache needs, can't be combined with adaptive sampling!" << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Only recursive rendering of whole pixels shares shading between samples.
+	if (args.decoupledShading && ((args.renderMode != "recursive") || usesHitCache || args.progressive))
+	{
+		cerr << "Decoupled shading can't be combined with other render modes, a hit cache, or progressive rendering!" << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Progressive passes are always traced recursively, one sample per pixel at a time.
+	if (args.progressive && ((args.renderMode != "recursive") || args.adaptive || args.edgeAware || args.edgeReport || usesHitCache))
+	{
+		cerr << "Progressive rendering can't be combined with other render modes, adaptive or edge-aware sampling, or a hit cache!" << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// HDR output is saved before any tone mapping, so that it can be postprocessed later.
+	bool writeHdr = HdrFile::IsHdrFileName(args.outputFileName);
+	if (writeHdr && (args.doHdr || (args.bandRows > 0)))
+	{
+		cerr << "HDR output can't be combined with bloom or rendering in bands!  Run postprocess on it instead." << endl;
+		exit(EXIT_FAILURE);
+	}
+
 	// Try to render the scene.
 	try
 	{
-		// See if we need to autodetect the optimal thread count.
-		if (args.numCpus <= 0)
-		{
-			args.numCpus = ThreadEngine::ThreadPool::GetNumberOfProcessors();
-		}
 		cout << "Rendering with " << args.numCpus << " threads..." << endl;
-		int64_t beginTime = GetTickCount();
-		Image image(args.width, args.height);
-		scene->Render(image, args.numCpus);
-		cout << "Rendering scene took " << (GetTickCount() - beginTime) << " ms." << endl;
 
-		if (args.doHdr)
+		// Poster-sized images are written a band at a time, as soon as each band is rendered.
+		if (args.bandRows > 0)
 		{
-			image.Postprocess();
+			int64_t beginTime = GetTickCount();
+			PngStreamWriter writer(args.outputFileName, args.width, args.height, args.numCpus, args.gamma);
+			scene->RenderBands(writer, args.numCpus, args.bandRows);
+			cout << "Rendering scene took " << (GetTickCount() - beginTime) << " ms." << endl;
 		}
+		else
+		{
+			// Render with full supersampling first, so that edge-aware supersampling can be compared against it.
+			Image fullImage(args.width, args.height);
+			int64_t fullTime = 0;
+			if (args.edgeReport)
+			{
+				scene->EdgeAwareSampling = false;
+				int64_t fullBeginTime = GetTickCount();
+				scene->Render(fullImage, args.numCpus);
+				fullTime = GetTickCount() - fullBeginTime;
+				cout << "Rendering scene with full supersampling took " << fullTime << " ms." << endl;
+				scene->EdgeAwareSampling = true;
+			}
+
+			int64_t beginTime = GetTickCount();
+			Image image(args.width, args.height);
+			Image sampleCounts(args.width, args.height);
+			bool writeSampleCounts = (args.sampleCountFileName != "");
+			scene->Render(image, args.numCpus, writeSampleCounts ? &sampleCounts : NULL);
+			int64_t renderTime = GetTickCount() - beginTime;
+			cout << "Rendering scene took " << renderTime << " ms." << endl;
+
+			if (args.progressive)
+			{
+				cout << "Progressive rendering took " << scene->GetProgressivePassCount() << " samples per pixel." << endl;
+			}
 
-		image.WriteToDisk(args.outputFileName);
+			if (args.edgeReport)
+			{
+				int pixelCount = args.width * args.height;
+				cout << "Edge-aware supersampling report:" << endl;
+				cout << "\tSupersampled " << scene->GetSupersampledPixelCount() << " of " << pixelCount << " pixels ("
+					<< (100.0 * scene->GetSupersampledPixelCount() / pixelCount) << "%)." << endl;
+				cout << "\tTime: " << renderTime << " ms, against " << fullTime << " ms with full supersampling ("
+					<< ((double)fullTime / max(renderTime, (int64_t)1)) << "x faster)." << endl;
+				cout << "\tPSNR against full supersampling: " << image.ComputePsnr(fullImage) << " dB." << endl;
+			}
+
+			// The sample counts are written while the image is tone mapped and written.
+			ThreadEngine::TaskGraph writerGraph(1);
+			ThreadEngine::TaskHandle sampleCountWrite;
+			if (writeSampleCounts)
+			{
+				sampleCountWrite = writerGraph.Add([&sampleCounts, &args]() { sampleCounts.WriteToDisk(args.sampleCountFileName); });
+			}
+
+			if (writeHdr)
+			{
+				HdrFile::Write(image, args.outputFileName, args.numCpus);
+			}
+			else
+			{
+				// The last step of the tone mapping is done while the image is written out.
+				double outputScale = 1.0;
+				if (args.doHdr)
+				{
+					outputScale = image.Postprocess(args.numCpus, false);
+				}
+
+				image.WriteToDisk(args.outputFileName, args.numCpus, outputScale, args.gamma);
+			}
+
+			if (sampleCountWrite != NULL)
+			{
+				sampleCountWrite->Wait();
+			}
+		}
 	}
 	catch (EngineException &e)
 	{
@@ -95,6 +324,7 @@ int main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
 	}
 
+	g_checkpointScene = NULL;
 	delete scene;
 	scene = NULL;
 
@@ -1,5 +1,7 @@
+#pragma once
+
 #include "ILight.h"
-#include "JitteredSampler.h"
+#include "ISampler.h"
 
 
 /**
@@ -13,15 +15,15 @@ public:
 
 	virtual sivelab::Vector3D GetPosition() const;
 	virtual Color GetRadiance(const sivelab::Vector3D& position) const;
+	virtual LightRecord Compile() const;
 
 	/**
 	 * Gets the position on the light (in world coordinates) using the given sample.
 	 */
 	sivelab::Vector3D GetPosition(const Sample &sample) const;
 private:
-	sivelab::Vector3D m_position;
-	Color m_intensity;
-	sivelab::Vector3D m_normal;
-	double m_width;
-	double m_height;
+	/**
+	 * The light, with its frame already worked out from its normal.
+	 */
+	LightRecord m_record;
 };
@@ -50,7 +50,7 @@ int main()
 
 		Ray ray(rayOrig, rayDir);
 
-		Intersection intersect;
+		HitRecord intersect;
 		bool boxHit = box.Intersect(ray, intersect);
 		bool bboxHit = boundingBox.Intersects(ray);
 
@@ -130,7 +130,7 @@ IShader* BVHNode::GetShader()
 }
 
 
-bool BVHNode::Intersect(const Ray& ray, Intersection& result)
+bool BVHNode::Intersect(const Ray& ray, HitRecord& hit)
 {
 	// See if they hit our bounding box.
 	if (m_bbox.Intersects(ray) == false)
@@ -141,7 +141,7 @@ bool BVHNode::Intersect(const Ray& ray, Intersection& result)
 	// If we got here, the ray hit our bbox, we need to see if it hit any of our contents.
 	// See if the right child is valid.
 	bool rightHit;
-	Intersection rightResult;
+	HitRecord rightResult;
 	if (m_rightChild == NULL)
 	{
 		// No hit.
@@ -161,7 +161,7 @@ bool BVHNode::Intersect(const Ray& ray, Intersection& result)
 
 	// See if left child is valid.
 	bool leftHit;
-	Intersection leftResult;
+	HitRecord leftResult;
 	if (m_leftChild == NULL)
 	{
 		// No hit.
@@ -189,22 +189,22 @@ bool BVHNode::Intersect(const Ray& ray, Intersection& result)
 		// Both rays hit.  See which one is closer.
 		if (rightResult.t < leftResult.t)
 		{
-			result = rightResult;
+			hit = rightResult;
 		}
 		else
 		{
-			result = leftResult;
+			hit = leftResult;
 		}
 	}
 	else if (rightHit)
 	{
 		// Right ray hit.
-		result = rightResult;
+		hit = rightResult;
 	}
 	else if (leftHit)
 	{
 		// Left ray hit.
-		result = leftResult;
+		hit = leftResult;
 	}
 	else
 	{
@@ -216,3 +216,9 @@ bool BVHNode::Intersect(const Ray& ray, Intersection& result)
 	return (true);
 }
 
+
+sivelab::Vector3D BVHNode::GetNormal(const Ray& ray, const HitRecord& hit)
+{
+	return (hit.primitive->GetNormal(ray, hit));
+}
+
@@ -1,5 +1,6 @@
 #include "BlinnPhongShader.h"
 #include "Intersection.h"
+#include "ShadingTerms.h"
 
 using namespace std;
 using namespace sivelab;
@@ -16,82 +17,183 @@ BlinnPhongShader::BlinnPhongShader(Scene* scene, const Color& diffuse, const Col
 }
 
 
+/**
+ * A Blinn-Phong shader that has its features fixed when it is compiled.
+ */
+template <bool WithSpecular, bool WithMirror>
+class BlinnPhongKernelShader : public BlinnPhongShader
+{
+public:
+	BlinnPhongKernelShader(Scene* scene, const Color& diffuse, const Color& specular, double phongExp, double mirrorCoef, double roughness) :
+		BlinnPhongShader(scene, diffuse, specular, phongExp, mirrorCoef, roughness)
+	{
+	}
+
+	virtual bool Decompose(Intersection& intersection, ShadingTerms& terms)
+	{
+		DecomposeKernel<WithSpecular, WithMirror>(intersection, terms);
+		return (true);
+	}
+
+	virtual bool IsViewIndependent() const
+	{
+		return (!WithSpecular && !WithMirror);
+	}
+};
+
+
+BlinnPhongShader *BlinnPhongShader::Create(Scene* scene, const Color& diffuse, const Color& specular, double phongExp, double mirrorCoef, double roughness)
+{
+	BlinnPhongShader prototype(scene, diffuse, specular, phongExp, mirrorCoef, roughness);
+	if (prototype.HasSpecular())
+	{
+		if (prototype.IsMirror())
+		{
+			return (new BlinnPhongKernelShader<true, true>(scene, diffuse, specular, phongExp, mirrorCoef, roughness));
+		}
+
+		return (new BlinnPhongKernelShader<true, false>(scene, diffuse, specular, phongExp, mirrorCoef, roughness));
+	}
+
+	if (prototype.IsMirror())
+	{
+		return (new BlinnPhongKernelShader<false, true>(scene, diffuse, specular, phongExp, mirrorCoef, roughness));
+	}
+
+	return (new BlinnPhongKernelShader<false, false>(scene, diffuse, specular, phongExp, mirrorCoef, roughness));
+}
+
+
 Color BlinnPhongShader::Shade(Intersection& intersection)
+{
+	ShadingTerms terms;
+	Decompose(intersection, terms);
+	return (m_scene->ResolveShadingTerms(intersection, terms));
+}
+
+
+bool BlinnPhongShader::Decompose(Intersection& intersection, ShadingTerms& terms)
+{
+	// The mirror coefficient can change between hits, so pick the kernel every time.
+	if (HasSpecular())
+	{
+		if (IsMirror())
+		{
+			DecomposeKernel<true, true>(intersection, terms);
+		}
+		else
+		{
+			DecomposeKernel<true, false>(intersection, terms);
+		}
+	}
+	else
+	{
+		if (IsMirror())
+		{
+			DecomposeKernel<false, true>(intersection, terms);
+		}
+		else
+		{
+			DecomposeKernel<false, false>(intersection, terms);
+		}
+	}
+
+	return (true);
+}
+
+
+bool BlinnPhongShader::IsViewIndependent() const
+{
+	return (!HasSpecular() && !IsMirror());
+}
+
+
+bool BlinnPhongShader::HasSpecular() const
+{
+	return ((m_specular.GetRed() > 0.0) || (m_specular.GetGreen() > 0.0) || (m_specular.GetBlue() > 0.0));
+}
+
+
+bool BlinnPhongShader::IsMirror() const
+{
+	return (m_mirrorCoef > EPSILON);
+}
+
+
+template <bool WithSpecular, bool WithMirror>
+void BlinnPhongShader::DecomposeKernel(Intersection& intersection, ShadingTerms& terms)
 {
 	const Vector3D &normal = intersection.surfaceNormal;
-	Vector3D viewDir = intersection.collidedRay.GetDirection();
-	viewDir *= -1.0;
-	viewDir.normalize();
+	Vector3D viewDir;
+	if (WithSpecular)
+	{
+		viewDir = intersection.collidedRay.GetDirection();
+		viewDir *= -1.0;
+		viewDir.normalize();
+	}
 	Vector3D intersectPoint = intersection.collidedRay.GetPositionAtTime(intersection.t);
 
-	Color finalDiffuseColor(0.0, 0.0, 0.0);
-	Color finalSpecularColor(0.0, 0.0, 0.0);
+	// The diffuse part gets scaled down by however much of the surface acts like a mirror.
+	double diffuseScale = WithMirror ? (1.0 - m_mirrorCoef) : 1.0;
 
-	LightList::const_iterator currentLight;
-	for (currentLight = m_scene->GetLightsBegin(); currentLight != m_scene->GetLightsEnd(); currentLight++)
+	// Always add the ambient amount of light.
+	Color ambient = m_scene->GetAmbient();
+	ambient.MultiplyColors(m_diffuse);
+	if (WithMirror)
 	{
+		ambient.LinearMult(diffuseScale);
+	}
+	for (int i = m_scene->GetAmbientCount(); i > 0; i--)
+	{
+		terms.base.AddColors(ambient);
+	}
+
+	LightChoiceList lights;
+	m_scene->SelectLights(intersection, lights);
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		const LightRecord *light = lights[i].light;
+
 		// The direction to the light from the intersection point.
-		Vector3D lightDir = (*currentLight)->GetPosition() - intersectPoint;
+		Vector3D lightDir = light->position - intersectPoint;
 		lightDir.normalize();
 
-		// The direction halfway between the light direction and the view direction.
-		Vector3D halfDir = lightDir + viewDir;
-		halfDir.normalize();
+		// The radiance at the point of intersection.
+		Color radiance = light->radiance;
+		radiance.LinearMult(lights[i].weight);
 
-		// Always add the ambient amount of light.
-		Color ambient = m_scene->GetAmbient();
-		ambient.MultiplyColors(m_diffuse);
-		finalDiffuseColor.AddColors(ambient);
+		// Make sure it is above 0.
+		double diffuseIntensity = max(0.0, lightDir.dot(normal));
 
-		// See if we are in shadow.
-		bool inShadow = m_scene->CastShadowRay(*currentLight, intersection);
-		if (inShadow == false)
-		{
-			// The radiance at the point of intersection.
-			Color radiance = (*currentLight)->GetRadiance(intersectPoint);
+		Color diffuseColor = radiance;
+		diffuseColor.LinearMult(WithMirror ? (diffuseIntensity * diffuseScale) : diffuseIntensity).MultiplyColors(m_diffuse);
 
-			// Make sure it is above 0.
-			double diffuseIntensity = max(0.0, lightDir.dot(normal));
-
-			Color diffuseColor = radiance;
-			diffuseColor.LinearMult(diffuseIntensity).MultiplyColors(m_diffuse);
+		if (WithSpecular)
+		{
+			// The direction halfway between the light direction and the view direction.
+			Vector3D halfDir = lightDir + viewDir;
+			halfDir.normalize();
 
 			// Make sure it is above 0.
 			double specularIntensity = pow(max(0.0, halfDir.dot(normal)), m_phongExp);
 
-			// Calculate the specular color, and add it to the sum total of specular colors.
+			// The specular color is not affected by the mirror coefficient.
 			Color specularColor = radiance;
 			specularColor.LinearMult(specularIntensity).MultiplyColors(m_specular);
-			finalSpecularColor.AddColors(specularColor);
-
-			// Sum colors into the diffuse color.
-			finalDiffuseColor.AddColors(diffuseColor);
+			diffuseColor.AddColors(specularColor);
 		}
-	}
 
-	// Calculate the final color.
-	Color finalColor;
+		// Only counts if we are not in shadow.
+		terms.AddLight(light, diffuseColor);
+	}
 
-	// Calculate color of reflected ray if m_mirrorCoef is not close to zero.
-	if (m_mirrorCoef > EPSILON)
+	if (WithMirror)
 	{
 		// The surface acts as a mirror.
-		Color reflectedColor = m_scene->CastReflectionRay(intersection, m_roughness);
-		// Combine the reflected color with the diffuse color.
-		finalDiffuseColor.LinearMult(1.0 - m_mirrorCoef);
-		reflectedColor.LinearMult(m_mirrorCoef);
-		finalColor.AddColors(finalDiffuseColor).AddColors(reflectedColor);
+		terms.reflects = true;
+		terms.reflectance = Color(m_mirrorCoef, m_mirrorCoef, m_mirrorCoef);
+		terms.roughness = m_roughness;
 	}
-	else
-	{
-		// The surface does not act like a mirror.
-		finalColor.AddColors(finalDiffuseColor);
-	}
-
-	// Combine the specular color with the result.
-	finalColor.AddColors(finalSpecularColor);
-
-	return (finalColor);
 }
 
 
@@ -99,4 +201,3 @@ void BlinnPhongShader::SetMirrorCoef(double mirrorCoef)
 {
 	m_mirrorCoef = mirrorCoef;
 }
-
@@ -18,6 +18,14 @@ public:
 	 */
 	BlinnPhongShader(Scene *scene, const Color &diffuse, const Color &specular, double phongExp, double mirrorCoef, double roughness);
 
+	/**
+	 * Creates a Blinn-Phong shader that is compiled for just the features the given parameters use.
+	 * A shader without a specular color skips the highlight, and one without a mirror coefficient skips the reflection,
+	 * instead of checking for them at every hit.  Takes the same parameters as the constructor.
+	 * The mirror coefficient of the returned shader should not be changed.
+	 */
+	static BlinnPhongShader *Create(Scene *scene, const Color &diffuse, const Color &specular, double phongExp, double mirrorCoef, double roughness);
+
 	/**
 	 * Sets the value of the mirror coeficient.
 	 */
@@ -27,6 +35,27 @@ public:
 
 	virtual Color Shade(Intersection& intersection);
 
+	virtual bool Decompose(Intersection& intersection, ShadingTerms& terms);
+
+	virtual bool IsViewIndependent() const;
+
+protected:
+	/**
+	 * Returns true if the specular color is not black.
+	 */
+	bool HasSpecular() const;
+
+	/**
+	 * Returns true if the mirror coefficient is large enough to cast reflection rays.
+	 */
+	bool IsMirror() const;
+
+	/**
+	 * Does the work of Decompose(), for a shader that is known to have or not have a highlight and a reflection.
+	 */
+	template <bool WithSpecular, bool WithMirror>
+	void DecomposeKernel(Intersection& intersection, ShadingTerms& terms);
+
 private:
 	Scene *m_scene;
 
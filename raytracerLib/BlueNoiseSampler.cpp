@@ -0,0 +1,118 @@
+#include <math.h>
+#include <limits>
+
+#include "BlueNoiseSampler.h"
+#include "SobolSampler.h"
+#include "RandomGenerator.h"
+
+using namespace std;
+
+
+const int BlueNoiseSampler::TILE_SIZE;
+
+
+/**
+ * The standard deviation of the gaussian used to measure how clustered the points are.
+ */
+static const double BLUE_NOISE_SIGMA = 1.5;
+
+/**
+ * How far away a point has to be before it no longer affects a cell.
+ */
+static const int BLUE_NOISE_RADIUS = 6;
+
+
+BlueNoiseSampler::BlueNoiseSampler()
+{
+	GenerateTile(m_tileX, 1);
+	GenerateTile(m_tileY, 2);
+}
+
+
+void BlueNoiseSampler::GenerateTile(vector<double>& tile, uint64_t seed)
+{
+	int cellCount = TILE_SIZE * TILE_SIZE;
+	tile.assign(cellCount, 0.0);
+
+	// Precompute how much energy a point gives to each of its neighbors.
+	int kernelSize = 2 * BLUE_NOISE_RADIUS + 1;
+	vector<double> kernel(kernelSize * kernelSize);
+	for (int dy = -BLUE_NOISE_RADIUS; dy <= BLUE_NOISE_RADIUS; dy++)
+	{
+		for (int dx = -BLUE_NOISE_RADIUS; dx <= BLUE_NOISE_RADIUS; dx++)
+		{
+			int index = (dy + BLUE_NOISE_RADIUS) * kernelSize + (dx + BLUE_NOISE_RADIUS);
+			kernel[index] = exp(-(dx * dx + dy * dy) / (2.0 * BLUE_NOISE_SIGMA * BLUE_NOISE_SIGMA));
+		}
+	}
+
+	// Start with a tiny amount of random energy, so that ties are broken differently for each seed.
+	RandomGenerator random(seed);
+	vector<double> energy(cellCount);
+	for (int i = 0; i < cellCount; i++)
+	{
+		energy[i] = random.NextDouble() * 1e-6;
+	}
+
+	for (int rank = 0; rank < cellCount; rank++)
+	{
+		// Find the largest void, which is the empty cell with the least energy.  Filled cells have infinite energy.
+		int bestCell = 0;
+		for (int i = 1; i < cellCount; i++)
+		{
+			if (energy[i] < energy[bestCell])
+			{
+				bestCell = i;
+			}
+		}
+
+		tile[bestCell] = (rank + 0.5) / cellCount;
+
+		// Spread the new point's energy to its neighbors.  The tile wraps around, so that it can be repeated.
+		int cellX = bestCell % TILE_SIZE;
+		int cellY = bestCell / TILE_SIZE;
+		for (int dy = -BLUE_NOISE_RADIUS; dy <= BLUE_NOISE_RADIUS; dy++)
+		{
+			int y = (cellY + dy + TILE_SIZE) % TILE_SIZE;
+			const double *kernelRow = &kernel[(dy + BLUE_NOISE_RADIUS) * kernelSize + BLUE_NOISE_RADIUS];
+			for (int dx = -BLUE_NOISE_RADIUS; dx <= BLUE_NOISE_RADIUS; dx++)
+			{
+				int x = (cellX + dx + TILE_SIZE) % TILE_SIZE;
+				energy[y * TILE_SIZE + x] += kernelRow[dx];
+			}
+		}
+
+		energy[bestCell] = numeric_limits<double>::infinity();
+	}
+}
+
+
+Sample BlueNoiseSampler::GetSample(int pixelX, int pixelY, int index, int sampleCount, int dimension) const
+{
+	// The sequence is only scrambled per dimension, not per pixel, so that the blue noise is all that differs between pixels.
+	uint64_t seed = RandomGenerator::Hash(dimension);
+
+	uint32_t x, y;
+	SobolSampler::GetSobolPoint(SobolSampler::OwenScramble(index, (uint32_t)seed), x, y);
+	x = SobolSampler::OwenScramble(x, (uint32_t)(seed >> 32));
+	y = SobolSampler::OwenScramble(y, (uint32_t)(seed >> 32) * 0x9E3779B9 + 1);
+
+	// Each dimension looks up a different part of the tile, so that the offsets of the dimensions are not the same.
+	int tileX = (int)(((uint64_t)pixelX + (seed & 0xFFFF)) % TILE_SIZE);
+	int tileY = (int)(((uint64_t)pixelY + ((seed >> 16) & 0xFFFF)) % TILE_SIZE);
+	int cell = tileY * TILE_SIZE + tileX;
+
+	// Offset the point by the table, wrapping around the unit square.
+	double sampleX = x * (1.0 / 4294967296.0) + m_tileX[cell];
+	double sampleY = y * (1.0 / 4294967296.0) + m_tileY[cell];
+	if (sampleX >= 1.0)
+	{
+		sampleX -= 1.0;
+	}
+	if (sampleY >= 1.0)
+	{
+		sampleY -= 1.0;
+	}
+
+	return (make_pair(sampleX, sampleY));
+}
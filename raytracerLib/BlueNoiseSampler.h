@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "ISampler.h"
+
+
+/**
+ * Generates Sobol samples that are offset in each pixel by a tiled blue noise table.
+ * The samples within a pixel keep the low discrepancy of the Sobol sequence,
+ * while the error between neighboring pixels is pushed to high frequencies, where it is much less visible.
+ * The table is built once, when the sampler is constructed.
+ */
+class BlueNoiseSampler : public ISampler
+{
+public:
+	/**
+	 * Builds the blue noise table.
+	 */
+	BlueNoiseSampler();
+
+	virtual Sample GetSample(int pixelX, int pixelY, int index, int sampleCount, int dimension) const;
+
+	/**
+	 * The width and height of the blue noise tile, in pixels.
+	 */
+	static const int TILE_SIZE = 64;
+
+private:
+	/**
+	 * Fills a tile with the values 0 to 1 spread out as blue noise, using the void and cluster method.
+	 * Points are added one at a time in the largest void, and each point's value is the order it was added in.
+	 * @param tile Will be filled with TILE_SIZE * TILE_SIZE values.
+	 * @param seed Used to break ties, so that different seeds give different tiles.
+	 */
+	static void GenerateTile(std::vector<double> &tile, uint64_t seed);
+
+	/**
+	 * One tile for each axis of the offset.
+	 */
+	std::vector<double> m_tileX;
+	std::vector<double> m_tileY;
+};
@@ -38,7 +38,7 @@ BBox Box::GetBoundingBox()
 }
 
 
-bool Box::Intersect(const Ray& ray, Intersection& result)
+bool Box::Intersect(const Ray& ray, HitRecord& hit)
 {
 	// See if the ray even hits at all.
 	if (m_bbox.Intersects(ray) == false)
@@ -48,25 +48,25 @@ bool Box::Intersect(const Ray& ray, Intersection& result)
 
 	// We need to test for more than one interestion.
 	double maxDouble = std::numeric_limits<double>::max();
-	result.t = maxDouble;
-	Intersection intersect;
+	hit.t = maxDouble;
+	HitRecord triangleHit;
 
 	for (int i = 0; i < TRIANGLES_IN_A_BOX; i++)
 	{
-		if (m_triangles[i]->Intersect(ray, intersect) == true)
+		if (m_triangles[i]->Intersect(ray, triangleHit) == true)
 		{
 			// Discard entries with collisions in the past.
-			if ((intersect.t < result.t) && (intersect.t > 0.0))
+			if ((triangleHit.t < hit.t) && (triangleHit.t > 0.0))
 			{
-				result = intersect;
+				hit = triangleHit;
 			}
 		}
 	}
 
-	// See if there was a collision.
-	if (result.t < maxDouble)
+	// See if there was a collision.  The triangle that was hit stays the primitive.
+	if (hit.t < maxDouble)
 	{
-		result.object = this;
+		hit.object = this;
 		return (true);
 	}
 	else
@@ -77,6 +77,12 @@ bool Box::Intersect(const Ray& ray, Intersection& result)
 }
 
 
+sivelab::Vector3D Box::GetNormal(const Ray& ray, const HitRecord& hit)
+{
+	return (hit.primitive->GetNormal(ray, hit));
+}
+
+
 void Box::ConstructBox(const sivelab::Vector3D& minPoint, const sivelab::Vector3D& maxPoint)
 {
 	// Save minimum and maximum points into bounding box.
@@ -1,6 +1,7 @@
 #include "CosineShader.h"
 #include "Scene.h"
 #include "Intersection.h"
+#include "ShadingTerms.h"
 #include "Vector3D.h"
 
 using namespace sivelab;
@@ -16,41 +17,49 @@ CosineShader::CosineShader(Scene* scene, const Color& diffuse)
 
 Color CosineShader::Shade(Intersection& intersection)
 {
-	LightList::const_iterator iter = m_scene->GetLightsBegin();
-	LightList::const_iterator end = m_scene->GetLightsEnd();
-	Color finalColor;
+	ShadingTerms terms;
+	Decompose(intersection, terms);
+	return (m_scene->ResolveShadingTerms(intersection, terms));
+}
+
+
+bool CosineShader::IsViewIndependent() const
+{
+	// Lambertian reflection looks the same from every direction.
+	return (true);
+}
+
 
+bool CosineShader::Decompose(Intersection& intersection, ShadingTerms& terms)
+{
 	Vector3D &normal = intersection.surfaceNormal;
 	Vector3D intersectPoint = intersection.collidedRay.GetPositionAtTime(intersection.t);
 
-	// Go through the entire list of lights.
-	while (iter != end)
+	// Always add the ambient amount of light.
+	Color ambient = m_scene->GetAmbient();
+	ambient.MultiplyColors(m_diffuse);
+	for (int i = m_scene->GetAmbientCount(); i > 0; i--)
 	{
-		Vector3D lightDir = (*iter)->GetPosition() - intersectPoint;
+		terms.base.AddColors(ambient);
+	}
+
+	// Go through the lights picked for this point.
+	LightChoiceList lights;
+	m_scene->SelectLights(intersection, lights);
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		const LightRecord *light = lights[i].light;
+		Vector3D lightDir = light->position - intersectPoint;
 		lightDir.normalize();
 
-		// Always add the ambient amount of light.
-		Color ambient = m_scene->GetAmbient();
-		ambient.MultiplyColors(m_diffuse);
-		finalColor.AddColors(ambient);
-
-		// See if we are in shadow.
-		if (m_scene->CastShadowRay(*iter, intersection) == false)
-		{
-			// We are not in shadow.
-			// color = diffuse * lightRadiance * max(0, n dot l)
-			double nDotL = max(0.0, normal.dot(lightDir));
-			const Color &radiance = (*iter)->GetRadiance(intersectPoint);
-			Color diffuse;
-			diffuse = m_diffuse;
-			diffuse.MultiplyColors(radiance).LinearMult(nDotL);
-			finalColor.AddColors(diffuse);
-		}
-
-		// Go to next light.
-		iter++;
+		// This only counts if we are not in shadow.
+		// color = diffuse * lightRadiance * max(0, n dot l)
+		double nDotL = max(0.0, normal.dot(lightDir));
+		Color diffuse;
+		diffuse = m_diffuse;
+		diffuse.MultiplyColors(light->radiance).LinearMult(nDotL * lights[i].weight);
+		terms.AddLight(light, diffuse);
 	}
 
-	return (finalColor);
+	return (true);
 }
-
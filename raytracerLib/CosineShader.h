@@ -20,6 +20,10 @@ public:
 
 	virtual Color Shade(Intersection  &intersection);
 
+	virtual bool Decompose(Intersection &intersection, ShadingTerms &terms);
+
+	virtual bool IsViewIndependent() const;
+
 private:
 	/**
 	 * The diffuse color.
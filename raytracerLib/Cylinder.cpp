@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "Cylinder.h"
 #include "Ray.h"
 #include "Intersection.h"
@@ -45,7 +47,7 @@ BBox Cylinder::GetBoundingBox()
 }
 
 
-bool Cylinder::Intersect(const Ray& ray, Intersection& result)
+bool Cylinder::Intersect(const Ray& ray, HitRecord& hit)
 {
 	double minY = m_center[1] - m_height / 2.0;
 	double maxY = m_center[1] + m_height / 2.0;
@@ -120,42 +122,37 @@ bool Cylinder::Intersect(const Ray& ray, Intersection& result)
 	}
 
 	// Select the smallest time value as the intersection time.
-	sivelab::Vector3D *intersectPoint = NULL;
-	if (t1 < t2)
-	{
-		// Choose t1.
-		result.t = t1;
-		intersectPoint = &intersectPointT1;
-	}
-	else
-	{
-		// Choose t2.
-		result.t = t2;
-		intersectPoint = &intersectPointT2;
-	}
+	hit.t = std::min(t1, t2);
 
 	// If we got here, we hit the cylinder.
-	// Fill in the rest of the intersection structure.
-	result.collidedRay = ray;
-	result.object = this;
+	// Remember the exact time, since the normal is calculated at the exact intersection point.
+	hit.object = this;
+	hit.primitive = this;
+	hit.u = hit.t;
+
+	// Ensure that the ray stays on the right side of whatever it hit by dialing back the time a little.
+	hit.t -= EPSILON;
 
+	return (true);
+}
+
+
+sivelab::Vector3D Cylinder::GetNormal(const Ray& ray, const HitRecord& hit)
+{
 	// Calculate the outside-facing normal.
-	result.surfaceNormal = *intersectPoint - m_center;
-	result.surfaceNormal[1] = 0;
-	result.surfaceNormal.normalize();
+	sivelab::Vector3D normal = ray.GetPositionAtTime(hit.u) - m_center;
+	normal[1] = 0;
+	normal.normalize();
 
 	// If the angle of incidence of the incoming ray and the normal is greater than 180 degrees, flip the normal.
 	sivelab::Vector3D incoming = ray.GetDirection();
 	incoming.normalize();
-	if (result.surfaceNormal.dot(incoming) > 0)
+	if (normal.dot(incoming) > 0)
 	{
 		// This ray hit on the inside.
-		result.surfaceNormal *= -1.0;
+		normal *= -1.0;
 	}
 
-	// Ensure that the ray stays on the right side of whatever it hit by dialing back the time a little.
-	result.t -= EPSILON;
-
-	return (true);
+	return (normal);
 }
 
@@ -0,0 +1,579 @@
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+#include "DeferredRenderer.h"
+#include "Scene.h"
+#include "Image.h"
+#include "Intersection.h"
+#include "ThreadPool.h"
+#include "EngineException.h"
+
+using namespace std;
+
+
+const int DeferredRenderer::SHADE_BATCH_SIZE;
+
+
+DeferredRenderer::DeferredRenderer(Scene* scene)
+{
+	m_scene = scene;
+	m_width = 0;
+	m_height = 0;
+	m_samplesPerPixel = 0;
+	m_pixelMask = NULL;
+	m_valid = false;
+	m_reused = false;
+	m_samplerType = 0;
+}
+
+
+/**
+ * Everything needed for a thread to do part of a pass.
+ */
+struct DeferredJobInfo
+{
+	DeferredRenderer *renderer;
+	int start, end;
+};
+
+
+/**
+ * Traces a chunk of rows into the G-buffer.
+ * @param info Pointer to the DeferredJobInfo structure for the chunk, where start and end are rows.
+ */
+void *TraceDeferredRows(void *info)
+{
+	DeferredJobInfo *jobInfo = (DeferredJobInfo*)info;
+	jobInfo->renderer->TraceRows(jobInfo->start, jobInfo->end);
+
+	return (NULL);
+}
+
+
+/**
+ * Shades a batch of hits.
+ * @param info Pointer to the DeferredJobInfo structure for the batch, where start and end index the sorted hits.
+ */
+void *ShadeDeferredHits(void *info)
+{
+	DeferredJobInfo *jobInfo = (DeferredJobInfo*)info;
+	jobInfo->renderer->ShadeHits(jobInfo->start, jobInfo->end);
+
+	return (NULL);
+}
+
+
+/**
+ * Runs a job for each part of a pass, on the given number of threads.
+ */
+static void RunJobs(void *(*job)(void*), vector<DeferredJobInfo> &parts, int threadCount)
+{
+	if (threadCount == 1)
+	{
+		for (size_t i = 0; i < parts.size(); i++)
+		{
+			job(&parts[i]);
+		}
+		return;
+	}
+
+	ThreadEngine::ThreadPool renderPool(threadCount);
+	renderPool.StartProcessing();
+
+	renderPool.AddJobs(job, parts);
+
+	// Wait for all jobs to be completed.
+	renderPool.JoinAll();
+}
+
+
+void DeferredRenderer::Render(Image& image, int threadCount, Image *sampleCounts, const vector<bool> *pixelMask)
+{
+	int imageWidth = image.GetWidth();
+	int imageHeight = image.GetHeight();
+
+	// Tell the camera how big the image is.
+	m_scene->m_camera->SetImageDimensions(imageWidth, imageHeight);
+
+	// Masked G-buffers are incomplete, so they are never saved.
+	const string &cacheFilename = m_scene->PrimaryHitCacheFileName;
+	bool useCache = (cacheFilename != "") && (pixelMask == NULL);
+
+	bool traced = false;
+	m_reused = CanReuse(imageWidth, imageHeight, pixelMask);
+	if (!m_reused)
+	{
+		m_width = imageWidth;
+		m_height = imageHeight;
+		m_samplesPerPixel = m_scene->m_camera->GetSamplesPerPixel();
+		m_pixelMask = pixelMask;
+		m_samplerType = m_scene->m_samplerType;
+
+		m_reused = useCache && LoadCache(cacheFilename);
+		if (!m_reused)
+		{
+			Trace(threadCount);
+			traced = true;
+		}
+		m_valid = true;
+	}
+
+	size_t shadowCount = GetShadowCount();
+	Shade(threadCount);
+	Resolve(image, sampleCounts);
+
+	// Only write the cache if there is something new in it.
+	if (useCache && (traced || (GetShadowCount() != shadowCount)))
+	{
+		SaveCache(cacheFilename);
+	}
+}
+
+
+void DeferredRenderer::Invalidate()
+{
+	m_valid = false;
+	m_gbuffer.clear();
+	m_shadeOrder.clear();
+	m_visibility.clear();
+}
+
+
+bool DeferredRenderer::WasReused() const
+{
+	return (m_reused);
+}
+
+
+bool DeferredRenderer::CanReuse(int width, int height, const vector<bool> *pixelMask) const
+{
+	// Masks change from render to render, so a masked G-buffer is never trusted.
+	if (!m_valid || (pixelMask != NULL) || (m_pixelMask != NULL))
+	{
+		return (false);
+	}
+
+	return ((width == m_width) && (height == m_height) &&
+		(m_samplesPerPixel == m_scene->m_camera->GetSamplesPerPixel()) && (m_samplerType == m_scene->m_samplerType));
+}
+
+
+/**
+ * Orders sample indices by the shader that was hit, so that each shader's hits are shaded together.
+ * Ties are broken by index, so the order does not depend on the sorting algorithm.
+ */
+struct CompareSamplesByShader
+{
+	CompareSamplesByShader(const vector<IShader*> &shaders) : m_shaders(shaders) { }
+
+	bool operator()(int a, int b) const
+	{
+		if (m_shaders[a] != m_shaders[b])
+		{
+			return (less<IShader*>()(m_shaders[a], m_shaders[b]));
+		}
+		return (a < b);
+	}
+
+	const vector<IShader*> &m_shaders;
+};
+
+
+void DeferredRenderer::Trace(int threadCount)
+{
+	m_gbuffer.resize(m_width * m_height * m_samplesPerPixel);
+	m_visibility.assign(m_gbuffer.size(), ShadowVisibility());
+
+	// Trace a row per job.
+	vector<DeferredJobInfo> rows(m_height);
+	for (int y = 0; y < m_height; y++)
+	{
+		rows[y].renderer = this;
+		rows[y].start = y;
+		rows[y].end = y + 1;
+	}
+	RunJobs(TraceDeferredRows, rows, threadCount);
+
+	SortByShader();
+}
+
+
+void DeferredRenderer::SortByShader()
+{
+	size_t sampleCount = m_gbuffer.size();
+	vector<IShader*> shaders(sampleCount);
+	m_shadeOrder.clear();
+	for (size_t i = 0; i < sampleCount; i++)
+	{
+		shaders[i] = m_gbuffer[i].shader;
+		if (shaders[i] != NULL)
+		{
+			m_shadeOrder.push_back(i);
+		}
+	}
+
+	sort(m_shadeOrder.begin(), m_shadeOrder.end(), CompareSamplesByShader(shaders));
+}
+
+
+void DeferredRenderer::TraceRows(int startY, int endY)
+{
+	ICamera *camera = m_scene->m_camera;
+	const ISampler *sampler = m_scene->m_sampler;
+
+	Intersection intersect;
+	for (int y = startY; y < endY; y++)
+	{
+		for (int x = 0; x < m_width; x++)
+		{
+			GBufferSample *samples = &m_gbuffer[(y * m_width + x) * m_samplesPerPixel];
+			bool masked = (m_pixelMask != NULL) && !(*m_pixelMask)[y * m_width + x];
+
+			RayList rayList;
+			if (!masked)
+			{
+				rayList = camera->CalculateViewingRays(x, y, *sampler);
+			}
+
+			for (int i = 0; i < m_samplesPerPixel; i++)
+			{
+				GBufferSample &sample = samples[i];
+				sample.object = NULL;
+				sample.shader = NULL;
+
+				if (!masked && m_scene->CastRay(rayList[i], intersect))
+				{
+					sample.ray = intersect.collidedRay;
+					sample.t = intersect.t;
+					sample.normal = intersect.surfaceNormal;
+					sample.object = intersect.object;
+					sample.shader = intersect.object->GetShader();
+				}
+			}
+		}
+	}
+}
+
+
+void DeferredRenderer::Shade(int threadCount)
+{
+	// Rays that hit nothing add the background color, which is black.
+	m_sampleColors.assign(m_gbuffer.size(), Color());
+
+	// Shade a batch of sorted hits per job.
+	int hitCount = m_shadeOrder.size();
+	vector<DeferredJobInfo> batches;
+	for (int start = 0; start < hitCount; start += SHADE_BATCH_SIZE)
+	{
+		DeferredJobInfo batch;
+		batch.renderer = this;
+		batch.start = start;
+		batch.end = min(hitCount, start + SHADE_BATCH_SIZE);
+		batches.push_back(batch);
+	}
+	RunJobs(ShadeDeferredHits, batches, threadCount);
+}
+
+
+void DeferredRenderer::ShadeHits(int start, int end)
+{
+	const ISampler *sampler = m_scene->m_sampler;
+
+	for (int i = start; i < end; i++)
+	{
+		int index = m_shadeOrder[i];
+		const GBufferSample &sample = m_gbuffer[index];
+		int pixel = index / m_samplesPerPixel;
+
+		// Give the hit the same samples that a regular render would have.
+		PixelSampler samples;
+		samples.Start(sampler, pixel % m_width, pixel / m_width, m_samplesPerPixel);
+		samples.SetCurrentSample(index % m_samplesPerPixel);
+
+		Intersection intersect;
+		intersect.collidedRay = sample.ray;
+		intersect.t = sample.t;
+		intersect.surfaceNormal = sample.normal;
+		intersect.object = sample.object;
+		intersect.samples = &samples;
+
+		m_sampleColors[index] = m_scene->ShadeIntersection(intersect, Scene::DEFAULT_REFLECTION_DEPTH, &m_visibility[index]);
+	}
+}
+
+
+void DeferredRenderer::Resolve(Image& image, Image *sampleCounts)
+{
+	for (int y = 0; y < m_height; y++)
+	{
+		for (int x = 0; x < m_width; x++)
+		{
+			if ((m_pixelMask != NULL) && !(*m_pixelMask)[y * m_width + x])
+			{
+				continue;
+			}
+
+			// Take average of each ray's color.
+			const Color *colors = &m_sampleColors[(y * m_width + x) * m_samplesPerPixel];
+			Color color;
+			for (int i = 0; i < m_samplesPerPixel; i++)
+			{
+				color.AddColors(colors[i]);
+			}
+			color.LinearMult(1.0 / m_samplesPerPixel);
+
+			// Flip Y, because we are rendering upside down.
+			int imageY = m_height - 1 - y;
+			image.SetPixel(x, imageY, color);
+
+			if (sampleCounts != NULL)
+			{
+				sampleCounts->SetPixel(x, imageY, Scene::GetSampleCountColor(m_samplesPerPixel, m_samplesPerPixel));
+			}
+		}
+	}
+}
+
+
+/**
+ * Identifies primary hit cache files, and the version of their layout.
+ */
+static const char CACHE_MAGIC[8] = { 'R', 'T', 'H', 'I', 'T', 'S', '0', '1' };
+
+
+/**
+ * Writes a value to a binary stream, as it is laid out in memory.
+ */
+template <typename T>
+static void WriteValue(ostream &out, const T &value)
+{
+	out.write((const char*)&value, sizeof(value));
+}
+
+
+/**
+ * Reads a value written by WriteValue().
+ */
+template <typename T>
+static void ReadValue(istream &in, T &value)
+{
+	in.read((char*)&value, sizeof(value));
+}
+
+
+/**
+ * Writes the three components of a vector to a binary stream.
+ */
+static void WriteVector(ostream &out, const sivelab::Vector3D &vector)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		WriteValue(out, vector[i]);
+	}
+}
+
+
+/**
+ * Reads a vector written by WriteVector().
+ */
+static void ReadVector(istream &in, sivelab::Vector3D &vector)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		ReadValue(in, vector[i]);
+	}
+}
+
+
+bool DeferredRenderer::LoadCache(const string& filename)
+{
+	ifstream in(filename.c_str(), ios::in | ios::binary);
+	if (!in)
+	{
+		return (false);
+	}
+
+	char magic[sizeof(CACHE_MAGIC)];
+	uint64_t geometryHash, cameraHash, lightHash;
+	int32_t width, height, samplesPerPixel, samplerType;
+	uint64_t objectCount;
+	in.read(magic, sizeof(magic));
+	ReadValue(in, geometryHash);
+	ReadValue(in, cameraHash);
+	ReadValue(in, lightHash);
+	ReadValue(in, width);
+	ReadValue(in, height);
+	ReadValue(in, samplesPerPixel);
+	ReadValue(in, samplerType);
+	ReadValue(in, objectCount);
+
+	const ObjectList &objects = m_scene->m_sceneObjects;
+	bool matches = in && (memcmp(magic, CACHE_MAGIC, sizeof(magic)) == 0) &&
+		(geometryHash == m_scene->m_geometryHash) && (cameraHash == m_scene->m_cameraHash) &&
+		(width == m_width) && (height == m_height) && (samplesPerPixel == m_samplesPerPixel) &&
+		(samplerType == m_samplerType) && (objectCount == objects.size());
+	if (!matches)
+	{
+		if (m_scene->VerboseOutput)
+		{
+			cout << "The primary hit cache " << filename << " is for a different scene, so it will be replaced." << endl;
+		}
+		return (false);
+	}
+
+	m_gbuffer.resize(m_width * m_height * m_samplesPerPixel);
+	for (size_t i = 0; i < m_gbuffer.size(); i++)
+	{
+		GBufferSample &sample = m_gbuffer[i];
+		sample.object = NULL;
+		sample.shader = NULL;
+
+		int32_t objectId;
+		ReadValue(in, objectId);
+		if ((objectId < 0) || (objectId >= (int32_t)objects.size()))
+		{
+			continue;
+		}
+
+		sivelab::Vector3D position, direction;
+		ReadValue(in, sample.t);
+		ReadVector(in, position);
+		ReadVector(in, direction);
+		ReadVector(in, sample.normal);
+		sample.ray = Ray(position, direction);
+		sample.object = objects[objectId];
+		sample.shader = sample.object->GetShader();
+	}
+
+	// The shadows only still hold if none of the lights have moved.
+	m_visibility.assign(m_gbuffer.size(), ShadowVisibility());
+	if (lightHash == m_scene->GetLightGeometryHash())
+	{
+		for (size_t i = 0; i < m_visibility.size(); i++)
+		{
+			int32_t entryCount;
+			ReadValue(in, entryCount);
+			if (!in || (entryCount < 0))
+			{
+				break;
+			}
+
+			vector<int> &entries = m_visibility[i].entries;
+			entries.resize(entryCount);
+			if (entryCount > 0)
+			{
+				in.read((char*)&entries[0], entryCount * sizeof(int));
+			}
+		}
+	}
+
+	if (!in)
+	{
+		// The file was cut short.  Start over, rather than trust any of it.
+		if (m_scene->VerboseOutput)
+		{
+			cout << "The primary hit cache " << filename << " is incomplete, so it will be replaced." << endl;
+		}
+		return (false);
+	}
+
+	SortByShader();
+
+	if (m_scene->VerboseOutput)
+	{
+		cout << "Loaded " << m_gbuffer.size() << " primary hits and " << GetShadowCount() << " shadows from " << filename << "." << endl;
+	}
+
+	return (true);
+}
+
+
+void DeferredRenderer::SaveCache(const string& filename) const
+{
+	// Objects are saved by their index in the scene, since their addresses change from run to run.
+	const ObjectList &objects = m_scene->m_sceneObjects;
+	map<IObject*, int32_t> objectIds;
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		objectIds[objects[i]] = i;
+	}
+
+	// Write to a temporary file first, so that a crash never leaves a half written cache behind.
+	string temporaryFilename = filename + ".tmp";
+	{
+		ofstream out(temporaryFilename.c_str(), ios::out | ios::binary | ios::trunc);
+		if (!out)
+		{
+			throw EngineException("Unable to open primary hit cache " + temporaryFilename + " for writing!");
+		}
+
+		out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+		WriteValue(out, m_scene->m_geometryHash);
+		WriteValue(out, m_scene->m_cameraHash);
+		WriteValue(out, m_scene->GetLightGeometryHash());
+		WriteValue(out, (int32_t)m_width);
+		WriteValue(out, (int32_t)m_height);
+		WriteValue(out, (int32_t)m_samplesPerPixel);
+		WriteValue(out, (int32_t)m_samplerType);
+		WriteValue(out, (uint64_t)objects.size());
+
+		for (size_t i = 0; i < m_gbuffer.size(); i++)
+		{
+			const GBufferSample &sample = m_gbuffer[i];
+			map<IObject*, int32_t>::const_iterator idIter = objectIds.find(sample.object);
+			if (idIter == objectIds.end())
+			{
+				WriteValue(out, (int32_t)-1);
+				continue;
+			}
+
+			WriteValue(out, idIter->second);
+			WriteValue(out, sample.t);
+			WriteVector(out, sample.ray.GetPosition());
+			WriteVector(out, sample.ray.GetDirection());
+			WriteVector(out, sample.normal);
+		}
+
+		for (size_t i = 0; i < m_visibility.size(); i++)
+		{
+			const vector<int> &entries = m_visibility[i].entries;
+			WriteValue(out, (int32_t)entries.size());
+			if (!entries.empty())
+			{
+				out.write((const char*)&entries[0], entries.size() * sizeof(int));
+			}
+		}
+
+		if (!out)
+		{
+			throw EngineException("Unable to write primary hit cache " + temporaryFilename + "!");
+		}
+	}
+
+	if (rename(temporaryFilename.c_str(), filename.c_str()) != 0)
+	{
+		throw EngineException("Unable to move primary hit cache " + temporaryFilename + " to " + filename + "!");
+	}
+
+	if (m_scene->VerboseOutput)
+	{
+		cout << "Wrote " << m_gbuffer.size() << " primary hits and " << GetShadowCount() << " shadows to " << filename << "." << endl;
+	}
+}
+
+
+size_t DeferredRenderer::GetShadowCount() const
+{
+	size_t count = 0;
+	for (size_t i = 0; i < m_visibility.size(); i++)
+	{
+		count += m_visibility[i].entries.size();
+	}
+
+	return (count);
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include "Ray.h"
+#include "Color.h"
+#include "Vector3D.h"
+#include "ShadowVisibility.h"
+
+class Scene;
+class Image;
+class IObject;
+class IShader;
+
+
+/**
+ * Renders a scene in two passes over a G-buffer.
+ * The first pass traces every primary ray of every pixel, and stores what it hit in the G-buffer.
+ * The second pass sorts the hits by shader, and shades them in batches, so that each shader's code and data stay in the cache.
+ * The G-buffer is kept between renders, so that a scene whose lights or shaders have changed can be shaded again
+ * without tracing its primary rays again, as long as the camera, objects, image size and sampler are the same.
+ * The shadows of the primary hits are kept along with it, and if Scene::PrimaryHitCacheFileName is set,
+ * both are saved to disk so that later runs can skip straight to shading.
+ */
+class DeferredRenderer
+{
+public:
+	/**
+	 * Sets up the renderer to render the given scene.
+	 */
+	DeferredRenderer(Scene *scene);
+
+	/**
+	 * Renders the entire scene to the given image.
+	 * Only traces the primary rays if the G-buffer can't be reused.  Every pixel takes every sample, even with adaptive sampling.
+	 * @param image The image to render to.
+	 * @param threadCount The number of threads to render with.  Must be at least 1.
+	 * @param sampleCounts If not NULL, the number of samples taken in each pixel is written here.  See Scene::Render().
+	 * @param pixelMask If not NULL, only the pixels that are true are rendered.  Indexed by y * width + x, where y is not flipped.
+	 *                  The G-buffer of a masked render is never reused.
+	 */
+	void Render(Image &image, int threadCount, Image *sampleCounts, const std::vector<bool> *pixelMask);
+
+	/**
+	 * Forgets the G-buffer, so that the next render traces its primary rays again.
+	 * Has to be called whenever the camera or any objects change.
+	 */
+	void Invalidate();
+
+	/**
+	 * Returns true if the last render reused the G-buffer, from memory or from disk, instead of tracing primary rays.
+	 */
+	bool WasReused() const;
+
+	/**
+	 * Traces the primary rays of the given rows into the G-buffer.
+	 * Threadsafe as long as no two threads trace the same rows.
+	 * @param startY The first row to trace, in camera space.
+	 * @param endY One past the last row to trace.
+	 */
+	void TraceRows(int startY, int endY);
+
+	/**
+	 * The number of hits shaded by each job.  Each job's hits are contiguous in the sorted order, so mostly share a shader.
+	 */
+	static const int SHADE_BATCH_SIZE = 4096;
+
+	/**
+	 * Shades part of the hits, in the order they were sorted in.
+	 * Threadsafe as long as no two threads shade the same part.
+	 * @param start The index of the first hit in m_shadeOrder to shade.
+	 * @param end One past the index of the last hit to shade.
+	 */
+	void ShadeHits(int start, int end);
+
+private:
+	/**
+	 * Everything needed to shade a single primary hit.  The position of the hit is ray.GetPositionAtTime(t).
+	 */
+	struct GBufferSample
+	{
+		Ray ray;
+		double t;
+		sivelab::Vector3D normal;
+
+		/**
+		 * The object and shader that were hit.  Both are NULL if the ray hit nothing.
+		 */
+		IObject *object;
+		IShader *shader;
+	};
+
+	/**
+	 * Returns true if the G-buffer was filled in for the same image size, rays per pixel, and sampler.
+	 */
+	bool CanReuse(int width, int height, const std::vector<bool> *pixelMask) const;
+
+	/**
+	 * Traces every primary ray into the G-buffer, and sorts the hits by shader.
+	 */
+	void Trace(int threadCount);
+
+	/**
+	 * Fills m_shadeOrder with the index of every sample that hit something, sorted by shader.
+	 */
+	void SortByShader();
+
+	/**
+	 * Shades every hit in the G-buffer into m_sampleColors.
+	 */
+	void Shade(int threadCount);
+
+	/**
+	 * Averages the samples of every pixel into the image.
+	 */
+	void Resolve(Image &image, Image *sampleCounts);
+
+	/**
+	 * Fills the G-buffer from the given cache file, if it was written for the same geometry, camera, image size and sampler.
+	 * The shadows are only loaded if the lights are in the same places, too.
+	 * @return False if the file does not exist or does not match, in which case the G-buffer has to be traced.
+	 */
+	bool LoadCache(const std::string &filename);
+
+	/**
+	 * Writes the G-buffer and the shadows of its hits to the given cache file.
+	 * The file is only readable on machines with the same byte order.
+	 * @throws EngineException If the file can't be written.
+	 */
+	void SaveCache(const std::string &filename) const;
+
+	/**
+	 * Gets the total number of lights recorded in the shadows of every hit.
+	 */
+	size_t GetShadowCount() const;
+
+	Scene *m_scene;
+
+	/**
+	 * The size of the image and the number of samples per pixel that the G-buffer holds.
+	 * The G-buffer is indexed by (y * m_width + x) * m_samplesPerPixel + sample, where y is not flipped.
+	 */
+	int m_width, m_height, m_samplesPerPixel;
+	const std::vector<bool> *m_pixelMask;
+	std::vector<GBufferSample> m_gbuffer;
+	bool m_valid;
+	bool m_reused;
+
+	/**
+	 * The type of sampler the G-buffer was traced with, so that a render with a different sampler traces again.
+	 */
+	int m_samplerType;
+
+	/**
+	 * The index of every sample that hit something, sorted by shader.
+	 */
+	std::vector<int> m_shadeOrder;
+
+	/**
+	 * The color of every sample.  Samples that hit nothing stay black.
+	 */
+	std::vector<Color> m_sampleColors;
+
+	/**
+	 * Which lights each sample's hit can see.  Filled in as the hits are shaded, and valid as long as the G-buffer is.
+	 */
+	std::vector<ShadowVisibility> m_visibility;
+};
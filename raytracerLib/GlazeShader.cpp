@@ -1,5 +1,6 @@
 #include "GlazeShader.h"
 #include "Scene.h"
+#include "ShadingTerms.h"
 
 
 GlazeShader::GlazeShader(Scene* scene, Color diffuse, double mirrorCoef): CosineShader(scene, diffuse)
@@ -15,18 +16,29 @@ GlazeShader::~GlazeShader()
 
 Color GlazeShader::Shade(Intersection& intersection)
 {
-	// Calculate the base diffuse color.
-	Color diffuseColor = CosineShader::Shade(intersection);
+	ShadingTerms terms;
+	Decompose(intersection, terms);
+	return (m_scene->ResolveShadingTerms(intersection, terms));
+}
+
+
+bool GlazeShader::IsViewIndependent() const
+{
+	// The glaze reflects, so unlike the diffuse part underneath it, it depends on where it is seen from.
+	return (false);
+}
+
 
-	// Shoot off a ray to get the reflection.
-	Color reflectedColor = m_scene->CastReflectionRay(intersection, 0.0);
+bool GlazeShader::Decompose(Intersection& intersection, ShadingTerms& terms)
+{
+	// Calculate the base diffuse terms.
+	CosineShader::Decompose(intersection, terms);
 
 	// Combine the reflected color and the diffuse color.
-	diffuseColor.LinearMult(1.0 - m_mirrorCoef);
-	reflectedColor.LinearMult(m_mirrorCoef);
-	Color finalColor;
-	finalColor.AddColors(diffuseColor).AddColors(reflectedColor);
+	terms.Scale(1.0 - m_mirrorCoef);
+	terms.reflects = true;
+	terms.reflectance = Color(m_mirrorCoef, m_mirrorCoef, m_mirrorCoef);
+	terms.roughness = 0.0;
 
-	return (finalColor);
+	return (true);
 }
-
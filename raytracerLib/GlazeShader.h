@@ -15,6 +15,10 @@ public:
 
 	virtual Color Shade(Intersection& intersection);
 
+	virtual bool Decompose(Intersection& intersection, ShadingTerms& terms);
+
+	virtual bool IsViewIndependent() const;
+
 private:
 	double m_mirrorCoef;
 };
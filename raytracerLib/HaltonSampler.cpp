@@ -0,0 +1,55 @@
+#include "HaltonSampler.h"
+#include "RandomGenerator.h"
+
+
+/**
+ * The prime bases for each axis of each dimension.
+ * Higher primes are worse, so dimensions past the end of the list wrap around, and rely on the scrambling alone.
+ */
+static const int HALTON_PRIMES[] =
+{
+	2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+	59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131
+};
+static const int HALTON_PRIME_COUNT = sizeof(HALTON_PRIMES) / sizeof(HALTON_PRIMES[0]);
+
+
+double HaltonSampler::ScrambledRadicalInverse(uint32_t index, int base, uint64_t seed)
+{
+	double inverseBase = 1.0 / base;
+	double digitWeight = inverseBase;
+	double result = 0.0;
+
+	// The digits seen so far.  Each digit is permuted based on all of the digits before it, which is Owen scrambling.
+	uint64_t prefix = 0;
+
+	// Keep going past the last nonzero digit, since the scrambled zeros are nonzero,
+	// until the digits are too small to make a difference.
+	for (int digitIndex = 0; digitWeight > 1e-10; digitIndex++)
+	{
+		int digit = index % base;
+		index /= base;
+
+		uint32_t shift = (uint32_t)RandomGenerator::Hash(seed, prefix, digitIndex) % base;
+		result += ((digit + shift) % base) * digitWeight;
+
+		prefix = prefix * base + digit;
+		digitWeight *= inverseBase;
+	}
+
+	// Make sure rounding can not push us to 1.0.
+	return (result < 1.0 ? result : 1.0 - 1e-10);
+}
+
+
+Sample HaltonSampler::GetSample(int pixelX, int pixelY, int index, int sampleCount, int dimension) const
+{
+	int baseX = HALTON_PRIMES[(2 * dimension) % HALTON_PRIME_COUNT];
+	int baseY = HALTON_PRIMES[(2 * dimension + 1) % HALTON_PRIME_COUNT];
+
+	uint64_t seed = RandomGenerator::Hash(pixelX, pixelY, dimension);
+
+	double sampleX = ScrambledRadicalInverse(index, baseX, seed);
+	double sampleY = ScrambledRadicalInverse(index, baseY, RandomGenerator::Hash(seed));
+	return (std::make_pair(sampleX, sampleY));
+}
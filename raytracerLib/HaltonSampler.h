@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ISampler.h"
+
+
+/**
+ * Generates samples from the Halton sequence.
+ * Each 2D dimension uses its own pair of prime bases, and every pixel gets its own Owen scrambling.
+ * Works equally well for any number of samples.
+ */
+class HaltonSampler : public ISampler
+{
+public:
+	virtual Sample GetSample(int pixelX, int pixelY, int index, int sampleCount, int dimension) const;
+
+private:
+	/**
+	 * Computes the Owen scrambled radical inverse of the index in the given base.
+	 * @param index The index to invert.
+	 * @param base The prime base to invert in.
+	 * @param seed Determines the scrambling.
+	 */
+	static double ScrambledRadicalInverse(uint32_t index, int base, uint64_t seed);
+};
@@ -0,0 +1,706 @@
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include <fstream>
+#include <zlib.h>
+
+#include "HdrFile.h"
+#include "Image.h"
+#include "EngineException.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+
+/**
+ * The first four bytes of every OpenEXR file.
+ */
+static const uint8_t EXR_MAGIC[] = { 0x76, 0x2F, 0x31, 0x01 };
+
+/**
+ * The OpenEXR file version, and the flags in the version field that mark files this reader does not handle.
+ */
+static const uint32_t EXR_VERSION = 2;
+static const uint32_t EXR_TILED_FLAG = 0x200;
+static const uint32_t EXR_NON_IMAGE_FLAG = 0x800;
+static const uint32_t EXR_MULTIPART_FLAG = 0x1000;
+
+/**
+ * The OpenEXR pixel types, and the compression types this reader handles.
+ */
+enum ExrPixelType
+{
+	EXR_UINT = 0,
+	EXR_HALF = 1,
+	EXR_FLOAT = 2
+};
+
+enum ExrCompression
+{
+	EXR_NO_COMPRESSION = 0,
+	EXR_ZIPS_COMPRESSION = 2,
+	EXR_ZIP_COMPRESSION = 3
+};
+
+
+/**
+ * Appends values to a buffer in little endian byte order, which is what OpenEXR uses.
+ */
+static void AppendUint32(vector<uint8_t> &buffer, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		buffer.push_back((uint8_t)(value >> (8 * i)));
+	}
+}
+
+
+static void AppendUint64(vector<uint8_t> &buffer, uint64_t value)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		buffer.push_back((uint8_t)(value >> (8 * i)));
+	}
+}
+
+
+static void AppendFloat(vector<uint8_t> &buffer, float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	AppendUint32(buffer, bits);
+}
+
+
+/**
+ * Appends a string, and the null that ends it.
+ */
+static void AppendString(vector<uint8_t> &buffer, const char *value)
+{
+	buffer.insert(buffer.end(), value, value + strlen(value) + 1);
+}
+
+
+/**
+ * Appends an OpenEXR header attribute.
+ */
+static void AppendAttribute(vector<uint8_t> &buffer, const char *name, const char *type, const vector<uint8_t> &value)
+{
+	AppendString(buffer, name);
+	AppendString(buffer, type);
+	AppendUint32(buffer, value.size());
+	buffer.insert(buffer.end(), value.begin(), value.end());
+}
+
+
+/**
+ * Reads a 32-bit value from the given bytes.
+ */
+static inline uint32_t GetUint32(const uint8_t *bytes, bool bigEndian)
+{
+	if (bigEndian)
+	{
+		return (((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3]);
+	}
+
+	return (((uint32_t)bytes[3] << 24) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[1] << 8) | (uint32_t)bytes[0]);
+}
+
+
+static inline float GetFloat(const uint8_t *bytes, bool bigEndian)
+{
+	uint32_t bits = GetUint32(bytes, bigEndian);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return (value);
+}
+
+
+/**
+ * Converts an IEEE half precision float to a float.
+ */
+static float HalfToFloat(uint16_t half)
+{
+	int exponent = (half >> 10) & 0x1F;
+	int mantissa = half & 0x3FF;
+
+	float value;
+	if (exponent == 0)
+	{
+		value = ldexpf((float)mantissa, -24);
+	}
+	else if (exponent == 31)
+	{
+		value = (mantissa != 0) ? NAN : INFINITY;
+	}
+	else
+	{
+		value = ldexpf((float)(mantissa | 0x400), exponent - 25);
+	}
+
+	return ((half & 0x8000) ? -value : value);
+}
+
+
+/**
+ * Reads the values in an OpenEXR file, making sure that none of them go past the end of it.
+ */
+struct ExrReader
+{
+	ExrReader(const vector<uint8_t> &data, const string &filename) : data(data), filename(filename)
+	{
+		position = 0;
+	}
+
+	const uint8_t *Take(size_t length)
+	{
+		if (length > data.size() - position)
+		{
+			throw EngineException("The OpenEXR file " + filename + " ends too soon!");
+		}
+
+		const uint8_t *bytes = &data[position];
+		position += length;
+		return (bytes);
+	}
+
+	uint32_t ReadUint32()
+	{
+		return (GetUint32(Take(4), false));
+	}
+
+	uint64_t ReadUint64()
+	{
+		uint64_t low = ReadUint32();
+		uint64_t high = ReadUint32();
+		return ((high << 32) | low);
+	}
+
+	string ReadString()
+	{
+		const uint8_t *start = (position < data.size()) ? &data[position] : NULL;
+		const uint8_t *end = (start != NULL) ? (const uint8_t*)memchr(start, 0, data.size() - position) : NULL;
+		if (end == NULL)
+		{
+			throw EngineException("The OpenEXR file " + filename + " ends too soon!");
+		}
+
+		string value((const char*)start, end - start);
+		position += value.size() + 1;
+		return (value);
+	}
+
+	const vector<uint8_t> &data;
+	const string &filename;
+	size_t position;
+};
+
+
+/**
+ * Splits the bytes of a block into the even and odd ones, then replaces each byte with its difference from the one before it.
+ * This is what OpenEXR does before ZIP compression, since the high bytes of neighboring floats tend to match.
+ */
+static void ExrPredict(const vector<uint8_t> &raw, vector<uint8_t> &predicted)
+{
+	size_t length = raw.size();
+	predicted.resize(length);
+
+	size_t half = (length + 1) / 2;
+	for (size_t i = 0; i < length; i++)
+	{
+		predicted[(i % 2 == 0) ? (i / 2) : (half + i / 2)] = raw[i];
+	}
+
+	int previous = (length > 0) ? predicted[0] : 0;
+	for (size_t i = 1; i < length; i++)
+	{
+		int current = predicted[i];
+		predicted[i] = (uint8_t)(current - previous + (128 + 256));
+		previous = current;
+	}
+}
+
+
+/**
+ * Undoes ExrPredict().
+ */
+static void ExrUnpredict(vector<uint8_t> &predicted, vector<uint8_t> &raw)
+{
+	size_t length = predicted.size();
+	for (size_t i = 1; i < length; i++)
+	{
+		predicted[i] = (uint8_t)(predicted[i - 1] + predicted[i] - 128);
+	}
+
+	raw.resize(length);
+	size_t half = (length + 1) / 2;
+	for (size_t i = 0; i < length; i++)
+	{
+		raw[i] = predicted[(i % 2 == 0) ? (i / 2) : (half + i / 2)];
+	}
+}
+
+
+/**
+ * Everything a thread needs to compress a block of rows of an OpenEXR file.
+ */
+struct ExrBlockJobInfo
+{
+	const Image *image;
+	int startY, endY;
+
+	/**
+	 * Filled in with the block's data, compressed unless compressing it made it bigger.
+	 */
+	vector<uint8_t> data;
+
+	/**
+	 * Set if compressing failed.
+	 */
+	bool failed;
+};
+
+
+/**
+ * Lays out and compresses a block of rows.
+ * @param info Pointer to the ExrBlockJobInfo structure for the block.
+ */
+void *CompressExrBlock(void *info)
+{
+	ExrBlockJobInfo *job = (ExrBlockJobInfo*)info;
+	int width = job->image->GetWidth();
+
+	// Each row holds all of its blue values, then all of its green, then all of its red, since channels are sorted by name.
+	vector<uint8_t> raw;
+	raw.reserve((size_t)(job->endY - job->startY) * width * Image::CHANNELS * sizeof(float));
+	for (int y = job->startY; y < job->endY; y++)
+	{
+		const float *row = job->image->GetRow(y);
+		for (int c = Image::CHANNELS - 1; c >= 0; c--)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				AppendFloat(raw, row[Image::CHANNELS * x + c]);
+			}
+		}
+	}
+
+	vector<uint8_t> predicted;
+	ExrPredict(raw, predicted);
+
+	uLongf compressedLength = compressBound(predicted.size());
+	job->data.resize(compressedLength);
+	job->failed = (compress(&job->data[0], &compressedLength, &predicted[0], predicted.size()) != Z_OK);
+	job->data.resize(compressedLength);
+
+	// Readers tell an uncompressed block by its size.
+	if (job->data.size() >= raw.size())
+	{
+		job->data.swap(raw);
+	}
+
+	return (NULL);
+}
+
+
+bool HdrFile::IsHdrFileName(const string &filename)
+{
+	string extension = filename.substr(min(filename.size(), filename.rfind('.')));
+	transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+	return ((extension == ".pfm") || (extension == ".exr"));
+}
+
+
+void HdrFile::Write(const Image &image, const string &filename, int threadCount)
+{
+	string extension = filename.substr(min(filename.size(), filename.rfind('.')));
+	transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+	if (extension == ".pfm")
+	{
+		WritePfm(image, filename);
+	}
+	else if (extension == ".exr")
+	{
+		WriteExr(image, filename, threadCount);
+	}
+	else
+	{
+		throw EngineException("Don't know what kind of HDR file " + filename + " is!");
+	}
+}
+
+
+Image *HdrFile::Read(const string &filename)
+{
+	ifstream in(filename.c_str(), ios::in | ios::binary);
+	if (!in)
+	{
+		throw EngineException("Unable to open " + filename + " for reading!");
+	}
+
+	uint8_t magic[4] = { 0, 0, 0, 0 };
+	in.read((char*)magic, sizeof(magic));
+	in.close();
+
+	if (memcmp(magic, EXR_MAGIC, sizeof(EXR_MAGIC)) == 0)
+	{
+		return (ReadExr(filename));
+	}
+	else if ((magic[0] == 'P') && (magic[1] == 'F'))
+	{
+		return (ReadPfm(filename));
+	}
+
+	throw EngineException(filename + " is not a PFM or OpenEXR file!");
+}
+
+
+void HdrFile::WritePfm(const Image &image, const string &filename)
+{
+	ofstream out(filename.c_str(), ios::out | ios::binary | ios::trunc);
+	if (!out)
+	{
+		throw EngineException("Unable to open " + filename + " for writing!");
+	}
+
+	// A negative scale means the floats are little endian.
+	out << "PF\n" << image.GetWidth() << " " << image.GetHeight() << "\n-1.0\n";
+
+	// The rows go from the bottom up.
+	vector<uint8_t> row;
+	for (int y = image.GetHeight() - 1; y >= 0; y--)
+	{
+		row.clear();
+		const float *pixels = image.GetRow(y);
+		for (int i = 0; i < Image::CHANNELS * image.GetWidth(); i++)
+		{
+			AppendFloat(row, pixels[i]);
+		}
+		out.write((const char*)&row[0], row.size());
+	}
+
+	if (!out)
+	{
+		throw EngineException("Unable to write " + filename + "!");
+	}
+}
+
+
+Image *HdrFile::ReadPfm(const string &filename)
+{
+	ifstream in(filename.c_str(), ios::in | ios::binary);
+	if (!in)
+	{
+		throw EngineException("Unable to open " + filename + " for reading!");
+	}
+
+	string magic;
+	int width = 0, height = 0;
+	double scale = 0.0;
+	in >> magic >> width >> height >> scale;
+
+	// A single whitespace character separates the header from the floats.
+	in.get();
+	if (!in || (magic != "PF") || (width <= 0) || (height <= 0) || (scale == 0.0))
+	{
+		throw EngineException(filename + " is not a color PFM file!");
+	}
+
+	bool bigEndian = (scale > 0.0);
+	Image *image = new Image(width, height);
+	vector<uint8_t> row(Image::CHANNELS * sizeof(float) * (size_t)width);
+	for (int y = height - 1; y >= 0; y--)
+	{
+		if (!in.read((char*)&row[0], row.size()))
+		{
+			delete image;
+			throw EngineException("The PFM file " + filename + " ends too soon!");
+		}
+
+		float *pixels = image->GetRow(y);
+		for (int i = 0; i < Image::CHANNELS * width; i++)
+		{
+			pixels[i] = GetFloat(&row[sizeof(float) * i], bigEndian);
+		}
+	}
+
+	return (image);
+}
+
+
+void HdrFile::WriteExr(const Image &image, const string &filename, int threadCount)
+{
+	int width = image.GetWidth();
+	int height = image.GetHeight();
+
+	vector<uint8_t> header(EXR_MAGIC, EXR_MAGIC + sizeof(EXR_MAGIC));
+	AppendUint32(header, EXR_VERSION);
+
+	// The channels have to be sorted by name.
+	vector<uint8_t> value;
+	const char *channelNames[] = { "B", "G", "R" };
+	for (int c = 0; c < Image::CHANNELS; c++)
+	{
+		AppendString(value, channelNames[c]);
+		AppendUint32(value, EXR_FLOAT);
+		AppendUint32(value, 0);
+		AppendUint32(value, 1);
+		AppendUint32(value, 1);
+	}
+	value.push_back(0);
+	AppendAttribute(header, "channels", "chlist", value);
+
+	value.assign(1, EXR_ZIP_COMPRESSION);
+	AppendAttribute(header, "compression", "compression", value);
+
+	value.clear();
+	AppendUint32(value, 0);
+	AppendUint32(value, 0);
+	AppendUint32(value, width - 1);
+	AppendUint32(value, height - 1);
+	AppendAttribute(header, "dataWindow", "box2i", value);
+	AppendAttribute(header, "displayWindow", "box2i", value);
+
+	// Rows go from the top down.
+	value.assign(1, 0);
+	AppendAttribute(header, "lineOrder", "lineOrder", value);
+
+	value.clear();
+	AppendFloat(value, 1.0f);
+	AppendAttribute(header, "pixelAspectRatio", "float", value);
+	AppendAttribute(header, "screenWindowWidth", "float", value);
+
+	value.clear();
+	AppendFloat(value, 0.0f);
+	AppendFloat(value, 0.0f);
+	AppendAttribute(header, "screenWindowCenter", "v2f", value);
+
+	header.push_back(0);
+
+	// Compress every block, then lay them out one after another, after the table of where each one starts.
+	int blockCount = (height + EXR_ZIP_ROWS - 1) / EXR_ZIP_ROWS;
+	vector<ExrBlockJobInfo> blocks(blockCount);
+	for (int i = 0; i < blockCount; i++)
+	{
+		blocks[i].image = &image;
+		blocks[i].startY = i * EXR_ZIP_ROWS;
+		blocks[i].endY = min((i + 1) * EXR_ZIP_ROWS, height);
+		blocks[i].failed = false;
+	}
+
+	if (threadCount <= 1)
+	{
+		for (int i = 0; i < blockCount; i++)
+		{
+			CompressExrBlock(&blocks[i]);
+		}
+	}
+	else
+	{
+		ThreadEngine::ThreadPool compressPool(threadCount);
+		compressPool.StartProcessing();
+
+		compressPool.AddJobs(CompressExrBlock, blocks);
+
+		// Wait for all jobs to be completed.
+		compressPool.JoinAll();
+	}
+
+	uint64_t offset = header.size() + sizeof(uint64_t) * blockCount;
+	for (int i = 0; i < blockCount; i++)
+	{
+		if (blocks[i].failed)
+		{
+			throw EngineException("Unable to compress the rows of " + filename + "!");
+		}
+
+		AppendUint64(header, offset);
+		offset += 2 * sizeof(uint32_t) + blocks[i].data.size();
+	}
+
+	ofstream out(filename.c_str(), ios::out | ios::binary | ios::trunc);
+	if (!out)
+	{
+		throw EngineException("Unable to open " + filename + " for writing!");
+	}
+
+	out.write((const char*)&header[0], header.size());
+	for (int i = 0; i < blockCount; i++)
+	{
+		vector<uint8_t> blockHeader;
+		AppendUint32(blockHeader, blocks[i].startY);
+		AppendUint32(blockHeader, blocks[i].data.size());
+		out.write((const char*)&blockHeader[0], blockHeader.size());
+		out.write((const char*)&blocks[i].data[0], blocks[i].data.size());
+	}
+
+	if (!out)
+	{
+		throw EngineException("Unable to write " + filename + "!");
+	}
+}
+
+
+Image *HdrFile::ReadExr(const string &filename)
+{
+	vector<uint8_t> data;
+	{
+		ifstream in(filename.c_str(), ios::in | ios::binary);
+		if (!in)
+		{
+			throw EngineException("Unable to open " + filename + " for reading!");
+		}
+
+		data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+	}
+
+	ExrReader reader(data, filename);
+	reader.Take(sizeof(EXR_MAGIC));
+	uint32_t version = reader.ReadUint32();
+	if (((version & 0xFF) != EXR_VERSION) || (version & (EXR_TILED_FLAG | EXR_NON_IMAGE_FLAG | EXR_MULTIPART_FLAG)))
+	{
+		throw EngineException("Only single part scanline OpenEXR files can be read, and " + filename + " is not one!");
+	}
+
+	// Where each channel is in a row, and how big its values are.  The ones that are not R, G or B are skipped over.
+	vector<int> channelTypes, channelTargets;
+	int pixelSize = 0;
+	int compression = -1;
+	int32_t window[4] = { 0, 0, -1, -1 };
+
+	for (string name = reader.ReadString(); name != ""; name = reader.ReadString())
+	{
+		string type = reader.ReadString();
+		uint32_t size = reader.ReadUint32();
+		ExrReader value(data, filename);
+		value.position = reader.position;
+		reader.Take(size);
+
+		if ((name == "channels") && (type == "chlist"))
+		{
+			for (string channel = value.ReadString(); channel != ""; channel = value.ReadString())
+			{
+				int pixelType = value.ReadUint32();
+				value.Take(4);
+				uint32_t xSampling = value.ReadUint32();
+				uint32_t ySampling = value.ReadUint32();
+				if ((pixelType < EXR_UINT) || (pixelType > EXR_FLOAT) || (xSampling != 1) || (ySampling != 1))
+				{
+					throw EngineException("The OpenEXR file " + filename + " has channels that can't be read!");
+				}
+
+				channelTypes.push_back(pixelType);
+				channelTargets.push_back((channel == "R") ? 0 : ((channel == "G") ? 1 : ((channel == "B") ? 2 : -1)));
+				pixelSize += (pixelType == EXR_HALF) ? 2 : 4;
+			}
+		}
+		else if ((name == "compression") && (type == "compression"))
+		{
+			compression = *value.Take(1);
+		}
+		else if ((name == "dataWindow") && (type == "box2i"))
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				window[i] = (int32_t)value.ReadUint32();
+			}
+		}
+	}
+
+	if ((compression != EXR_NO_COMPRESSION) && (compression != EXR_ZIPS_COMPRESSION) && (compression != EXR_ZIP_COMPRESSION))
+	{
+		throw EngineException("The OpenEXR file " + filename + " is compressed in a way that can't be read!");
+	}
+
+	int width = window[2] - window[0] + 1;
+	int height = window[3] - window[1] + 1;
+	if ((width <= 0) || (height <= 0) || (pixelSize == 0))
+	{
+		throw EngineException("The OpenEXR file " + filename + " has no pixels!");
+	}
+
+	int rowsPerBlock = (compression == EXR_ZIP_COMPRESSION) ? EXR_ZIP_ROWS : 1;
+	int blockCount = (height + rowsPerBlock - 1) / rowsPerBlock;
+	size_t rowSize = (size_t)pixelSize * width;
+
+	Image *image = new Image(width, height);
+	try
+	{
+		vector<uint64_t> offsets(blockCount);
+		for (int i = 0; i < blockCount; i++)
+		{
+			offsets[i] = reader.ReadUint64();
+		}
+
+		vector<uint8_t> predicted, raw;
+		for (int i = 0; i < blockCount; i++)
+		{
+			reader.position = min((size_t)offsets[i], data.size());
+			int startY = (int32_t)reader.ReadUint32() - window[1];
+			uint32_t size = reader.ReadUint32();
+			const uint8_t *block = reader.Take(size);
+			if ((startY < 0) || (startY >= height))
+			{
+				throw EngineException("The OpenEXR file " + filename + " has rows outside of its window!");
+			}
+
+			// A block is only stored compressed if that made it smaller.
+			int rowCount = min(rowsPerBlock, height - startY);
+			uLongf rawSize = rowSize * rowCount;
+			if (size < rawSize)
+			{
+				predicted.resize(rawSize);
+				if ((uncompress(&predicted[0], &rawSize, block, size) != Z_OK) || (rawSize != rowSize * rowCount))
+				{
+					throw EngineException("The OpenEXR file " + filename + " has a block that can't be uncompressed!");
+				}
+
+				ExrUnpredict(predicted, raw);
+				block = &raw[0];
+			}
+			else if (size != rawSize)
+			{
+				throw EngineException("The OpenEXR file " + filename + " has a block of the wrong size!");
+			}
+
+			for (int row = 0; row < rowCount; row++)
+			{
+				float *pixels = image->GetRow(startY + row);
+				const uint8_t *values = block + rowSize * row;
+				for (size_t c = 0; c < channelTypes.size(); c++)
+				{
+					int valueSize = (channelTypes[c] == EXR_HALF) ? 2 : 4;
+					int target = channelTargets[c];
+					for (int x = 0; (target >= 0) && (x < width); x++)
+					{
+						const uint8_t *bytes = values + valueSize * x;
+						if (channelTypes[c] == EXR_FLOAT)
+						{
+							pixels[Image::CHANNELS * x + target] = GetFloat(bytes, false);
+						}
+						else if (channelTypes[c] == EXR_HALF)
+						{
+							pixels[Image::CHANNELS * x + target] = HalfToFloat((uint16_t)(bytes[0] | (bytes[1] << 8)));
+						}
+						else
+						{
+							pixels[Image::CHANNELS * x + target] = (float)GetUint32(bytes, false);
+						}
+					}
+					values += (size_t)valueSize * width;
+				}
+			}
+		}
+	}
+	catch (...)
+	{
+		delete image;
+		throw;
+	}
+
+	return (image);
+}
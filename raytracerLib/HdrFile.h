@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+
+class Image;
+
+
+/**
+ * Reads and writes images as floats, before any tone mapping, so that they can be graded or postprocessed later without rendering them again.
+ * Two formats are supported:
+ *  - PFM, the portable float map: a tiny text header followed by the raw floats, with the rows from the bottom up.
+ *  - OpenEXR, as single part scanline files with 32-bit float R, G and B channels.  Blocks of 16 rows are compressed with
+ *    zlib after OpenEXR's byte reordering and delta predictor, the same as its ZIP compression, so any OpenEXR reader can open them.
+ *    Only files like that, and uncompressed ones, can be read back.
+ */
+class HdrFile
+{
+public:
+	/**
+	 * Returns true if the file name ends in .pfm or .exr.
+	 */
+	static bool IsHdrFileName(const std::string &filename);
+
+	/**
+	 * Writes the image to the given file, in the format its extension asks for.
+	 * @param threadCount The number of threads to compress OpenEXR blocks with.
+	 * @throws EngineException If the extension is not known, or the file can't be written.
+	 */
+	static void Write(const Image &image, const std::string &filename, int threadCount = 1);
+
+	/**
+	 * Reads an image written by Write(), or by anything else that writes files this class can read.
+	 * The format is found from the start of the file, not its name.
+	 * @return The image, which the caller has to delete.
+	 * @throws EngineException If the file can't be read, or is not in a supported format.
+	 */
+	static Image *Read(const std::string &filename);
+
+	/**
+	 * Writes a PFM file.
+	 * @throws EngineException If the file can't be written.
+	 */
+	static void WritePfm(const Image &image, const std::string &filename);
+
+	/**
+	 * Writes an OpenEXR file with ZIP compression.
+	 * @param threadCount The number of threads to compress blocks with.
+	 * @throws EngineException If the file can't be written.
+	 */
+	static void WriteExr(const Image &image, const std::string &filename, int threadCount = 1);
+
+	/**
+	 * The number of rows compressed together in an OpenEXR file with ZIP compression.
+	 */
+	static const int EXR_ZIP_ROWS = 16;
+
+private:
+	static Image *ReadPfm(const std::string &filename);
+	static Image *ReadExr(const std::string &filename);
+};
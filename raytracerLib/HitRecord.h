@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+class IObject;
+
+
+/**
+ * The bare minimum needed to know where a ray hit an object.
+ * IObject::Intersect() fills one of these in for every object a ray is tested against, so it is kept small and plain.
+ * Everything else about the hit, like the surface normal, is only worked out for the closest hit.
+ */
+struct HitRecord
+{
+	HitRecord()
+	{
+		t = 0.0;
+		object = NULL;
+		primitive = NULL;
+		u = 0.0;
+		v = 0.0;
+	}
+
+	/**
+	 * The time t that the ray hit the object at.
+	 */
+	double t;
+
+	/**
+	 * The object that was hit.  This is the object whose shader is used, and the one that calculates the normal.
+	 * Objects that contain other objects, like instances, may replace it with themselves.
+	 */
+	IObject *object;
+
+	/**
+	 * The innermost object that was hit, such as a single triangle of a box or a mesh.
+	 * Objects that contain other objects ask it for the normal.
+	 */
+	IObject *primitive;
+
+	/**
+	 * Where on the primitive the hit was.  What these mean is up to the primitive; triangles store barycentric coordinates.
+	 */
+	double u, v;
+};
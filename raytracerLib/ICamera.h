@@ -4,6 +4,8 @@
 
 #include "Ray.h"
 
+class ISampler;
+
 
 /**
  * The type used to store a list of rays.
@@ -37,8 +39,31 @@ public:
 	 * The average color of all of the rays should be taken as the color of the pixel.
 	 * @param imageX The x-coordinate to calculate a ray through.
 	 * @param imageY The y-coordinate to calculate a ray through.
+	 * @param sampler The sampler to take the position of each ray inside of the pixel from.
 	 * @returns A list containing all of the rays that should be shot through the given pixel.
 	 */
-	virtual RayList CalculateViewingRays(double imageX, double imageY) = 0;
+	virtual RayList CalculateViewingRays(double imageX, double imageY, const ISampler &sampler) = 0;
+
+	/**
+	 * Calculates a single one of the rays returned by CalculateViewingRays().
+	 * This lets callers take the samples of a pixel one at a time, without making the whole list.
+	 * @param imageX The x-coordinate to calculate a ray through.
+	 * @param imageY The y-coordinate to calculate a ray through.
+	 * @param sampler The sampler to take the position of the ray inside of the pixel from.
+	 * @param index The index of the ray in the list, from 0 to GetSamplesPerPixel() - 1.
+	 */
+	virtual Ray CalculateViewingRay(double imageX, double imageY, const ISampler &sampler, int index) = 0;
+
+	/**
+	 * Calculates a single viewing ray through the center of the given pixel.
+	 * @param imageX The x-coordinate of the pixel.
+	 * @param imageY The y-coordinate of the pixel.
+	 */
+	virtual Ray CalculateCenterRay(double imageX, double imageY) = 0;
+
+	/**
+	 * Gets the number of rays CalculateViewingRays() returns for each pixel.
+	 */
+	virtual int GetSamplesPerPixel() = 0;
 };
 
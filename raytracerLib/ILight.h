@@ -2,6 +2,7 @@
 
 #include "Vector3D.h"
 #include "Color.h"
+#include "LightRecord.h"
 
 class ILight
 {
@@ -19,5 +20,11 @@ public:
 	 * Gets the radiance that should be cast by the light at the given position, assuming no other objects are in the way.
 	 */
 	virtual Color GetRadiance(const sivelab::Vector3D &position) const = 0;
+
+
+	/**
+	 * Flattens the light into the record that shaders and shadow rays use while rendering.
+	 */
+	virtual LightRecord Compile() const = 0;
 };
 
@@ -1,9 +1,11 @@
 #pragma once
 
+#include "Vector3D.h"
+#include "HitRecord.h"
+
 // Forward declarations.
 class IShader;
-struct Ray;
-struct Intersection;
+class Ray;
 struct BBox;
 
 
@@ -16,10 +18,19 @@ public:
 	/**
 	 * Sees if the given ray intersects with the object.
 	 * @param ray The ray to test for intersection.
-	 * @param result If true is returned, this will contain the intersection data.
+	 * @param hit If true is returned, this will contain where the ray hit.
 	 * @return True if there was an intersection, false if there was not.
 	 */
-	virtual bool Intersect(const Ray &ray, Intersection &result) = 0;
+	virtual bool Intersect(const Ray &ray, HitRecord &hit) = 0;
+
+
+	/**
+	 * Calculates the unit length normal of the surface at a hit found by Intersect().
+	 * Only called for the hit that is going to be shaded, so that every other hit doesn't pay for it.
+	 * @param ray The ray that was passed to Intersect().
+	 * @param hit The hit that Intersect() filled in.
+	 */
+	virtual sivelab::Vector3D GetNormal(const Ray &ray, const HitRecord &hit) = 0;
 
 
 	/**
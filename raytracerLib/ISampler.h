@@ -0,0 +1,97 @@
+#pragma once
+
+#include <utility>
+
+
+/**
+ * Represents a single sample.
+ */
+typedef std::pair<double, double> Sample;
+
+
+/**
+ * What a 2D dimension of a sample is used for.
+ */
+enum SampleUse
+{
+	/**
+	 * The position of the viewing ray inside of the pixel.
+	 */
+	SAMPLE_CAMERA,
+
+	/**
+	 * The position on an area light that a shadow ray is cast towards.
+	 */
+	SAMPLE_AREA_LIGHT,
+
+	/**
+	 * The perturbation of a glossy reflection ray.
+	 */
+	SAMPLE_GLOSS,
+
+	/**
+	 * The choice of which lights a shading point casts shadow rays towards, when lights are sampled.
+	 */
+	SAMPLE_LIGHT_SELECT,
+
+	/**
+	 * The decision of whether a path keeps bouncing, when Russian roulette is on.
+	 */
+	SAMPLE_ROULETTE
+};
+
+
+/**
+ * The number of bounces that can get their own area light and gloss dimensions.
+ * Light selection and roulette dimensions come after all of them, so that the other dimensions stay the same whether or not lights are sampled.
+ */
+const int MAX_SAMPLED_BOUNCES = 16;
+
+
+/**
+ * Gets the 2D dimension that should be used for the given purpose.
+ * The camera gets the first dimension, and every bounce of a path after that gets its own area light and gloss dimensions,
+ * so that no two decisions along a path are made with the same numbers.  Light selection and roulette get a dimension per bounce too.
+ * @param use What the sample will be used for.
+ * @param bounce The number of reflections the path has made so far.  Ignored for SAMPLE_CAMERA.
+ */
+inline int GetSampleDimension(SampleUse use, int bounce)
+{
+	if (use == SAMPLE_CAMERA)
+	{
+		return (0);
+	}
+
+	if (use == SAMPLE_LIGHT_SELECT)
+	{
+		return (1 + 2 * MAX_SAMPLED_BOUNCES + bounce);
+	}
+
+	if (use == SAMPLE_ROULETTE)
+	{
+		return (1 + 3 * MAX_SAMPLED_BOUNCES + bounce);
+	}
+
+	return (1 + 2 * bounce + (use - SAMPLE_AREA_LIGHT));
+}
+
+
+/**
+ * Generates samples on the unit square.
+ */
+class ISampler
+{
+public:
+	virtual ~ISampler() { }
+
+	/**
+	 * Gets a sample on the unit square.
+	 * Samples only depend on the arguments, so they can be asked for in any order, from any number of threads.
+	 * @param pixelX The x-coordinate of the pixel the sample is for.
+	 * @param pixelY The y-coordinate of the pixel the sample is for.
+	 * @param index The index of the sample within the pixel.  Must be less than sampleCount.
+	 * @param sampleCount The number of samples that will be taken in the pixel.  Can be any positive number.
+	 * @param dimension Which 2D dimension of the sample to get.  See GetSampleDimension().
+	 */
+	virtual Sample GetSample(int pixelX, int pixelY, int index, int sampleCount, int dimension) const = 0;
+};
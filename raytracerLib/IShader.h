@@ -3,6 +3,7 @@
 #include "Color.h"
 
 struct Intersection;
+struct ShadingTerms;
 
 class IShader
 {
@@ -15,5 +16,21 @@ public:
 	 * @param intersection The intersection data to shade with.
 	 */
 	virtual Color Shade(Intersection &intersection) = 0;
-};
 
+
+	/**
+	 * Breaks the shading of an intersection down into terms, without casting any shadow or reflection rays.
+	 * Renderers that trace rays in batches use this instead of Shade().
+	 * @param intersection The intersection data to shade with.
+	 * @param terms Will be filled in with the terms.  Assumed to be cleared.
+	 * @return False if this shader can not be broken down, in which case Shade() has to be called instead.
+	 */
+	virtual bool Decompose(Intersection &intersection, ShadingTerms &terms) { return (false); }
+
+
+	/**
+	 * Returns true if the color this shader gives a point does not depend on the direction it is seen from,
+	 * so that samples which hit close to each other can share one shaded color.  See Scene::DecoupledShading.
+	 */
+	virtual bool IsViewIndependent() const { return (false); }
+};
@@ -1,7 +1,13 @@
 #include <math.h>
-#include <stack>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <limits>
+#include <stdint.h>
 #include "Image.h"
 #include "EngineException.h"
+#include "ThreadPool.h"
+#include "PngStreamWriter.h"
 
 using namespace std;
 
@@ -17,55 +23,46 @@ void Image::AllocateBuffer(int width, int height)
 	m_width = width;
 	m_height = height;
 
-	// Allocate the array that will hold the horizontal lines.
-	m_image = new Color*[m_height];
-
-	// Allocate each horizontal line.
-	for (int i = 0; i < m_height; i++)
+	// One block for every row, aligned so that the start of the image never straddles a cache line.
+	size_t size = max((size_t)1, CHANNELS * sizeof(float) * (size_t)width * height);
+	void *buffer = NULL;
+	if (posix_memalign(&buffer, ALIGNMENT, size) != 0)
 	{
-		m_image[i] = new Color[width];
+		throw EngineException("Unable to allocate image buffer!");
 	}
+
+	m_pixels = (float*)buffer;
+	memset(m_pixels, 0, size);
 }
 
 
 Image::Image(const Image& other)
 {
-	// Allocate our image.
+	// Allocate our image, and copy the entire other image into it.
 	AllocateBuffer(other.m_width, other.m_height);
-
-	// Copy entire other image into this image.
-	for (int imageY = 0; imageY < m_height; imageY++)
-	{
-		for (int imageX = 0; imageX < m_width; imageX++)
-		{
-			m_image[imageY][imageX] = other.m_image[imageY][imageX];
-		}
-	}
+	memcpy(m_pixels, other.m_pixels, CHANNELS * sizeof(float) * (size_t)m_width * m_height);
 }
 
 
-Image::~Image()
+Image& Image::operator=(const Image& other)
 {
-	// Free memory in the opposite order it was aquired.
-	for (int i = 0; i < m_height; i++)
+	if (this != &other)
 	{
-		delete[] m_image[i];
+		// Copy into a temporary first, so that if the allocation throws we are left untouched, then take its buffer and let it free ours.
+		Image copy(other);
+		swap(m_width, copy.m_width);
+		swap(m_height, copy.m_height);
+		swap(m_pixels, copy.m_pixels);
 	}
-	delete[] m_image;
-}
 
-
-Color& Image::operator()(int x, int y)
-{
-	ThrowIfOutOfBounds(x, y);
-	return (m_image[y][x]);
+	return (*this);
 }
 
 
-const Color& Image::operator()(int x, int y) const
+Image::~Image()
 {
-	ThrowIfOutOfBounds(x, y);
-	return (m_image[y][x]);
+	free(m_pixels);
+	m_pixels = NULL;
 }
 
 
@@ -106,121 +103,194 @@ double Exponent(double x)
 
 
 /**
- * Calculates the Gaussian weight of the given pixel offset from the center tap.
+ * Everything a thread needs to blur a chunk of rows in one direction.
  */
-double CalculateWeight(int x, double stdDev)
+struct BlurJobInfo
 {
-	// Equal to sqrt(2*pi)
-	const double sqrt2Pi = 2.506628274631;
-
-	// For a mean of 0, this is the normal function.
-	double dividend = Exponent(-(x*x)/(2.0*stdDev*stdDev));
-	double divisor = stdDev * sqrt2Pi;
+	const Image *source;
+	Image *destination;
 
-	return (dividend / divisor);
-}
+	/**
+	 * The weights of the taps from -radius to radius.  Sums to 1.
+	 */
+	const vector<float> *kernel;
+	int radius;
+	int startY, endY;
+};
 
 
 /**
- * Combines the given adjacentColors with the weighting
- * computed from the offset away from the center tap, and the std deviation.
- * Both stacks will be empty upon success.
+ * Blurs a chunk of rows horizontally.
+ * @param info Pointer to the BlurJobInfo structure for the chunk.
  */
-Color CombineAdjacentColors(stack<Color> &adjacentColors, stack<int> &offsets, double stdDev)
+void *BlurRowsHorizontally(void *info)
 {
-	if (adjacentColors.size() != offsets.size())
+	BlurJobInfo *job = (BlurJobInfo*)info;
+	const int channels = Image::CHANNELS;
+	int width = job->source->GetWidth();
+	int radius = job->radius;
+	const float *weights = &(*job->kernel)[radius];
+	int rowLength = channels * width;
+
+	// Each row is copied with its edge pixels repeated radius times on both sides, so the taps never need clamping.
+	vector<float> padded(channels * (width + 2 * radius));
+	for (int y = job->startY; y < job->endY; y++)
 	{
-		throw EngineException("adjacentColors and offset stacks are different sizes in CombineAdjacentColors()!");
-	}
-
-	// Build up weighted result until the stacks are empty.
-	Color result;
-	while (!adjacentColors.empty())
-	{
-		// Pull current color and current offset away from the center tap from the stacks.
-		Color currentColor = adjacentColors.top();
-		adjacentColors.pop();
-		int currentOffset = offsets.top();
-		offsets.pop();
-
-		// Compute weight to be given to current color.
-		double weight = CalculateWeight(currentOffset, stdDev);
+		const float *source = job->source->GetRow(y);
+		for (int x = -radius; x < width + radius; x++)
+		{
+			int clampedX = min(max(x, 0), width - 1);
+			for (int c = 0; c < channels; c++)
+			{
+				padded[channels * (x + radius) + c] = source[channels * clampedX + c];
+			}
+		}
 
-		// Apply weight, and combine result with running total.
-		currentColor.LinearMult(weight);
-		result.AddColors(currentColor);
+		// Add up one tap at a time across the whole row, so the inner loop runs over contiguous channels.
+		float *destination = job->destination->GetRow(y);
+		const float *center = &padded[channels * radius];
+		for (int i = 0; i < rowLength; i++)
+		{
+			destination[i] = weights[0] * center[i];
+		}
+		for (int tap = 1; tap <= radius; tap++)
+		{
+			float weight = weights[tap];
+			const float *left = center - channels * tap;
+			const float *right = center + channels * tap;
+			for (int i = 0; i < rowLength; i++)
+			{
+				destination[i] += weight * (left[i] + right[i]);
+			}
+		}
 	}
 
-	return (result);
+	return (NULL);
 }
 
 
-void Image::GaussianBlur(double stdDev, int radius)
+/**
+ * Blurs a chunk of rows vertically.
+ * @param info Pointer to the BlurJobInfo structure for the chunk.
+ */
+void *BlurRowsVertically(void *info)
 {
-	// Make a copy of the original image to read from while blurring.
-	Image &original = *this;
+	BlurJobInfo *job = (BlurJobInfo*)info;
+	int height = job->source->GetHeight();
+	int rowLength = Image::CHANNELS * job->source->GetWidth();
+	int radius = job->radius;
+	const float *weights = &(*job->kernel)[radius];
 
-	// Blur horizontally.
-	for (int y = 0; y < m_height; y++)
+	for (int y = job->startY; y < job->endY; y++)
 	{
-		for (int x = 0; x < m_width; x++)
+		// Each output row is a weighted sum of whole input rows, with the rows past the edges clamped.
+		float *destination = job->destination->GetRow(y);
+		const float *center = job->source->GetRow(y);
+		for (int i = 0; i < rowLength; i++)
 		{
-			// Apply Gaussian filter around current pixel.
-			// These are the colors and corresponding local offsets around the current pixel.
-			stack<Color> adjacentColors;
-			stack<int> offsets;
-
-			for (int localX = -radius; localX < radius; localX++)
+			destination[i] = weights[0] * center[i];
+		}
+		for (int tap = 1; tap <= radius; tap++)
+		{
+			float weight = weights[tap];
+			const float *above = job->source->GetRow(max(y - tap, 0));
+			const float *below = job->source->GetRow(min(y + tap, height - 1));
+			for (int i = 0; i < rowLength; i++)
 			{
-				int absoluteX = x + localX;
-				
-				// Clamp absoluteX into the image dimensions [0, width-1].
-				absoluteX = max(absoluteX, 0);
-				absoluteX = min(absoluteX, m_width-1);
-				
-				// By the time we get here, we are within the bounds of the image.
-				Color current = original(absoluteX, y);
-				
-				// Add the current local offset and the current color to the stacks.
-				adjacentColors.push(current);
-				offsets.push(localX);
+				destination[i] += weight * (above[i] + below[i]);
 			}
-
-			// Compute and set the resultant color for the current pixel.
-			this->operator()(x, y) = CombineAdjacentColors(adjacentColors, offsets, stdDev);
 		}
 	}
 
-	// Blur vertically.
-	for (int y = 0; y < m_height; y++)
+	return (NULL);
+}
+
+
+/**
+ * Splits the given number of rows into chunks, a few for each thread, and sets the rows of each chunk's job info.
+ */
+template<typename JobInfo>
+static void SplitRows(vector<JobInfo> &chunks, int height, int threadCount)
+{
+	int chunkCount = min(height, max(1, threadCount) * 4);
+	chunks.resize(chunkCount);
+	for (int i = 0; i < chunkCount; i++)
 	{
-		for (int x = 0; x < m_width; x++)
-		{
-			// Apply Gaussian filter around current pixel.
-			// These are the colors and corresponding local offsets around the current pixel.
-			stack<Color> adjacentColors;
-			stack<int> offsets;
+		chunks[i].startY = (int)((int64_t)height * i / chunkCount);
+		chunks[i].endY = (int)((int64_t)height * (i + 1) / chunkCount);
+	}
+}
 
-			for (int localY = -radius; localY < radius; localY++)
-			{
-				int absoluteY = y + localY;
-				
-				// Clamp absoluteY into the image dimensions [0, height-1].
-				absoluteY = max(absoluteY, 0);
-				absoluteY = min(absoluteY, m_height-1);
-				
-				// By the time we get here, we are within the bounds of the image.
-				Color current = original(x, absoluteY);
-				
-				// Add the current local offset and the current color to the stacks.
-				adjacentColors.push(current);
-				offsets.push(localY);
-			}
 
-			// Compute and set the resultant color for the current pixel.
-			this->operator()(x, y) = CombineAdjacentColors(adjacentColors, offsets, stdDev);
+/**
+ * Runs a job on every chunk, across the given number of threads.
+ */
+template<typename JobInfo>
+static void RunRowJobs(void *(*job)(void*), vector<JobInfo> &chunks, int threadCount)
+{
+	if (threadCount <= 1)
+	{
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			job(&chunks[i]);
 		}
+		return;
+	}
+
+	ThreadEngine::ThreadPool rowPool(threadCount);
+	rowPool.StartProcessing();
+
+	rowPool.AddJobs(job, chunks);
+
+	// Wait for all jobs to be completed.
+	rowPool.JoinAll();
+}
+
+
+/**
+ * Runs a blur job over every row of the destination, split into chunks across the given number of threads.
+ */
+static void RunBlurJobs(void *(*job)(void*), const Image &source, Image &destination, const vector<float> &kernel, int radius, int threadCount)
+{
+	vector<BlurJobInfo> chunks;
+	SplitRows(chunks, destination.GetHeight(), threadCount);
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		chunks[i].source = &source;
+		chunks[i].destination = &destination;
+		chunks[i].kernel = &kernel;
+		chunks[i].radius = radius;
+	}
+
+	RunRowJobs(job, chunks, threadCount);
+}
+
+
+void Image::GaussianBlur(double stdDev, int radius, int threadCount)
+{
+	if ((radius <= 0) || (m_width == 0) || (m_height == 0))
+	{
+		return;
+	}
+
+	// Work the weights out once, and normalize them so that blurring does not brighten or darken the image.
+	vector<float> kernel(2 * radius + 1);
+	double total = 0.0;
+	for (int offset = -radius; offset <= radius; offset++)
+	{
+		double weight = exp(-(offset * offset) / (2.0 * stdDev * stdDev));
+		kernel[offset + radius] = (float)weight;
+		total += weight;
+	}
+	for (size_t i = 0; i < kernel.size(); i++)
+	{
+		kernel[i] = (float)(kernel[i] / total);
 	}
+
+	// The Gaussian is separable, so blur every row into the scratch image, then every column of that back into this one.
+	Image scratch(m_width, m_height);
+	RunBlurJobs(BlurRowsHorizontally, *this, scratch, kernel, radius, threadCount);
+	RunBlurJobs(BlurRowsVertically, scratch, *this, kernel, radius, threadCount);
 }
 
 
@@ -228,23 +298,30 @@ void Image::ConvertToGreyscale()
 {
 	for (int y = 0; y < m_height; y++)
 	{
+		float *row = GetRow(y);
 		for (int x = 0; x < m_width; x++)
 		{
-			// Grab current pixel.
-			Color &current = operator()(x, y);
-
 			// Calculate luminance of current pixel.
-			double luminance = current.GetLuminance();
+			float *current = &row[CHANNELS * x];
+			double luminance = Color(current[0], current[1], current[2]).GetLuminance();
 
 			// Set each channel to the luminance.
-			current.SetRed(luminance);
-			current.SetGreen(luminance);
-			current.SetBlue(luminance);
+			current[0] = current[1] = current[2] = (float)luminance;
 		}
 	}
 }
 
 
+void Image::Scale(double factor)
+{
+	size_t channelCount = CHANNELS * (size_t)m_width * m_height;
+	for (size_t i = 0; i < channelCount; i++)
+	{
+		m_pixels[i] = (float)(m_pixels[i] * factor);
+	}
+}
+
+
 void Image::Add(const Image& other)
 {
 	if ((m_width != other.m_width) || (m_height != other.m_height))
@@ -252,124 +329,429 @@ void Image::Add(const Image& other)
 		throw EngineException("Images are not the same size in Image::Add()");
 	}
 
-	for (int y = 0; y < m_height; y++)
+	// Add each channel in this image with the corresponding channel in the other image.
+	size_t channelCount = CHANNELS * (size_t)m_width * m_height;
+	for (size_t i = 0; i < channelCount; i++)
 	{
-		for (int x = 0; x < m_width; x++)
+		m_pixels[i] += other.m_pixels[i];
+	}
+}
+
+
+/**
+ * Clamps a color channel to [0, 1].
+ */
+static inline double ClampChannel(double value)
+{
+	return (value < 0.0 ? 0.0 : (value > 1.0 ? 1.0 : value));
+}
+
+
+double Image::ComputePsnr(const Image& reference) const
+{
+	if ((m_width != reference.m_width) || (m_height != reference.m_height))
+	{
+		throw EngineException("Images are not the same size in Image::ComputePsnr()");
+	}
+
+	double squaredError = 0.0;
+	size_t channelCount = CHANNELS * (size_t)m_width * m_height;
+	for (size_t i = 0; i < channelCount; i++)
+	{
+		double difference = ClampChannel(m_pixels[i]) - ClampChannel(reference.m_pixels[i]);
+		squaredError += difference * difference;
+	}
+
+	double meanSquaredError = squaredError / (3.0 * m_width * m_height);
+	if (meanSquaredError == 0.0)
+	{
+		return (INFINITY);
+	}
+
+	// The peak value is 1.0.
+	return (-10.0 * log10(meanSquaredError));
+}
+
+
+/**
+ * Everything a thread needs to tone map a chunk of rows, or to find the brightest channel in them.
+ */
+struct ToneMapJobInfo
+{
+	Image *image;
+	int startY, endY;
+
+	/**
+	 * What the mapped channels are multiplied by, to stretch the brightest one to 1.0.
+	 */
+	double factor;
+
+	/**
+	 * The bloom to add in, for AddBloomToRows(), along with its size relative to the image,
+	 * and what its mapped channels are multiplied by.
+	 */
+	const Image *bloom;
+	double bloomScale;
+	double bloomFactor;
+
+	/**
+	 * Filled in with the brightest channel in the chunk, before or after mapping, depending on the job.
+	 */
+	double maxChannel;
+};
+
+
+/**
+ * Finds the brightest channel in a chunk of rows.
+ * @param info Pointer to the ToneMapJobInfo structure for the chunk.
+ */
+void *FindMaxChannelInRows(void *info)
+{
+	ToneMapJobInfo *job = (ToneMapJobInfo*)info;
+	int rowLength = Image::CHANNELS * job->image->GetWidth();
+
+	float maxChannel = 0.0f;
+	for (int y = job->startY; y < job->endY; y++)
+	{
+		const float *row = job->image->GetRow(y);
+		for (int i = 0; i < rowLength; i++)
+		{
+			maxChannel = max(maxChannel, row[i]);
+		}
+	}
+
+	job->maxChannel = maxChannel;
+	return (NULL);
+}
+
+
+/**
+ * Maps each channel in a chunk of rows with c / (c + 1), and stretches it by the job's factor.
+ * @param info Pointer to the ToneMapJobInfo structure for the chunk.
+ */
+void *MapAndStretchRows(void *info)
+{
+	ToneMapJobInfo *job = (ToneMapJobInfo*)info;
+	int rowLength = Image::CHANNELS * job->image->GetWidth();
+
+	for (int y = job->startY; y < job->endY; y++)
+	{
+		float *row = job->image->GetRow(y);
+		for (int i = 0; i < rowLength; i++)
 		{
-			// Add each pixel in this image with the corresponding pixel in the other image.
-			m_image[y][x].AddColors(other.m_image[y][x]);
+			double channel = row[i];
+			float mapped = (float)(channel / (channel + 1.0));
+			row[i] = (float)(mapped * job->factor);
 		}
 	}
+
+	return (NULL);
+}
+
+
+/**
+ * Reduces the brightest channel of every chunk to the brightest channel of all of them.
+ */
+static double GetMaxChannel(const vector<ToneMapJobInfo> &chunks)
+{
+	double maxChannel = 0.0;
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		maxChannel = max(maxChannel, chunks[i].maxChannel);
+	}
+
+	return (maxChannel);
 }
 
 
-void Image::DoGlobalHDR()
+void Image::DoGlobalHDR(int threadCount)
 {
-	Image &self = *this;
+	if ((m_width == 0) || (m_height == 0))
+	{
+		return;
+	}
+
+	vector<ToneMapJobInfo> chunks;
+	SplitRows(chunks, m_height, threadCount);
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		chunks[i].image = this;
+	}
+
+	// Maps [0, inf) to [0, 1) with c / (c + 1), then stretches each channel to make the brightest one 1.0.
+	// The mapping never changes which channel is the brightest, so the stretch can be found from the unmapped image,
+	// and both steps done in a single pass.
+	RunRowJobs(FindMaxChannelInRows, chunks, threadCount);
+	double maxChannel = GetMaxChannel(chunks);
+	float maxMapped = (float)(maxChannel / (maxChannel + 1.0));
+
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		chunks[i].factor = 1.0 / maxMapped;
+	}
+	RunRowJobs(MapAndStretchRows, chunks, threadCount);
+}
 
-	// Used to scale the bright colors up to 1.0.
-	double maxColor = 0.0;
 
-	for (int imageY = 0; imageY < m_height; imageY++)
+/**
+ * The bloom used to be four blurs of the brightpassed image at full resolution, with radii of up to 50 pixels.
+ * Now each of those is done at its own mip level, small enough to only need a few pixels of radius.
+ * Entry i is the standard deviation, in full resolution pixels, of the blur at level i + 1.
+ * Level 1 is half the size of the image, level 2 a quarter, and so on.
+ */
+static const double BLOOM_STD_DEVS[] = { 4.0, 8.9, 10.8, 31.9 };
+static const int BLOOM_LEVEL_COUNT = sizeof(BLOOM_STD_DEVS) / sizeof(BLOOM_STD_DEVS[0]);
+
+
+void Image::Downsample(Image& destination, bool brightpass) const
+{
+	for (int y = 0; y < destination.m_height; y++)
 	{
-		for (int imageX = 0; imageX < m_width; imageX++)
+		float *destinationRow = destination.GetRow(y);
+		const float *sourceRows[2] = { GetRow(min(2 * y, m_height - 1)), GetRow(min(2 * y + 1, m_height - 1)) };
+		for (int x = 0; x < destination.m_width; x++)
 		{
-			Color &current = self(imageX, imageY);
-			double red = current.GetRed();
-			double green = current.GetGreen();
-			double blue = current.GetBlue();
-
-			// Do some global HDR.  Maps [0, inf) to [0, 1].
-			current.SetRed(red / (red + 1.0));
-			current.SetGreen(green / (green + 1.0));
-			current.SetBlue(blue / (blue + 1.0));
-			maxColor = max(maxColor, max(current.GetRed(), max(current.GetGreen(), current.GetBlue())));
+			int sourceX[2] = { min(2 * x, m_width - 1), min(2 * x + 1, m_width - 1) };
+
+			// Average the 2x2 block of pixels, brightpassing each one first if asked.
+			float sum[CHANNELS] = { 0.0f, 0.0f, 0.0f };
+			for (int row = 0; row < 2; row++)
+			{
+				for (int column = 0; column < 2; column++)
+				{
+					const float *pixel = &sourceRows[row][CHANNELS * sourceX[column]];
+					float scale = 1.0f;
+					if (brightpass)
+					{
+						// Pixels that are not bright are scaled down, based on their luminance.
+						double lum = Color(pixel[0], pixel[1], pixel[2]).GetLuminance();
+						scale = (lum < 1.0) ? (float)max(lum - 0.5, 0.0) : 1.0f;
+					}
+
+					for (int c = 0; c < CHANNELS; c++)
+					{
+						sum[c] += scale * pixel[c];
+					}
+				}
+			}
+
+			for (int c = 0; c < CHANNELS; c++)
+			{
+				destinationRow[CHANNELS * x + c] = 0.25f * sum[c];
+			}
 		}
 	}
+}
 
-	// Stretch each component in the image to make the maximium color from the last step 1.0.
-	double factor = 1.0 / maxColor;
-	for (int y = 0; y < m_height; y++)
+
+/**
+ * Adds the bilinearly filtered color of the given mip level at a pixel of a larger image to the sum.
+ * @param scale The size of the mip level divided by the size of the larger image.
+ */
+static inline void AddBilinearSample(const Image &level, int x, int y, double scale, float *sum)
+{
+	// Pixel centers line up at the same place in both images.
+	double levelX = min(max((x + 0.5) * scale - 0.5, 0.0), level.GetWidth() - 1.0);
+	double levelY = min(max((y + 0.5) * scale - 0.5, 0.0), level.GetHeight() - 1.0);
+
+	int x0 = (int)levelX;
+	int y0 = (int)levelY;
+	int x1 = min(x0 + 1, level.GetWidth() - 1);
+	int y1 = min(y0 + 1, level.GetHeight() - 1);
+	float fractionX = (float)(levelX - x0);
+	float fractionY = (float)(levelY - y0);
+
+	const float *top = level.GetRow(y0);
+	const float *bottom = level.GetRow(y1);
+	for (int c = 0; c < Image::CHANNELS; c++)
 	{
-		for (int x = 0; x < m_width; x++)
+		float upper = top[Image::CHANNELS * x0 + c] + fractionX * (top[Image::CHANNELS * x1 + c] - top[Image::CHANNELS * x0 + c]);
+		float lower = bottom[Image::CHANNELS * x0 + c] + fractionX * (bottom[Image::CHANNELS * x1 + c] - bottom[Image::CHANNELS * x0 + c]);
+		sum[c] += upper + fractionY * (lower - upper);
+	}
+}
+
+
+/**
+ * Adds the bloom into a chunk of rows, and maps each channel with c / (c + 1).
+ * @param info Pointer to the ToneMapJobInfo structure for the chunk.  Its maxChannel is set to the brightest mapped channel.
+ */
+void *AddBloomToRows(void *info)
+{
+	ToneMapJobInfo *job = (ToneMapJobInfo*)info;
+	const int channels = Image::CHANNELS;
+	int width = job->image->GetWidth();
+
+	double maxChannel = 0.0;
+	for (int y = job->startY; y < job->endY; y++)
+	{
+		float *row = job->image->GetRow(y);
+		for (int x = 0; x < width; x++)
 		{
-			// Hitting each component in the pixel with the factor will make
-			// the colors stretch across the entire range [0,1].
-			self(x, y).LinearMult(factor);
+			float sample[channels] = { 0.0f, 0.0f, 0.0f };
+			AddBilinearSample(*job->bloom, x, y, job->bloomScale, sample);
+			for (int c = 0; c < channels; c++)
+			{
+				double channel = row[channels * x + c] + job->bloomFactor * (sample[c] / (sample[c] + 1.0));
+				row[channels * x + c] = (float)(channel / (channel + 1.0));
+				maxChannel = max(maxChannel, (double)row[channels * x + c]);
+			}
 		}
 	}
+
+	job->maxChannel = maxChannel;
+	return (NULL);
 }
 
 
-void Image::Postprocess()
+/**
+ * Multiplies every channel in a chunk of rows by the job's factor.
+ * @param info Pointer to the ToneMapJobInfo structure for the chunk.
+ */
+void *StretchRows(void *info)
 {
-	// Create the brightpassed copy.
-	Image brightpassed(*this);
+	ToneMapJobInfo *job = (ToneMapJobInfo*)info;
+	int rowLength = Image::CHANNELS * job->image->GetWidth();
 
-	// Apply bright-pass filter.
-	for (int y = 0; y < m_height; y++)
+	for (int y = job->startY; y < job->endY; y++)
 	{
-		for (int x = 0; x < m_width; x++)
+		float *row = job->image->GetRow(y);
+		for (int i = 0; i < rowLength; i++)
 		{
-			Color &current = brightpassed.m_image[y][x];
+			row[i] = (float)(row[i] * job->factor);
+		}
+	}
 
-			// Scale pixels based on the luminance.
-			double lum = current.GetLuminance();
-			if (lum < 1.0)
+	return (NULL);
+}
+
+
+double Image::Postprocess(int threadCount, bool stretch)
+{
+	if ((m_width == 0) || (m_height == 0))
+	{
+		return (1.0);
+	}
+
+	// Build the mip chain.  The first level is brightpassed as it is made, so the full image is never copied.
+	vector<Image*> levels(BLOOM_LEVEL_COUNT);
+	vector<double> scales(BLOOM_LEVEL_COUNT);
+	const Image *previous = this;
+	for (int i = 0; i < BLOOM_LEVEL_COUNT; i++)
+	{
+		levels[i] = new Image((previous->m_width + 1) / 2, (previous->m_height + 1) / 2);
+		previous->Downsample(*levels[i], (i == 0));
+		scales[i] = (double)levels[i]->m_width / m_width;
+		previous = levels[i];
+	}
+
+	// Now that nothing else is downsampled from them, blur each level with a kernel narrowed to match its size.
+	// Each halving already blurs a little, by a variance of a quarter of the squared spacing of the pixels it averages,
+	// so that much is taken off of the blur.
+	double downsampleVariance = 0.0;
+	for (int i = 0; i < BLOOM_LEVEL_COUNT; i++)
+	{
+		downsampleVariance += 0.25 * (1 << i) * (1 << i);
+		double variance = max(BLOOM_STD_DEVS[i] * BLOOM_STD_DEVS[i] - downsampleVariance, 0.0);
+		double stdDev = sqrt(variance) * scales[i];
+		levels[i]->GaussianBlur(stdDev, (int)ceil(3.0 * stdDev), threadCount);
+	}
+
+	// Add each level into the next larger one, from the smallest up, so the bloom ends up summed in the first level.
+	for (int i = BLOOM_LEVEL_COUNT - 1; i > 0; i--)
+	{
+		Image &larger = *levels[i - 1];
+		double scale = scales[i] / scales[i - 1];
+		for (int y = 0; y < larger.m_height; y++)
+		{
+			float *row = larger.GetRow(y);
+			for (int x = 0; x < larger.m_width; x++)
 			{
-				// Scale colors down.
-				current.LinearMult(max(lum - 0.5, 0.0));
+				AddBilinearSample(*levels[i], x, y, scale, &row[CHANNELS * x]);
 			}
 		}
 	}
 
-	// Blur the brightpassed image.
-	brightpassed.GaussianBlur(4, 10);
-
-	// Create a more blurry brightpassed image, and combine with the original.
-	Image moreBlurry(brightpassed);
-	brightpassed.GaussianBlur(8, 15);
-	brightpassed.Add(moreBlurry);
+	// The bloom gets mapped with b / (b + 1), and stretched so that its brightest channel is 1.0, like DoGlobalHDR().
+	// The mapping never changes which channel is the brightest, and filtering never goes above the brightest pixel,
+	// so the stretch comes straight from the brightest channel of the first level.
+	vector<ToneMapJobInfo> bloomChunks;
+	SplitRows(bloomChunks, levels[0]->m_height, threadCount);
+	for (size_t i = 0; i < bloomChunks.size(); i++)
+	{
+		bloomChunks[i].image = levels[0];
+	}
+	RunRowJobs(FindMaxChannelInRows, bloomChunks, threadCount);
+	double maxBloom = GetMaxChannel(bloomChunks);
 
-	// Make more blur.
-	moreBlurry.GaussianBlur(10, 20);
-	brightpassed.Add(moreBlurry);
+	// Combine the bloom with the image, and do the first half of DoGlobalHDR() on the way.
+	vector<ToneMapJobInfo> chunks;
+	SplitRows(chunks, m_height, threadCount);
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		chunks[i].image = this;
+		chunks[i].bloom = levels[0];
+		chunks[i].bloomScale = scales[0];
+		chunks[i].bloomFactor = (maxBloom > 0.0) ? ((maxBloom + 1.0) / maxBloom) : 0.0;
+	}
+	RunRowJobs(AddBloomToRows, chunks, threadCount);
 
-	moreBlurry.GaussianBlur(30, 50);
-	brightpassed.Add(moreBlurry);
-	brightpassed.DoGlobalHDR();
+	// Scale everything back to [0, 1], unless the caller is going to do it while writing the image out.
+	double factor = 1.0 / GetMaxChannel(chunks);
+	if (stretch)
+	{
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			chunks[i].factor = factor;
+		}
+		RunRowJobs(StretchRows, chunks, threadCount);
+		factor = 1.0;
+	}
 
-	// Combine the brightpassed image with the original.
-	Add(brightpassed);
+	for (int i = 0; i < BLOOM_LEVEL_COUNT; i++)
+	{
+		delete levels[i];
+	}
 
-	// Scale everything back to [0, 1].
-	DoGlobalHDR();
+	return (factor);
 }
 
 
-void Image::WriteToDisk(std::string filename)
+void Image::QuantizeRow(int y, uint8_t *destination, double scale, double gamma) const
 {
-	// Copy entire image into a png image.
-	png::image<png::rgb_pixel> outputImage(m_width, m_height);
-	for (int imageY = 0; imageY < m_height; imageY++)
+	double maxValue = (double)numeric_limits<uint8_t>::max();
+	double inverseGamma = 1.0 / gamma;
+	const float *row = GetRow(y);
+	int rowLength = CHANNELS * m_width;
+
+	for (int i = 0; i < rowLength; i++)
 	{
-		for (int imageX = 0; imageX < m_width; imageX++)
+		double channel = ClampChannel((float)(row[i] * scale));
+		if (gamma != 1.0)
 		{
-			outputImage.set_pixel(imageX, imageY, m_image[imageY][imageX].GetImageColor());
+			channel = pow(channel, inverseGamma);
 		}
+
+		destination[i] = (uint8_t)(maxValue * channel);
 	}
+}
+
 
-	outputImage.write(filename);
+void Image::WriteToDisk(std::string filename, int threadCount, double scale, double gamma)
+{
+	PngStreamWriter writer(filename, m_width, m_height, threadCount, gamma);
+	writer.WriteRows(*this, scale);
+	writer.Finish();
 }
 
 
-int Image::GetWidth()
+int Image::GetWidth() const
 {
 	return (m_width);
 }
 
 
-int Image::GetHeight()
+int Image::GetHeight() const
 {
 	return (m_height);
 }
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <stdint.h>
+
 #include "Color.h"
 
 
 /**
  * Encapsulates a HDR image.
+ * The pixels are kept as float red, green and blue channels, in one block of memory, one row after another.
  * Threadsafe as long as no two threads try to access the same pixel at the same time.
  */
 class Image
@@ -12,71 +15,158 @@ class Image
 public:
 	Image(int width, int height);
 	Image(const Image &other);
+	Image &operator=(const Image &other);
 	virtual ~Image();
 
 	/**
-	 * Allows array-like access to each pixel.
+	 * The number of floats each pixel takes up.
+	 */
+	static const int CHANNELS = 3;
+
+	/**
+	 * The alignment, in bytes, of the pixel buffer.  Enough for a cache line, or any SIMD register.
+	 */
+	static const int ALIGNMENT = 64;
+
+	/**
+	 * Gets and sets single pixels.
+	 * The coordinates are only checked in debug builds, where an exception is thrown if they are out of bounds.
+	 */
+	inline Color GetPixel(int x, int y) const
+	{
+#ifndef NDEBUG
+		ThrowIfOutOfBounds(x, y);
+#endif
+		const float *pixel = m_pixels + CHANNELS * ((size_t)y * m_width + x);
+		return (Color((double)pixel[0], (double)pixel[1], (double)pixel[2]));
+	}
+
+	inline void SetPixel(int x, int y, const Color &color)
+	{
+#ifndef NDEBUG
+		ThrowIfOutOfBounds(x, y);
+#endif
+		float *pixel = m_pixels + CHANNELS * ((size_t)y * m_width + x);
+		pixel[0] = (float)color.GetRed();
+		pixel[1] = (float)color.GetGreen();
+		pixel[2] = (float)color.GetBlue();
+	}
+
+	/**
+	 * Gets the first channel of the given row, for loops that go through a lot of pixels.
+	 * Each row holds GetWidth() * CHANNELS floats, and the rows follow each other with no gaps,
+	 * so GetRow(0) is the whole image.  The row is never checked.
 	 */
-	Color &operator()(int x, int y);
-	const Color &operator()(int x, int y) const;
+	inline float *GetRow(int y)
+	{
+		return (m_pixels + CHANNELS * (size_t)y * m_width);
+	}
+
+	inline const float *GetRow(int y) const
+	{
+		return (m_pixels + CHANNELS * (size_t)y * m_width);
+	}
 
 	/**
 	 * Applies a global tone mapping technique that guarantees that none of the colors will be above 1.0.
+	 * The brightest channel is found with a reduction over chunks of rows, then the rows are mapped in a single pass.
+	 * @param threadCount The number of threads to split the rows across.
 	 */
-	void DoGlobalHDR();
+	void DoGlobalHDR(int threadCount = 1);
 
 	/**
 	 * Blurs the image.  A larger standard deviation will produce a blurrier image.
+	 * The blur is done as a horizontal pass followed by a vertical one, with pixels past the edges clamped to the edges.
 	 * @param stdDev The standard deviation to use when weighting the pixels.
 	 * @param radius The number of pixels to go out from the center of each blurred pixel.
+	 * @param threadCount The number of threads to split the rows across.
 	 */
-	void GaussianBlur(double stdDev, int radius);
+	void GaussianBlur(double stdDev, int radius, int threadCount = 1);
 
 	/**
 	 * Converts the image, in-place, to greyscale, using a luminance operator that takes into account human perception.
 	 */
 	void ConvertToGreyscale();
 
+	/**
+	 * Multiplies every channel by the given factor, to change the exposure.
+	 */
+	void Scale(double factor);
+
 	/**
 	 * Destructively adds the other image to this image.
 	 * @warning If images are not the same size, an exception will be thrown.
 	 */
 	void Add(const Image &other);
 
+	/**
+	 * Computes the peak signal to noise ratio of this image compared to a reference, in decibels.
+	 * Colors are clamped to [0, 1] first, the same way they are when written to disk.
+	 * @return The PSNR, or infinity if the images are identical.
+	 * @warning If images are not the same size, an exception will be thrown.
+	 */
+	double ComputePsnr(const Image &reference) const;
+
 	/**
 	 * Postprocesses, performing a global HDR technique, and producing bloom effect.
+	 * The bloom is blurred at a chain of smaller and smaller copies of the image, and added back in while tone mapping.
+	 * @param threadCount The number of threads to blur and tone map with.
+	 * @param stretch If false, the last step of the tone mapping, which stretches the brightest channel up to 1.0,
+	 *                is left to be done by WriteToDisk(), which saves a pass over the image.
+	 * @return The scale that still has to be passed to WriteToDisk(), or 1.0 if the image was stretched.
 	 */
-	void Postprocess();
+	double Postprocess(int threadCount = 1, bool stretch = true);
 
 	/**
-	 * Writes the image to disk as a png.
+	 * Writes the image to disk as a png, with a PngStreamWriter.
+	 * @param threadCount The number of threads to convert and compress the rows with.
+	 * @param scale What each channel is multiplied by before it is clipped.  See Postprocess().
+	 * @param gamma The gamma to encode with.  The default of 1.0 writes the channels linearly.
+	 * @throws EngineException If the gamma is not positive, or the file can't be written.
 	 */
-	void WriteToDisk(std::string filename);
+	void WriteToDisk(std::string filename, int threadCount = 1, double scale = 1.0, double gamma = 1.0);
+
+	/**
+	 * Converts a row to 8 bits a channel.  Each channel is scaled, clipped to [0, 1], gamma-encoded,
+	 * and quantized the same way as Color::GetImageColor().
+	 * @param y The row to convert.
+	 * @param destination Where the GetWidth() * CHANNELS bytes of the row are written.
+	 * @param scale What each channel is multiplied by before it is clipped.
+	 * @param gamma The gamma to encode with.  1.0 leaves the channels linear.
+	 */
+	void QuantizeRow(int y, uint8_t *destination, double scale, double gamma) const;
 
 	/**
 	 * Gets the width of the image.
 	 */
-	int GetWidth();
+	int GetWidth() const;
 
 	/**
 	 * Gets the height of the image.
 	 */
-	int GetHeight();
+	int GetHeight() const;
 private:
+	/**
+	 * Shrinks the image to half its size, into the given image, by averaging each 2x2 block of pixels.
+	 * @param destination Has to be half the size of this image, rounded up.
+	 * @param brightpass If true, the pixels are brightpassed for the bloom as they are read.
+	 */
+	void Downsample(Image &destination, bool brightpass) const;
+
 	/**
 	 * Throws an exception if the given coodinate pair is out of bounds.
 	 */
 	void ThrowIfOutOfBounds(int x, int y) const;
 
 	/**
-	 * Allocates the image buffer with the given width and height.
+	 * Allocates a black image buffer with the given width and height.
 	 * Also sets the width and height member variables.
 	 * @warning Does not free anything already in the buffer.
 	 */
 	void AllocateBuffer(int width, int height);
 
 	int m_width, m_height;
-	Color **m_image;
+	float *m_pixels;
 };
 
 
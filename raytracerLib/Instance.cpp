@@ -18,6 +18,9 @@ InstanceObject::InstanceObject(Matrix transf, IObject* original, IShader* shader
 	m_bbox = original->GetBoundingBox();
 	m_bbox = m_bbox.Transform(transf);
 
+	// Normals get transformed with the transpose of the inverse matrix.
+	m_normalTrans = m_invTrans.Transpose();
+
 	// Copy in references to original object and shader.
 	m_original = original;
 	m_shader = shader;
@@ -50,24 +53,16 @@ IShader* InstanceObject::GetShader()
 }
 
 
-bool InstanceObject::Intersect(const Ray& ray, Intersection& result)
+bool InstanceObject::Intersect(const Ray& ray, HitRecord& hit)
 {
 	// Transform the ray.
 	Ray transRay = m_invTrans * ray;
 
 	// See if the transformed ray intersects the original object.
-	if (m_original->Intersect(transRay, result))
+	if (m_original->Intersect(transRay, hit))
 	{
-		// We hit.
-		result.collidedRay = ray;
-		result.object = this;
-
-		// Transform the normal with the transpose of the inverse matrix, and normalize.
-		Vector4D transNorm(result.surfaceNormal, false);
-		transNorm = m_invTrans.Transpose() * transNorm;
-		result.surfaceNormal = transNorm.vector3d;
-		result.surfaceNormal.normalize();
-
+		// We hit.  The transformation doesn't change t, so the hit is the same in both spaces.
+		hit.object = this;
 		return (true);
 	}
 	else
@@ -76,3 +71,18 @@ bool InstanceObject::Intersect(const Ray& ray, Intersection& result)
 		return (false);
 	}
 }
+
+
+sivelab::Vector3D InstanceObject::GetNormal(const Ray& ray, const HitRecord& hit)
+{
+	// Find the normal of the original object, in its own space.
+	Ray transRay = m_invTrans * ray;
+	Vector4D transNorm(m_original->GetNormal(transRay, hit), false);
+
+	// Transform the normal back out, and normalize.
+	transNorm = m_normalTrans * transNorm;
+	sivelab::Vector3D normal = transNorm.vector3d;
+	normal.normalize();
+
+	return (normal);
+}
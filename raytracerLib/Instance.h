@@ -16,7 +16,8 @@ public:
 	InstanceObject(Matrix transf, IObject *original, IShader *shader);
 	virtual ~InstanceObject();
 
-	virtual bool Intersect(const Ray& ray, Intersection& result);
+	virtual bool Intersect(const Ray& ray, HitRecord& hit);
+	virtual sivelab::Vector3D GetNormal(const Ray& ray, const HitRecord& hit);
 	virtual IShader* GetShader();
 	virtual BBox GetBoundingBox();
 
@@ -26,6 +27,11 @@ private:
 	 */
 	Matrix m_invTrans;
 
+	/**
+	 * The matrix that transforms normals of the original object.  This is the transpose of m_invTrans.
+	 */
+	Matrix m_normalTrans;
+
 	/**
 	 * Pointer to the original object
 	 */
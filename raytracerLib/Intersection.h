@@ -4,7 +4,7 @@
 
 #include "Vector3D.h"
 #include "Ray.h"
-#include "JitteredSampler.h"
+#include "PixelSampler.h"
 
 class IObject;
 
@@ -20,7 +20,8 @@ struct Intersection
 		allowedReflectionCount = 7;
 		t = 0.0;
 		object = NULL;
-		
+		primitive = NULL;
+		samples = NULL;
 	}
 
 	/**
@@ -36,10 +37,11 @@ struct Intersection
 	double t;
 
 	/**
-	 * The list of area light samples.
-	 * Generate must be called if area lights are present in the scene.
+	 * The samples of the path this intersection is part of.  Used for area lights, glossy reflections and picking lights.
+	 * Owned by whoever started the path, so copying an intersection does not copy any sampling state.
+	 * Must point to a started PixelSampler if area lights, glossy reflections or light sampling are present in the scene.
 	 */
-	JitteredSampler areaLightSamples;
+	PixelSampler *samples;
 
 	/**
 	 * The normal of the surface where the ray hit.
@@ -51,6 +53,11 @@ struct Intersection
 	 */
 	IObject *object;
 
+	/**
+	 * The innermost primitive that was hit, such as a single triangle of a mesh.  The same as object for simple shapes.
+	 */
+	IObject *primitive;
+
 	/**
 	 * The number of reflections that are left for this particular intersection.
 	 * Scene::CastReflectionRay() will decrement this every time it is called.
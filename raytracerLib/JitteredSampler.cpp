@@ -1,80 +1,31 @@
-#include <stdlib.h>
-#include <stdio.h>
 #include <math.h>
 
 #include "JitteredSampler.h"
-#include "EngineException.h"
+#include "RandomGenerator.h"
 
 
-JitteredSampler::JitteredSampler()
+Sample JitteredSampler::GetSample(int pixelX, int pixelY, int index, int sampleCount, int dimension) const
 {
-	m_currentSample = 0;
-}
-
-
-void JitteredSampler::Generate(int sampleCount)
-{
-	// Reset current samples.
-	m_samples.clear();
-	m_currentSample = 0;
-
-	// Make sure that the number of samples is a perfect square.
-	int sqrtOfSampleCount = (int)sqrt(sampleCount);
-	if ((sqrtOfSampleCount * sqrtOfSampleCount) != sampleCount)
-	{
-		char buffer[128];
-		sprintf(buffer, "Unable to construct jittered samples: %i is not a perfect square!", sampleCount);
-		throw EngineException(buffer);
-	}
-
-	// Divide the area up into a grid of equally-sized squares.
-	// Calculate the number of grid squares for both the width and the height of the area.
-	int gridUnitsPerSide = sqrtOfSampleCount;
-
-	// Calculate the side length of a single grid square.
-	double sideLengthOfUnit = 1.0 / gridUnitsPerSide;
-
-	// Generate a ray for each grid unit.
-	for (int gridY = 0; gridY < gridUnitsPerSide; gridY++)
-	{
-		for (int gridX = 0; gridX < gridUnitsPerSide; gridX++)
-		{
-			// Generate a random position inside the current square, and map it into grid space.
-			double sampleX = (drand48() + gridX) * sideLengthOfUnit;
-			double sampleY = (drand48() + gridY) * sideLengthOfUnit;
-			m_samples.push_back(std::make_pair(sampleX, sampleY));
-		}
-	}
-}
-
-
-const Sample &JitteredSampler::GetCurrentSample() const
-{
-	ThrowIfNoSamples();
-
-	return (m_samples[m_currentSample % m_samples.size()]);
-}
+	uint32_t seed = (uint32_t)RandomGenerator::Hash(pixelX, pixelY, dimension);
 
+	// Divide the area up into a grid that is as close to square as possible.
+	// There are enough rows so that every sample has a grid square, even if the sample count is not a perfect square.
+	int columns = (int)sqrt((double)sampleCount);
+	int rows = (sampleCount + columns - 1) / columns;
 
-void JitteredSampler::Next()
-{
-	ThrowIfNoSamples();
+	// Shuffle the samples, so that the order of the grid squares is different in every pixel and dimension.
+	uint32_t shuffled = RandomGenerator::Permute(index, sampleCount, seed * 0x51633e2d);
 
-	m_currentSample++;
-}
+	// Pick the grid square, and a sub-square within it, so that every column and row is covered by exactly one sample.
+	uint32_t column = RandomGenerator::Permute(shuffled % columns, columns, seed * 0x68bc21eb);
+	uint32_t row = RandomGenerator::Permute(shuffled / columns, rows, seed * 0x02e5be93);
 
+	// Generate a random position inside the sub-square.
+	RandomGenerator random(RandomGenerator::Hash(seed, shuffled));
+	double jitterX = random.NextDouble();
+	double jitterY = random.NextDouble();
 
-const SampleList& JitteredSampler::GetSampleList() const
-{
-	return (m_samples);
+	double sampleX = (column + (row + jitterX) / rows) / columns;
+	double sampleY = (shuffled + jitterY) / sampleCount;
+	return (std::make_pair(sampleX, sampleY));
 }
-
-
-void JitteredSampler::ThrowIfNoSamples() const
-{
-	if (m_samples.empty())
-	{
-		throw EngineException("Tried to do something before calling JitteredSampler::Generate()!");
-	}
-}
-
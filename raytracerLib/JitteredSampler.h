@@ -1,62 +1,15 @@
 #pragma once
 
-#include <vector>
+#include "ISampler.h"
 
 
-/**
- * Represents a single sample.
- */
-typedef std::pair<double, double> Sample;
-
-/**
- * A list of samples.
- */
-typedef std::vector<Sample> SampleList;
-
 /**
  * Generates jittered samples on the unit square.
+ * Uses correlated multi-jittering, so any number of samples is stratified in both 2D and in each axis,
+ * not just perfect squares.
  */
-class JitteredSampler
+class JitteredSampler : public ISampler
 {
 public:
-	/**
-	 * Sets up the sampler.
-	 */
-	JitteredSampler();
-
-	/**
-	 * Actually generates the samples.
-	 * The current sample is set to the first one generated.
-	 * @param sampleCount The number of samples to generate.  Must be a perfect square, or an exception will be thrown.
-	 */
-	void Generate(int sampleCount);
-
-	/**
-	 * Gets a constant reference to the list of samples.
-	 * @remarks Must be called after Generate().
-	 */
-	const SampleList &GetSampleList() const;
-
-	/**
-	 * Gets the current sample.
-	 * @remarks Must be called after Generate().
-	 */
-	const Sample &GetCurrentSample() const;
-
-	/**
-	 * Steps the current sample to the next sample in the list.
-	 * Calling this more than the number of samples generated will result in wrapping around to the beginning of the list.
-	 * @remarks Must be called after Generate().
-	 */
-	void Next();
-
-private:
-	/**
-	 * Throws an exception if no samples have been generated yet.
-	 */
-	void ThrowIfNoSamples() const;
-
-	SampleList m_samples;
-
-	int m_currentSample;
+	virtual Sample GetSample(int pixelX, int pixelY, int index, int sampleCount, int dimension) const;
 };
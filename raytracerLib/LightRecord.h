@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+
+#include "Vector3D.h"
+#include "Color.h"
+#include "ISampler.h"
+
+
+/**
+ * The kinds of light a LightRecord can describe.
+ */
+enum LightType
+{
+	/**
+	 * All light comes from a single point.
+	 */
+	LIGHT_POINT,
+
+	/**
+	 * Light comes from a rectangle, which is sampled to produce soft shadows.
+	 */
+	LIGHT_AREA
+};
+
+
+/**
+ * A light, flattened into plain data when the scene is loaded.
+ * Shaders and shadow rays use these instead of ILight, so that the shadow path does not need any casts, virtual calls,
+ * or per-ray setup of the light's frame.
+ */
+struct LightRecord
+{
+	LightType type;
+
+	/**
+	 * The position of a point light, or the center of an area light.
+	 */
+	sivelab::Vector3D position;
+
+	/**
+	 * The radiance the light casts on every point, assuming no other objects are in the way.
+	 */
+	Color radiance;
+
+	/**
+	 * The unit axes along the width and height of an area light, and its width and height.  Unused for point lights.
+	 */
+	sivelab::Vector3D uAxis, vAxis;
+	double width, height;
+
+	/**
+	 * Gets the point on the light that a shadow ray with the given sample is cast towards.
+	 * Point lights always return their position.
+	 */
+	inline sivelab::Vector3D GetSamplePosition(const Sample &sample) const
+	{
+		if (type == LIGHT_AREA)
+		{
+			sivelab::Vector3D uu = (width * (sample.first - 0.5)) * uAxis;
+			sivelab::Vector3D vv = (height * (sample.second - 0.5)) * vAxis;
+			return (position + uu + vv);
+		}
+
+		return (position);
+	}
+};
+
+
+/**
+ * Every light in a scene, in the order they were loaded.
+ */
+typedef std::vector<LightRecord> LightTable;
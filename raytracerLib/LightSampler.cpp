@@ -0,0 +1,111 @@
+#include <algorithm>
+
+#include "LightSampler.h"
+
+using namespace std;
+
+
+LightSampler::LightSampler()
+{
+	m_lights = NULL;
+}
+
+
+void LightSampler::Build(const LightTable& lights)
+{
+	int lightCount = lights.size();
+	m_lights = &lights;
+	m_probabilities.assign(lightCount, 0.0);
+	m_thresholds.assign(lightCount, 1.0);
+	m_aliases.resize(lightCount);
+
+	if (lightCount == 0)
+	{
+		return;
+	}
+
+	// Weight each light by its power.
+	double totalPower = 0.0;
+	for (int i = 0; i < lightCount; i++)
+	{
+		Color radiance = lights[i].radiance;
+		m_probabilities[i] = max(0.0, radiance.GetLuminance());
+		totalPower += m_probabilities[i];
+	}
+
+	for (int i = 0; i < lightCount; i++)
+	{
+		m_probabilities[i] = (totalPower > 0.0) ? (m_probabilities[i] / totalPower) : (1.0 / lightCount);
+	}
+
+	// Split the lights into the ones that over and under fill a column, scaled so that a full column is 1.0.
+	vector<double> scaled(lightCount);
+	vector<int> small, large;
+	for (int i = 0; i < lightCount; i++)
+	{
+		m_aliases[i] = i;
+		scaled[i] = m_probabilities[i] * lightCount;
+		if (scaled[i] < 1.0)
+		{
+			small.push_back(i);
+		}
+		else
+		{
+			large.push_back(i);
+		}
+	}
+
+	// Top off each under filled column with part of an over filled one.
+	while (!small.empty() && !large.empty())
+	{
+		int under = small.back();
+		small.pop_back();
+		int over = large.back();
+
+		m_thresholds[under] = scaled[under];
+		m_aliases[under] = over;
+
+		scaled[over] -= 1.0 - scaled[under];
+		if (scaled[over] < 1.0)
+		{
+			large.pop_back();
+			small.push_back(over);
+		}
+	}
+
+	// Anything left over is full, give or take rounding error.
+	for (size_t i = 0; i < small.size(); i++)
+	{
+		m_thresholds[small[i]] = 1.0;
+	}
+	for (size_t i = 0; i < large.size(); i++)
+	{
+		m_thresholds[large[i]] = 1.0;
+	}
+}
+
+
+const LightRecord *LightSampler::Pick(double u, double& probability) const
+{
+	int lightCount = GetLightCount();
+	if (lightCount == 0)
+	{
+		probability = 0.0;
+		return (NULL);
+	}
+
+	// The whole part of u picks the column, and the fractional part picks between the column and its alias.
+	double scaled = u * lightCount;
+	int column = min((int)scaled, lightCount - 1);
+	double remainder = scaled - column;
+
+	int picked = (remainder < m_thresholds[column]) ? column : m_aliases[column];
+	probability = m_probabilities[picked];
+	return (&(*m_lights)[picked]);
+}
+
+
+int LightSampler::GetLightCount() const
+{
+	return ((m_lights != NULL) ? m_lights->size() : 0);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include "LightRecord.h"
+
+
+/**
+ * Picks lights at random, in proportion to how much light each one gives off.
+ * Uses Walker's alias method, so picking a light takes constant time no matter how many lights there are.
+ * This lets scenes with many lights cast a few shadow rays per shading point, instead of one to every light.
+ */
+class LightSampler
+{
+public:
+	LightSampler();
+
+	/**
+	 * Builds the table for the given lights.
+	 * Each light is weighted by the luminance of its radiance.  If every light is black, they are all equally likely.
+	 * The table is not copied, so it has to outlive the sampler.
+	 */
+	void Build(const LightTable &lights);
+
+	/**
+	 * Picks a light.
+	 * @param u A number in [0, 1) that decides which light is picked.
+	 * @param probability Will be set to the chance that the returned light is picked.
+	 * @return The light that was picked, or NULL if there are no lights.
+	 */
+	const LightRecord *Pick(double u, double &probability) const;
+
+	/**
+	 * Gets the number of lights in the table.
+	 */
+	int GetLightCount() const;
+
+private:
+	const LightTable *m_lights;
+
+	/**
+	 * The chance of picking each light.
+	 */
+	std::vector<double> m_probabilities;
+
+	/**
+	 * Each column of the alias table picks its own light if the remainder is below the threshold, and the alias otherwise.
+	 */
+	std::vector<double> m_thresholds;
+	std::vector<int> m_aliases;
+};
@@ -4,10 +4,32 @@
 #include "EngineException.h"
 
 
-Mesh::Mesh(std::string filename, IShader* shader)
+Mesh::Mesh(std::string filename, IShader* shader, ThreadEngine::TaskGraph *loader)
 {
 	m_shader = shader;
+	m_bvh = NULL;
+
+	if (loader == NULL)
+	{
+		m_bvh = BVHNode::ConstructBVH(ReadTriangles(filename, shader));
+		return;
+	}
+
+	// Read the file in one task, and build the BVH in another once it is done, so that other meshes can be read in the meantime.
+	ThreadEngine::Future< std::vector<IObject*> > triangles = loader->Async< std::vector<IObject*> >([filename, shader]()
+	{
+		return (ReadTriangles(filename, shader));
+	});
+
+	m_loadTask = loader->Add([this, triangles]() mutable
+	{
+		m_bvh = BVHNode::ConstructBVH(triangles.Get());
+	}, std::vector<ThreadEngine::TaskHandle>(1, triangles));
+}
 
+
+std::vector<IObject*> Mesh::ReadTriangles(std::string filename, IShader *shader)
+{
 	ModelOBJ mOBJ;
 	if (mOBJ.import(filename.c_str()) == false)
 	{
@@ -71,20 +93,43 @@ Mesh::Mesh(std::string filename, IShader* shader)
 		}
 	}
 
-	// Construct BVH.
-	m_bvh = BVHNode::ConstructBVH(triList);
+	return (triList);
 }
 
 
 Mesh::~Mesh()
 {
+	// Don't pull the mesh out from under a task that is still building it.
+	if (m_loadTask != NULL)
+	{
+		try
+		{
+			m_loadTask->Wait();
+		}
+		catch (...)
+		{
+			// The mesh never got loaded, so there is nothing to free.
+		}
+	}
+
 	delete m_bvh;
 	m_bvh = NULL;
 }
 
 
+void Mesh::WaitUntilLoaded()
+{
+	if (m_loadTask != NULL)
+	{
+		m_loadTask->Wait();
+		m_loadTask = NULL;
+	}
+}
+
+
 BBox Mesh::GetBoundingBox()
 {
+	WaitUntilLoaded();
 	return m_bvh->GetBoundingBox();
 }
 
@@ -95,7 +140,13 @@ IShader* Mesh::GetShader()
 }
 
 
-bool Mesh::Intersect(const Ray& ray, Intersection& result)
+bool Mesh::Intersect(const Ray& ray, HitRecord& hit)
+{
+	return (m_bvh->Intersect(ray, hit));
+}
+
+
+sivelab::Vector3D Mesh::GetNormal(const Ray& ray, const HitRecord& hit)
 {
-	return (m_bvh->Intersect(ray, result));
+	return (hit.primitive->GetNormal(ray, hit));
 }
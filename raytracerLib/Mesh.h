@@ -3,6 +3,7 @@
 #include "IObject.h"
 #include "model_obj.h"
 #include "Triangle.h"
+#include "TaskGraph.h"
 
 
 class Mesh : public IObject
@@ -10,16 +11,32 @@ class Mesh : public IObject
 public:
 	/**
 	 * Creates a mesh from the given OBJ filename, and the shader to use to render it.
+	 * @param loader If not NULL, the file is read and its BVH built by tasks on the graph, and the constructor returns straight away.
+	 * Until WaitUntilLoaded() has returned, only GetBoundingBox() and GetShader() may be called, and the first waits for the load.
 	 */
-	Mesh(std::string filename, IShader *shader);
+	Mesh(std::string filename, IShader *shader, ThreadEngine::TaskGraph *loader = NULL);
 	virtual ~Mesh();
 
+	/**
+	 * Waits for the mesh to be read and its BVH built, if that is being done by tasks.
+	 * Once it has succeeded, the mesh lets go of the task, so that it can outlive the graph the task ran in.
+	 * @throws EngineException If the file could not be read.
+	 */
+	void WaitUntilLoaded();
+
 	virtual BBox GetBoundingBox();
 	virtual IShader* GetShader();
-	virtual bool Intersect(const Ray& ray, Intersection& result);
+	virtual bool Intersect(const Ray& ray, HitRecord& hit);
+	virtual sivelab::Vector3D GetNormal(const Ray& ray, const HitRecord& hit);
 
 private:
+	/**
+	 * Reads the triangles out of an OBJ file.
+	 */
+	static std::vector<IObject*> ReadTriangles(std::string filename, IShader *shader);
+
 	IObject *m_bvh;
+	ThreadEngine::TaskHandle m_loadTask;
 
 	IShader *m_shader;
 };
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <cmath>
+
+#include "NoiseVolume.h"
+#include "Perlin.h"
+#include "EngineException.h"
+
+using namespace std;
+using namespace sivelab;
+
+
+NoiseVolume::NoiseVolume(const BBox &bounds, int resolution, double alpha, double beta, int octaves)
+{
+	if (resolution < 2)
+	{
+		throw EngineException("Noise volumes need at least 2 grid points along each axis!");
+	}
+
+	m_bounds = bounds;
+	m_resolution = resolution;
+	m_alpha = alpha;
+	m_beta = beta;
+	m_octaves = octaves;
+
+	Vector3D spacing;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		double extent = bounds.maxPt[axis] - bounds.minPt[axis];
+		m_cellsPerUnit[axis] = (extent > 0.0) ? ((resolution - 1) / extent) : 0.0;
+		spacing[axis] = extent / (resolution - 1);
+	}
+
+	// Bake a row at a time, so that the noise is evaluated in batches.
+	m_values.resize((size_t)resolution * resolution * resolution);
+	vector<double> x(resolution), y(resolution), z(resolution), row(resolution);
+	for (int i = 0; i < resolution; i++)
+	{
+		x[i] = bounds.minPt[0] + i * spacing[0];
+	}
+
+	for (int k = 0; k < resolution; k++)
+	{
+		for (int j = 0; j < resolution; j++)
+		{
+			fill(y.begin(), y.end(), bounds.minPt[1] + j * spacing[1]);
+			fill(z.begin(), z.end(), bounds.minPt[2] + k * spacing[2]);
+			PerlinNoise3DBatch(&x[0], &y[0], &z[0], &row[0], resolution, alpha, beta, octaves);
+
+			float *values = &m_values[((size_t)k * resolution + j) * resolution];
+			for (int i = 0; i < resolution; i++)
+			{
+				values[i] = (float)row[i];
+			}
+		}
+	}
+}
+
+
+double NoiseVolume::Sample(const Vector3D &point) const
+{
+	// Find the cell the point is in, and how far across it the point is.
+	int cell[3];
+	double fraction[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		double position = (point[axis] - m_bounds.minPt[axis]) * m_cellsPerUnit[axis];
+		position = min(max(position, 0.0), (double)(m_resolution - 1));
+
+		cell[axis] = min((int)position, m_resolution - 2);
+		fraction[axis] = position - cell[axis];
+	}
+
+	size_t rowStride = m_resolution;
+	size_t sliceStride = rowStride * m_resolution;
+	const float *corner = &m_values[cell[2] * sliceStride + cell[1] * rowStride + cell[0]];
+
+	// Blend along x, then y, then z.
+	double x00 = corner[0] + fraction[0] * (corner[1] - corner[0]);
+	double x10 = corner[rowStride] + fraction[0] * (corner[rowStride + 1] - corner[rowStride]);
+	double x01 = corner[sliceStride] + fraction[0] * (corner[sliceStride + 1] - corner[sliceStride]);
+	double x11 = corner[sliceStride + rowStride] + fraction[0] * (corner[sliceStride + rowStride + 1] - corner[sliceStride + rowStride]);
+
+	double y0 = x00 + fraction[1] * (x10 - x00);
+	double y1 = x01 + fraction[1] * (x11 - x01);
+
+	return (y0 + fraction[2] * (y1 - y0));
+}
+
+
+bool NoiseVolume::Matches(double alpha, double beta, int octaves) const
+{
+	return ((m_alpha == alpha) && (m_beta == beta) && (m_octaves == octaves));
+}
+
+
+int NoiseVolume::GetResolution() const
+{
+	return (m_resolution);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+#include "BBox.h"
+#include "Vector3D.h"
+
+
+/**
+ * A grid of Perlin noise values, baked over a box ahead of time, so that looking up noise costs one trilinear
+ * interpolation instead of an octave sum.  The lookup is smoother than the real noise wherever the grid is coarser
+ * than the noise's finest octave, so it is meant for previews, or for noise that does not have much fine detail.
+ */
+class NoiseVolume
+{
+public:
+	/**
+	 * Bakes PerlinNoise3D() over the given box.
+	 * @param bounds The box to bake the noise over.  Lookups outside of it are clamped to its faces.
+	 * @param resolution The number of grid points along each axis.  Must be at least 2.
+	 * @param alpha The alpha to pass to PerlinNoise3D().
+	 * @param beta The beta to pass to PerlinNoise3D().
+	 * @param octaves The number of octaves to pass to PerlinNoise3D().
+	 */
+	NoiseVolume(const BBox &bounds, int resolution, double alpha, double beta, int octaves);
+
+	/**
+	 * Looks up the noise at the given point, by interpolating between the eight grid points around it.
+	 */
+	double Sample(const sivelab::Vector3D &point) const;
+
+	/**
+	 * Returns true if the volume holds noise with the given parameters.
+	 */
+	bool Matches(double alpha, double beta, int octaves) const;
+
+	/**
+	 * Gets the number of grid points along each axis.
+	 */
+	int GetResolution() const;
+
+private:
+	BBox m_bounds;
+	int m_resolution;
+	double m_alpha, m_beta;
+	int m_octaves;
+
+	/**
+	 * The number of grid cells per unit along each axis.  Zero along an axis that the box is flat in.
+	 */
+	sivelab::Vector3D m_cellsPerUnit;
+
+	/**
+	 * The baked noise, indexed by (z * m_resolution + y) * m_resolution + x.
+	 * Stored as floats, to halve the memory a fine grid takes up.
+	 */
+	std::vector<float> m_values;
+};
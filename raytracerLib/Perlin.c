@@ -10,12 +10,17 @@ double LinearInterpolate(double a, double b, double t)
 }
 
 
-double CosineInterpolate(double a, double b, double t)
+// The weight that CosineInterpolate() blends with.  Only depends on t, so noise3 works it out once per axis.
+double CosineWeight(double t)
 {
 	double ft = t * M_PI;
-	double f = (1 - cos(ft)) * .5;
+	return ((1 - cos(ft)) * .5);
+}
+
 
-	return (LinearInterpolate(a, b, f));
+double CosineInterpolate(double a, double b, double t)
+{
+	return (LinearInterpolate(a, b, CosineWeight(t)));
 }
 
 
@@ -32,26 +37,31 @@ double lerp(double t, double a, double b)
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
 #include <math.h>
+#include <pthread.h>
 
 static int p[B + B + 2];
 static double g3[B + B + 2][3];
 static double g2[B + B + 2][2];
 static double g1[B + B + 2];
-static int start = 1;
+static pthread_once_t initOnce = PTHREAD_ONCE_INIT;
 
 void init(void);
 
+void PerlinInit(void)
+{
+	pthread_once(&initOnce, init);
+}
+
 double noise1(double arg)
 {
 	int bx0, bx1;
 	double rx0, rx1, sx, t, u, v, vec[1];
 	
 	vec[0] = arg;
-	if (start) {
-		start = 0;
-		init();
-	}
+	PerlinInit();
 	
 	setup(0,bx0,bx1,rx0,rx1);
 	
@@ -68,10 +78,7 @@ double noise2(double vec[2])
 	double rx0, rx1, ry0, ry1, *q, sx, sy, a, b, t, u, v;
 	int i, j;
 	
-	if (start) {
-		start = 0;
-		init();
-	}
+	PerlinInit();
 	
 	setup(0, bx0,bx1, rx0,rx1);
 	setup(1, by0,by1, ry0,ry1);
@@ -100,52 +107,85 @@ double noise2(double vec[2])
 
 double noise3(double vec[3])
 {
-	int bx0, bx1, by0, by1, bz0, bz1, b00, b10, b01, b11;
-	double rx0, rx1, ry0, ry1, rz0, rz1, *q, sy, sz, a, b, c, d, t, u, v;
-	int i, j;
-	
-	if (start) {
-		start = 0;
-		init();
+	double out;
+
+	noise3v(&vec[0], &vec[1], &vec[2], &out, 1);
+	return(out);
+}
+
+void noise3v(const double *x, const double *y, const double *z, double *out, int count)
+{
+	int bx0[NOISE_BATCH], bx1[NOISE_BATCH], by0[NOISE_BATCH], by1[NOISE_BATCH], bz0[NOISE_BATCH], bz1[NOISE_BATCH];
+	int b00[NOISE_BATCH], b10[NOISE_BATCH], b01[NOISE_BATCH], b11[NOISE_BATCH];
+	double rx0[NOISE_BATCH], rx1[NOISE_BATCH], ry0[NOISE_BATCH], ry1[NOISE_BATCH], rz0[NOISE_BATCH], rz1[NOISE_BATCH];
+	double wx[NOISE_BATCH], wy[NOISE_BATCH], wz[NOISE_BATCH];
+	double *q, a, b, c, d, t, u, v;
+	double vec[3];
+	int i, j, k, n;
+
+	PerlinInit();
+
+	while (count > 0) {
+		n = (count < NOISE_BATCH) ? count : NOISE_BATCH;
+
+		/* Lattice cells and offsets.  No lane depends on another, so these loops vectorize. */
+		for (k = 0 ; k < n ; k++) {
+			vec[0] = x[k];
+			vec[1] = y[k];
+			vec[2] = z[k];
+			setup(0, bx0[k],bx1[k], rx0[k],rx1[k]);
+			setup(1, by0[k],by1[k], ry0[k],ry1[k]);
+			setup(2, bz0[k],bz1[k], rz0[k],rz1[k]);
+		}
+
+		/* Blend weights, once per axis instead of once per lerp. */
+		for (k = 0 ; k < n ; k++) {
+			wx[k] = CosineWeight(s_curve(rx0[k]));
+			wy[k] = CosineWeight(s_curve(ry0[k]));
+			wz[k] = CosineWeight(s_curve(rz0[k]));
+		}
+
+		/* Hashing is a gather, so it stays scalar. */
+		for (k = 0 ; k < n ; k++) {
+			i = p[ bx0[k] ];
+			j = p[ bx1[k] ];
+
+			b00[k] = p[ i + by0[k] ];
+			b10[k] = p[ j + by0[k] ];
+			b01[k] = p[ i + by1[k] ];
+			b11[k] = p[ j + by1[k] ];
+		}
+
+		for (k = 0 ; k < n ; k++) {
+			q = g3[ b00[k] + bz0[k] ] ; u = at3(rx0[k],ry0[k],rz0[k]);
+			q = g3[ b10[k] + bz0[k] ] ; v = at3(rx1[k],ry0[k],rz0[k]);
+			a = LinearInterpolate(u, v, wx[k]);
+
+			q = g3[ b01[k] + bz0[k] ] ; u = at3(rx0[k],ry1[k],rz0[k]);
+			q = g3[ b11[k] + bz0[k] ] ; v = at3(rx1[k],ry1[k],rz0[k]);
+			b = LinearInterpolate(u, v, wx[k]);
+
+			c = LinearInterpolate(a, b, wy[k]);
+
+			q = g3[ b00[k] + bz1[k] ] ; u = at3(rx0[k],ry0[k],rz1[k]);
+			q = g3[ b10[k] + bz1[k] ] ; v = at3(rx1[k],ry0[k],rz1[k]);
+			a = LinearInterpolate(u, v, wx[k]);
+
+			q = g3[ b01[k] + bz1[k] ] ; u = at3(rx0[k],ry1[k],rz1[k]);
+			q = g3[ b11[k] + bz1[k] ] ; v = at3(rx1[k],ry1[k],rz1[k]);
+			b = LinearInterpolate(u, v, wx[k]);
+
+			d = LinearInterpolate(a, b, wy[k]);
+
+			out[k] = LinearInterpolate(c, d, wz[k]);
+		}
+
+		x += n;
+		y += n;
+		z += n;
+		out += n;
+		count -= n;
 	}
-	
-	setup(0, bx0,bx1, rx0,rx1);
-	setup(1, by0,by1, ry0,ry1);
-	setup(2, bz0,bz1, rz0,rz1);
-	
-	i = p[ bx0 ];
-	j = p[ bx1 ];
-	
-	b00 = p[ i + by0 ];
-	b10 = p[ j + by0 ];
-	b01 = p[ i + by1 ];
-	b11 = p[ j + by1 ];
-	
-	t  = s_curve(rx0);
-	sy = s_curve(ry0);
-	sz = s_curve(rz0);
-	
-	q = g3[ b00 + bz0 ] ; u = at3(rx0,ry0,rz0);
-	q = g3[ b10 + bz0 ] ; v = at3(rx1,ry0,rz0);
-	a = lerp(t, u, v);
-	
-	q = g3[ b01 + bz0 ] ; u = at3(rx0,ry1,rz0);
-	q = g3[ b11 + bz0 ] ; v = at3(rx1,ry1,rz0);
-	b = lerp(t, u, v);
-	
-	c = lerp(sy, a, b);
-	
-	q = g3[ b00 + bz1 ] ; u = at3(rx0,ry0,rz1);
-	q = g3[ b10 + bz1 ] ; v = at3(rx1,ry0,rz1);
-	a = lerp(t, u, v);
-	
-	q = g3[ b01 + bz1 ] ; u = at3(rx0,ry1,rz1);
-	q = g3[ b11 + bz1 ] ; v = at3(rx1,ry1,rz1);
-	b = lerp(t, u, v);
-	
-	d = lerp(sy, a, b);
-	
-	return lerp(sz, c, d);
 }
 
 void normalize2(double v[2])
@@ -167,26 +207,43 @@ void normalize3(double v[3])
 	v[2] = v[2] / s;
 }
 
+/*
+ * Draws the next number for init().  The tables used to come from random() before anything else called it,
+ * so this generator is seeded the same way as an unseeded random(), and the noise looks the same as it always has,
+ * no matter what else in the program uses random().
+ */
+static int32_t nextRandom(struct random_data *state)
+{
+	int32_t result;
+	random_r(state, &result);
+	return (result);
+}
+
 void init(void)
 {
 	int i, j, k;
+	char stateBuffer[128];
+	struct random_data state;
+
+	memset(&state, 0, sizeof(state));
+	initstate_r(1, stateBuffer, sizeof(stateBuffer), &state);
 	
 	for (i = 0 ; i < B ; i++) {
 		p[i] = i;
-		g1[i] = (double)((random() % (B + B)) - B) / B;
+		g1[i] = (double)((nextRandom(&state) % (B + B)) - B) / B;
 		
 		for (j = 0 ; j < 2 ; j++)
-			g2[i][j] = (double)((random() % (B + B)) - B) / B;
+			g2[i][j] = (double)((nextRandom(&state) % (B + B)) - B) / B;
 		normalize2(g2[i]);
 		
 		for (j = 0 ; j < 3 ; j++)
-			g3[i][j] = (double)((random() % (B + B)) - B) / B;
+			g3[i][j] = (double)((nextRandom(&state) % (B + B)) - B) / B;
 		normalize3(g3[i]);
 	}
 	
 	while (--i) {
 		k = p[i];
-		p[i] = p[j = random() % B];
+		p[i] = p[j = nextRandom(&state) % B];
 		p[j] = k;
 	}
 	
@@ -244,21 +301,79 @@ double PerlinNoise2D(double x,double y,double alpha,double beta,int n)
 
 double PerlinNoise3D(double x,double y,double z,double alpha,double beta,int n)
 {
-	int i;
-	double val,sum = 0;
-	double p[3],scale = 1;
-	
-	p[0] = x;
-	p[1] = y;
-	p[2] = z;
-	for (i=0;i<n;i++) {
-		val = noise3(p);
-		sum += val / scale;
-		scale *= alpha;
-		p[0] *= beta;
-		p[1] *= beta;
-		p[2] *= beta;
-	}
+	double sum;
+
+	PerlinNoise3DBatch(&x, &y, &z, &sum, 1, alpha, beta, n);
 	return(sum);
 }
 
+void PerlinNoise3DBatch(const double *x, const double *y, const double *z, double *out, int count, double alpha, double beta, int n)
+{
+	int i, k;
+	double px[NOISE_BATCH], py[NOISE_BATCH], pz[NOISE_BATCH], val[NOISE_BATCH];
+	double scale;
+
+	for (k = 0 ; k < count ; k++)
+		out[k] = 0;
+
+	/*
+	 * Every octave of a point is independent of the others, so with one point they are evaluated as a batch,
+	 * and with more points each octave is evaluated for a batch of points.  The sums are formed in the same order either way.
+	 */
+	if (count == 1) {
+		double octaves[NOISE_BATCH];
+		int first;
+
+		px[0] = x[0];
+		py[0] = y[0];
+		pz[0] = z[0];
+		scale = 1;
+		for (first = 0 ; first < n ; first += NOISE_BATCH) {
+			int batch = (n - first < NOISE_BATCH) ? (n - first) : NOISE_BATCH;
+			for (i = 1 ; i < batch ; i++) {
+				px[i] = px[i - 1] * beta;
+				py[i] = py[i - 1] * beta;
+				pz[i] = pz[i - 1] * beta;
+			}
+
+			noise3v(px, py, pz, octaves, batch);
+			for (i = 0 ; i < batch ; i++) {
+				out[0] += octaves[i] / scale;
+				scale *= alpha;
+			}
+
+			px[0] = px[batch - 1] * beta;
+			py[0] = py[batch - 1] * beta;
+			pz[0] = pz[batch - 1] * beta;
+		}
+		return;
+	}
+
+	while (count > 0) {
+		int batch = (count < NOISE_BATCH) ? count : NOISE_BATCH;
+
+		for (k = 0 ; k < batch ; k++) {
+			px[k] = x[k];
+			py[k] = y[k];
+			pz[k] = z[k];
+		}
+
+		scale = 1;
+		for (i = 0 ; i < n ; i++) {
+			noise3v(px, py, pz, val, batch);
+			for (k = 0 ; k < batch ; k++) {
+				out[k] += val[k] / scale;
+				px[k] *= beta;
+				py[k] *= beta;
+				pz[k] *= beta;
+			}
+			scale *= alpha;
+		}
+
+		x += batch;
+		y += batch;
+		z += batch;
+		out += batch;
+		count -= batch;
+	}
+}
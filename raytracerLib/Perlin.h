@@ -24,10 +24,30 @@ r1 = r0 - 1.;
 #define at2(rx,ry) ( rx * q[0] + ry * q[1] )
 #define at3(rx,ry,rz) ( rx * q[0] + ry * q[1] + rz * q[2] )
 
+/* The number of points noise3v() works on at once.  Wide enough to fill an AVX register of doubles twice over. */
+#define NOISE_BATCH 8
+
+/*
+ * Builds the gradient and permutation tables.  Safe to call from any number of threads, and only does the work once.
+ * The noise functions call it themselves, but calling it up front keeps the first render thread from paying for it.
+ */
+void PerlinInit(void);
+
 double PerlinNoise1D(double x, double alpha, double beta, int n);
 double PerlinNoise2D(double x, double y, double alpha, double beta, int n);
 double PerlinNoise3D(double x, double y, double z, double alpha, double beta, int n);
 
+/*
+ * Evaluates noise3 at count points at once, given as separate x, y and z arrays.
+ * Gives exactly the same results as evaluating each point on its own.
+ */
+void noise3v(const double *x, const double *y, const double *z, double *out, int count);
+
+/*
+ * Evaluates PerlinNoise3D() at count points at once, given as separate x, y and z arrays.
+ */
+void PerlinNoise3DBatch(const double *x, const double *y, const double *z, double *out, int count, double alpha, double beta, int n);
+
 
 #ifdef __cplusplus
 }
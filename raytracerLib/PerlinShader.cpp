@@ -3,42 +3,84 @@
 #include "Intersection.h"
 #include "BlinnPhongShader.h"
 #include "ColorGradient.h"
+#include "ShadingTerms.h"
+#include "NoiseVolume.h"
 
 
 using namespace sivelab;
 
 
-PerlinShader::PerlinShader(Scene* scene)
+// The parameters of the dirty mirror's noise, which is the pattern that gets baked.
+static const double DIRTY_MIRROR_ALPHA = 2.0;
+static const double DIRTY_MIRROR_BETA = 2.0;
+static const int DIRTY_MIRROR_OCTAVES = 8;
+
+
+PerlinShader::PerlinShader(Scene* scene, int noiseResolution)
 {
 	m_scene = scene;
+	m_noiseResolution = noiseResolution;
+	m_noiseVolume = NULL;
+
+	// Build the noise tables now, while the scene is loading, instead of in the middle of the first render.
+	PerlinInit();
 }
 
 
 PerlinShader::~PerlinShader()
 {
+	delete m_noiseVolume;
+	m_noiseVolume = NULL;
+}
+
+
+int PerlinShader::GetNoiseResolution() const
+{
+	return (m_noiseResolution);
+}
+
+
+void PerlinShader::BakeNoise(const BBox& bounds)
+{
+	if (m_noiseResolution <= 0)
+	{
+		return;
+	}
+
+	delete m_noiseVolume;
+	m_noiseVolume = new NoiseVolume(bounds, m_noiseResolution, DIRTY_MIRROR_ALPHA, DIRTY_MIRROR_BETA, DIRTY_MIRROR_OCTAVES);
+}
+
+
+double PerlinShader::GetNoise(const Vector3D& point, double alpha, double beta, int octaves)
+{
+	if ((m_noiseVolume != NULL) && m_noiseVolume->Matches(alpha, beta, octaves))
+	{
+		return (m_noiseVolume->Sample(point));
+	}
+
+	return (PerlinNoise3D(point[0], point[1], point[2], alpha, beta, octaves));
 }
 
 
-Color PerlinShader::DirtyMirror(Intersection& intersection)
+void PerlinShader::DirtyMirror(Intersection& intersection, ShadingTerms& terms)
 {
 	Vector3D intersectPoint = intersection.collidedRay.GetPositionAtTime(intersection.t);
 	ColorGradient gradient(Color(0.75, 0.8, 1.0), Color(0.1, 0.1, 0.1));
 
 	// Calculate and normalize noise to the range [0,1].
-	double noise = PerlinNoise3D(intersectPoint[0], intersectPoint[1], intersectPoint[2], 2.0, 2.0, 8);
+	double noise = GetNoise(intersectPoint, DIRTY_MIRROR_ALPHA, DIRTY_MIRROR_BETA, DIRTY_MIRROR_OCTAVES);
 	noise /= 0.7;
 	//noise = sin(noise + intersectPoint[0]);
 	noise = (noise + 1.0) / 2.0;
 
 	// Calculate the reflective part of the scene.
 	BlinnPhongShader blinnPhong(m_scene, gradient.GetStart(), Color(1.0, 1.0, 1.0), 320.0, noise, 0.0);
-	Color diffuse = blinnPhong.Shade(intersection);
-
-	return (diffuse);
+	blinnPhong.Decompose(intersection, terms);
 }
 
 
-Color PerlinShader::BrushedMetal(Intersection& intersection)
+void PerlinShader::BrushedMetal(Intersection& intersection, ShadingTerms& terms)
 {
 	Vector3D intersectPoint = intersection.collidedRay.GetPositionAtTime(intersection.t);
 	ColorGradient gradient(Color(0.6, 0.6, 0.7), Color(0.1, 0.1, 0.1));
@@ -50,22 +92,21 @@ Color PerlinShader::BrushedMetal(Intersection& intersection)
 
 	// Calculate the reflective part of the scene.
 	BlinnPhongShader blinnPhong(m_scene, gradient.GetStart(), Color(1.0, 1.0, 1.0), 320.0, 0.0, 0.0);
-	Color diffuse = blinnPhong.Shade(intersection);
+	blinnPhong.Decompose(intersection, terms);
 
 	// Combine the blinnPhong color and the noise color.
-	diffuse.AddColors(gradient.Sample(noise));
-	diffuse.LinearMult(0.5);
-	return (diffuse);
+	terms.base.AddColors(gradient.Sample(noise));
+	terms.Scale(0.5);
 }
 
 
-Color PerlinShader::Marble(Intersection& intersection)
+void PerlinShader::Marble(Intersection& intersection, ShadingTerms& terms)
 {
 	Vector3D intersectPoint = intersection.collidedRay.GetPositionAtTime(intersection.t);
 	ColorGradient gradient(Color((uint8_t)17, 8, 1), Color((uint8_t)180, 154, 141));
 
 	// Calculate and normalize noise.
-	double noise = PerlinNoise3D(intersectPoint[0], intersectPoint[1], intersectPoint[2], 2.0, 3.0, 5);
+	double noise = GetNoise(intersectPoint, 2.0, 3.0, 5);
 	noise /= 0.7;
 
 	// Take sine of noise and a coordinate to get some periodicity.
@@ -76,18 +117,26 @@ Color PerlinShader::Marble(Intersection& intersection)
 
 	// Calculate the reflective part of the scene.
 	BlinnPhongShader blinnPhong(m_scene, gradient.GetStart(), Color(1.0, 1.0, 1.0), 320.0, 0.05, 0.0);
-	Color diffuse = blinnPhong.Shade(intersection);
+	blinnPhong.Decompose(intersection, terms);
 
 	// Combine the blinnPhong color and the noise color.
-	diffuse.AddColors(gradient.Sample(noise));
-	return (diffuse);
+	terms.base.AddColors(gradient.Sample(noise));
 }
 
 
 Color PerlinShader::Shade(Intersection& intersection)
 {
-//	return (BrushedMetal(intersection));
-	return (DirtyMirror(intersection));
-//	return (Marble(intersection));
+	ShadingTerms terms;
+	Decompose(intersection, terms);
+	return (m_scene->ResolveShadingTerms(intersection, terms));
+}
+
+
+bool PerlinShader::Decompose(Intersection& intersection, ShadingTerms& terms)
+{
+//	BrushedMetal(intersection, terms);
+	DirtyMirror(intersection, terms);
+//	Marble(intersection, terms);
+	return (true);
 }
 
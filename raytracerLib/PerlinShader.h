@@ -1,33 +1,61 @@
 #pragma once
 
 #include "IShader.h"
+#include "BBox.h"
 
 class Scene;
+class NoiseVolume;
 
 class PerlinShader : public IShader
 {
 public:
-	PerlinShader(Scene *scene);
+	/**
+	 * Creates a Perlin noise shader.
+	 * @param scene The scene the shader belongs to.
+	 * @param noiseResolution If above zero, the noise is baked into a grid with this many points along each axis
+	 *                        once BakeNoise() is called, and looked up from it instead of evaluated at every hit.
+	 */
+	PerlinShader(Scene *scene, int noiseResolution = 0);
 
 	virtual ~PerlinShader();
 
 	virtual Color Shade(Intersection& intersection);
 
+	virtual bool Decompose(Intersection& intersection, ShadingTerms& terms);
+
 	/**
 	 * A dirty mirror shader.
 	 */
-	Color DirtyMirror(Intersection& intersection);
+	void DirtyMirror(Intersection& intersection, ShadingTerms& terms);
 
 	/**
 	 * A brushed metal shader.
 	 */
-	Color BrushedMetal(Intersection& intersection);
+	void BrushedMetal(Intersection& intersection, ShadingTerms& terms);
 
 	/**
 	 * A marble shader.
 	 */
-	Color Marble(Intersection& intersection);
+	void Marble(Intersection& intersection, ShadingTerms& terms);
+
+	/**
+	 * Gets the resolution the noise should be baked at, or zero if it should not be baked.
+	 */
+	int GetNoiseResolution() const;
+
+	/**
+	 * Bakes the noise of the active pattern over the given box, which should hold every object that uses this shader.
+	 * Does nothing if the noise resolution is zero.
+	 */
+	void BakeNoise(const BBox &bounds);
 
 private:
+	/**
+	 * Gets the noise at the given point, from the baked noise if it was baked with the same parameters.
+	 */
+	double GetNoise(const sivelab::Vector3D &point, double alpha, double beta, int octaves);
+
 	Scene *m_scene;
+	int m_noiseResolution;
+	NoiseVolume *m_noiseVolume;
 };
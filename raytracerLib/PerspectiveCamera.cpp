@@ -3,7 +3,7 @@
 #include "PerspectiveCamera.h"
 #include "Vector3D.h"
 #include "EngineException.h"
-#include "JitteredSampler.h"
+#include "ISampler.h"
 
 using namespace sivelab;
 
@@ -16,12 +16,10 @@ PerspectiveCamera::PerspectiveCamera(const Ray& positionAndDirection, double vie
 	m_samplesPerPixel = samplesPerPixel;
 	m_basis.Calculate(positionAndDirection.GetDirection(), Vector3D(0.0, 1.0, 0.0));
 
-	// Make sure that the number of samples per pixel is a perfect square.
-	int sqrtSamplesPerPixel = (int)sqrt(m_samplesPerPixel);
-	if ((sqrtSamplesPerPixel * sqrtSamplesPerPixel) != m_samplesPerPixel)
+	if (m_samplesPerPixel <= 0)
 	{
 		char buffer[128];
-		sprintf(buffer, "Unable to construct jittered samples: %i is not a perfect square!", m_samplesPerPixel);
+		sprintf(buffer, "Unable to construct camera: %i samples per pixel is not positive!", m_samplesPerPixel);
 		throw EngineException(buffer);
 	}
 }
@@ -61,30 +59,41 @@ Ray PerspectiveCamera::GetRayThroughPoint(double imageX, double imageY)
 }
 
 
-RayList PerspectiveCamera::CalculateViewingRays(double imageX, double imageY)
+RayList PerspectiveCamera::CalculateViewingRays(double imageX, double imageY, const ISampler &sampler)
 {
 	// The list of rays for this pixel.
-	RayList rayList;
+	RayList rayList(m_samplesPerPixel);
+	for (int i = 0; i < m_samplesPerPixel; i++)
+	{
+		rayList[i] = CalculateViewingRay(imageX, imageY, sampler, i);
+	}
 
+	// Return the list of rays.
+	return (rayList);
+}
+
+
+Ray PerspectiveCamera::CalculateViewingRay(double imageX, double imageY, const ISampler &sampler, int index)
+{
 	// Shoot a single ray through the center of the pixel if we are only doing one sample per pixel.
 	if (m_samplesPerPixel == 1)
 	{
-		rayList.push_back(GetRayThroughPoint(imageX + 0.5, imageY + 0.5));
-		return (rayList);
+		return (CalculateCenterRay(imageX, imageY));
 	}
 
-	// Generate some jittered rays to shoot through the pixel.
-	JitteredSampler sampleGenerator;
-	sampleGenerator.Generate(m_samplesPerPixel);
-	const SampleList &samples = sampleGenerator.GetSampleList();
+	// Offset the ray by the sample inside of the pixel.
+	Sample sample = sampler.GetSample((int)imageX, (int)imageY, index, m_samplesPerPixel, GetSampleDimension(SAMPLE_CAMERA, 0));
+	return (GetRayThroughPoint(imageX + sample.first, imageY + sample.second));
+}
 
-	rayList.resize(samples.size());
-	for (size_t i = 0; i < samples.size(); i++)
-	{
-		rayList[i] = GetRayThroughPoint(imageX + samples[i].first, imageY + samples[i].second);
-	}
 
-	// Return the list of rays.
-	return (rayList);
+Ray PerspectiveCamera::CalculateCenterRay(double imageX, double imageY)
+{
+	return (GetRayThroughPoint(imageX + 0.5, imageY + 0.5));
 }
 
+
+int PerspectiveCamera::GetSamplesPerPixel()
+{
+	return (m_samplesPerPixel);
+}
@@ -11,18 +11,24 @@ class PerspectiveCamera : public ICamera
 public:
 	/**
 	 * Constructs a perspective camera with the given position, direction, and view plane.
-	 * If samplesPerPixel is one, the camera acts as a regular sampler, otherwise, it acts as a jittered sampler.
+	 * If samplesPerPixel is one, the camera acts as a regular sampler, otherwise, it uses the sampler it is given.
 	 * @param positionAndDirection The position and direction of the camera in world space.
 	 * @param viewPlaneDist The distance from the camera to the view plane.
 	 * @param viewPlaneWidth The width of the view plane.
-	 * @param samplesPerPixel The number of samples per pixel.  Must be a perfect square.
-	 * @throws RaytraceException if the number of samples per pixel is not a perfect square.
+	 * @param samplesPerPixel The number of samples per pixel.  Must be positive.
+	 * @throws RaytraceException if the number of samples per pixel is not positive.
 	 */
 	PerspectiveCamera(const Ray &positionAndDirection, double viewPlaneDist, double viewPlaneWidth, int samplesPerPixel = 1);
 
 	virtual Ray GetPositionAndDirection();
 
-	virtual RayList CalculateViewingRays(double imageX, double imageY);
+	virtual RayList CalculateViewingRays(double imageX, double imageY, const ISampler &sampler);
+
+	virtual Ray CalculateViewingRay(double imageX, double imageY, const ISampler &sampler, int index);
+
+	virtual Ray CalculateCenterRay(double imageX, double imageY);
+
+	virtual int GetSamplesPerPixel();
 
 	virtual void SetImageDimensions(double width, double height);
 
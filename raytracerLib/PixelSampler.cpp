@@ -0,0 +1,72 @@
+#include "PixelSampler.h"
+#include "EngineException.h"
+
+
+PixelSampler::PixelSampler()
+{
+	m_sampler = NULL;
+	m_pixelX = 0;
+	m_pixelY = 0;
+	m_sampleCount = 0;
+	m_currentSample = 0;
+}
+
+
+void PixelSampler::Start(const ISampler* sampler, int pixelX, int pixelY, int sampleCount)
+{
+	if (sampleCount <= 0)
+	{
+		throw EngineException("Unable to sample a pixel: the number of samples must be positive!");
+	}
+
+	m_sampler = sampler;
+	m_pixelX = pixelX;
+	m_pixelY = pixelY;
+	m_sampleCount = sampleCount;
+	m_currentSample = 0;
+}
+
+
+Sample PixelSampler::GetSample(int index, int dimension) const
+{
+	ThrowIfNotStarted();
+
+	return (m_sampler->GetSample(m_pixelX, m_pixelY, index % m_sampleCount, m_sampleCount, dimension));
+}
+
+
+Sample PixelSampler::GetCurrentSample(int dimension) const
+{
+	return (GetSample(m_currentSample, dimension));
+}
+
+
+void PixelSampler::Next()
+{
+	ThrowIfNotStarted();
+
+	m_currentSample++;
+}
+
+
+void PixelSampler::SetCurrentSample(int index)
+{
+	ThrowIfNotStarted();
+
+	m_currentSample = index;
+}
+
+
+int PixelSampler::GetSampleCount() const
+{
+	return (m_sampleCount);
+}
+
+
+void PixelSampler::ThrowIfNotStarted() const
+{
+	if (m_sampler == NULL)
+	{
+		throw EngineException("Tried to do something before calling PixelSampler::Start()!");
+	}
+}
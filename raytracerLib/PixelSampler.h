@@ -0,0 +1,68 @@
+#pragma once
+
+#include "ISampler.h"
+
+
+/**
+ * Steps through the samples of a single pixel.
+ * Does not own the sampler, and is cheap to copy.
+ */
+class PixelSampler
+{
+public:
+	/**
+	 * Sets up the pixel sampler.  Start() must be called before it can be used.
+	 */
+	PixelSampler();
+
+	/**
+	 * Starts sampling a pixel.
+	 * The current sample is set to the first one.
+	 * @param sampler The sampler to take samples from.
+	 * @param pixelX The x-coordinate of the pixel.
+	 * @param pixelY The y-coordinate of the pixel.
+	 * @param sampleCount The number of samples to take in the pixel.
+	 */
+	void Start(const ISampler *sampler, int pixelX, int pixelY, int sampleCount);
+
+	/**
+	 * Gets the given dimension of the sample with the given index.
+	 * @remarks Must be called after Start().
+	 */
+	Sample GetSample(int index, int dimension) const;
+
+	/**
+	 * Gets the given dimension of the current sample.
+	 * @remarks Must be called after Start().
+	 */
+	Sample GetCurrentSample(int dimension) const;
+
+	/**
+	 * Steps the current sample to the next sample.
+	 * Calling this more than the number of samples will result in wrapping around to the first sample.
+	 * @remarks Must be called after Start().
+	 */
+	void Next();
+
+	/**
+	 * Jumps straight to the sample with the given index.
+	 * @remarks Must be called after Start().
+	 */
+	void SetCurrentSample(int index);
+
+	/**
+	 * Gets the number of samples being taken in the pixel.
+	 */
+	int GetSampleCount() const;
+
+private:
+	/**
+	 * Throws an exception if Start() has not been called yet.
+	 */
+	void ThrowIfNotStarted() const;
+
+	const ISampler *m_sampler;
+	int m_pixelX, m_pixelY;
+	int m_sampleCount;
+	int m_currentSample;
+};
@@ -0,0 +1,418 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <zlib.h>
+
+#include "PngStreamWriter.h"
+#include "Image.h"
+#include "EngineException.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+
+/**
+ * Every png starts with these bytes.
+ */
+static const uint8_t PNG_SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+/**
+ * The zlib header for a deflate stream with a 32K window at the default compression level.
+ */
+static const uint8_t ZLIB_HEADER[] = { 0x78, 0x9C };
+
+/**
+ * A final deflate block with fixed codes and nothing in it, which ends the stream after the groups' sync flushes.
+ */
+static const uint8_t DEFLATE_EMPTY_FINAL_BLOCK[] = { 0x03, 0x00 };
+
+/**
+ * The png filter types, one of which starts each filtered row.
+ */
+enum PngFilter
+{
+	FILTER_NONE = 0,
+	FILTER_SUB,
+	FILTER_UP,
+	FILTER_AVERAGE,
+	FILTER_PAETH,
+	FILTER_COUNT
+};
+
+
+/**
+ * Stores a 32-bit value in network byte order, which is what png uses.
+ */
+static inline void PutUint32(uint8_t *destination, uint32_t value)
+{
+	destination[0] = (uint8_t)(value >> 24);
+	destination[1] = (uint8_t)(value >> 16);
+	destination[2] = (uint8_t)(value >> 8);
+	destination[3] = (uint8_t)value;
+}
+
+
+/**
+ * Predicts a byte from the ones to the left, above, and above left of it, as defined by the png spec.
+ */
+static inline int PaethPredictor(int left, int above, int aboveLeft)
+{
+	int estimate = left + above - aboveLeft;
+	int leftDistance = abs(estimate - left);
+	int aboveDistance = abs(estimate - above);
+	int aboveLeftDistance = abs(estimate - aboveLeft);
+
+	if ((leftDistance <= aboveDistance) && (leftDistance <= aboveLeftDistance))
+	{
+		return (left);
+	}
+	else if (aboveDistance <= aboveLeftDistance)
+	{
+		return (above);
+	}
+
+	return (aboveLeft);
+}
+
+
+/**
+ * Filters a row with whichever filter gives the smallest sum of absolute differences, which is the heuristic libpng uses.
+ * @param row The quantized row.
+ * @param previous The quantized row above it, or zeros for the first row.
+ * @param length The number of bytes in a row.
+ * @param scratch Room for FILTER_COUNT rows.
+ * @param destination Where the filter type, followed by the filtered row, is written.
+ */
+static void FilterRow(const uint8_t *row, const uint8_t *previous, size_t length, uint8_t *scratch, uint8_t *destination)
+{
+	const size_t bytesPerPixel = Image::CHANNELS;
+
+	int bestFilter = FILTER_NONE;
+	uint64_t bestSum = 0;
+	for (int filter = FILTER_NONE; filter < FILTER_COUNT; filter++)
+	{
+		uint8_t *filtered = scratch + filter * length;
+		uint64_t sum = 0;
+		for (size_t i = 0; i < length; i++)
+		{
+			int left = (i >= bytesPerPixel) ? row[i - bytesPerPixel] : 0;
+			int above = previous[i];
+			int aboveLeft = (i >= bytesPerPixel) ? previous[i - bytesPerPixel] : 0;
+
+			int prediction = 0;
+			switch (filter)
+			{
+			case FILTER_SUB:
+				prediction = left;
+				break;
+			case FILTER_UP:
+				prediction = above;
+				break;
+			case FILTER_AVERAGE:
+				prediction = (left + above) / 2;
+				break;
+			case FILTER_PAETH:
+				prediction = PaethPredictor(left, above, aboveLeft);
+				break;
+			}
+
+			filtered[i] = (uint8_t)(row[i] - prediction);
+			sum += abs((int)(int8_t)filtered[i]);
+		}
+
+		if ((filter == FILTER_NONE) || (sum < bestSum))
+		{
+			bestFilter = filter;
+			bestSum = sum;
+		}
+	}
+
+	destination[0] = (uint8_t)bestFilter;
+	memcpy(destination + 1, scratch + bestFilter * length, length);
+}
+
+
+/**
+ * Everything a thread needs to quantize, filter and deflate a group of rows.
+ */
+struct RowGroupJobInfo
+{
+	const Image *image;
+	int startY, endY;
+	double scale, gamma;
+
+	/**
+	 * The quantized row above the group, or NULL if it is in the image too, and has to be quantized again.
+	 */
+	const uint8_t *previousRow;
+
+	/**
+	 * Filled in with the deflated rows, ending with a sync flush.
+	 */
+	vector<uint8_t> compressed;
+
+	/**
+	 * Filled in with the Adler-32 checksum and length of the filtered rows.
+	 */
+	unsigned long adler;
+	size_t filteredLength;
+
+	/**
+	 * Filled in with the last row of the group, quantized.
+	 */
+	vector<uint8_t> lastRow;
+
+	/**
+	 * Set if deflating failed.
+	 */
+	bool failed;
+};
+
+
+/**
+ * Quantizes, filters and deflates a group of rows.
+ * @param info Pointer to the RowGroupJobInfo structure for the group.
+ */
+void *DeflateRowGroup(void *info)
+{
+	RowGroupJobInfo *job = (RowGroupJobInfo*)info;
+	size_t rowLength = Image::CHANNELS * (size_t)job->image->GetWidth();
+	int rowCount = job->endY - job->startY;
+
+	vector<uint8_t> previous(rowLength), current(rowLength);
+	if (job->previousRow != NULL)
+	{
+		memcpy(&previous[0], job->previousRow, rowLength);
+	}
+	else
+	{
+		job->image->QuantizeRow(job->startY - 1, &previous[0], job->scale, job->gamma);
+	}
+
+	// Each filtered row starts with a byte saying which filter it went through.
+	vector<uint8_t> scratch(FILTER_COUNT * rowLength);
+	vector<uint8_t> filtered((rowLength + 1) * rowCount);
+	for (int y = job->startY; y < job->endY; y++)
+	{
+		job->image->QuantizeRow(y, &current[0], job->scale, job->gamma);
+		FilterRow(&current[0], &previous[0], rowLength, &scratch[0], &filtered[(rowLength + 1) * (y - job->startY)]);
+		previous.swap(current);
+	}
+	job->lastRow.swap(previous);
+
+	job->filteredLength = filtered.size();
+	job->adler = adler32(adler32(0L, NULL, 0), &filtered[0], filtered.size());
+
+	// A raw deflate stream, with no zlib header or checksum, since the groups are joined into one stream by the writer.
+	z_stream stream;
+	memset(&stream, 0, sizeof(stream));
+	if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		job->failed = true;
+		return (NULL);
+	}
+
+	// The bound is for a finished stream, and a sync flush adds at most an empty stored block on top of that.
+	job->compressed.resize(deflateBound(&stream, filtered.size()) + 16);
+	stream.next_in = &filtered[0];
+	stream.avail_in = filtered.size();
+	stream.next_out = &job->compressed[0];
+	stream.avail_out = job->compressed.size();
+
+	int result = deflate(&stream, Z_SYNC_FLUSH);
+	job->failed = (result != Z_OK) || (stream.avail_in != 0) || (stream.avail_out == 0);
+	job->compressed.resize(stream.total_out);
+	deflateEnd(&stream);
+
+	return (NULL);
+}
+
+
+PngStreamWriter::PngStreamWriter(const string &filename, int width, int height, int threadCount, double gamma)
+{
+	if ((width <= 0) || (height <= 0))
+	{
+		throw EngineException("A png has to have at least one pixel!");
+	}
+	if (gamma <= 0.0)
+	{
+		throw EngineException("The output gamma has to be positive!");
+	}
+
+	m_filename = filename;
+	m_width = width;
+	m_height = height;
+	m_threadCount = max(1, threadCount);
+	m_gamma = gamma;
+	m_rowsWritten = 0;
+	m_previousRow.assign(Image::CHANNELS * (size_t)width, 0);
+	m_adler = adler32(0L, NULL, 0);
+
+	m_out.open(filename.c_str(), ios::out | ios::binary | ios::trunc);
+	if (!m_out)
+	{
+		throw EngineException("Unable to open " + filename + " for writing!");
+	}
+
+	m_out.write((const char*)PNG_SIGNATURE, sizeof(PNG_SIGNATURE));
+
+	// 8-bit RGB, not interlaced.
+	uint8_t header[13];
+	PutUint32(&header[0], width);
+	PutUint32(&header[4], height);
+	header[8] = 8;
+	header[9] = 2;
+	header[10] = 0;
+	header[11] = 0;
+	header[12] = 0;
+	WriteChunk("IHDR", header, sizeof(header));
+
+	// Linear output has always been written without a gamma, and viewers have always shown it as if it was sRGB.
+	if (gamma != 1.0)
+	{
+		uint8_t encodedGamma[4];
+		PutUint32(encodedGamma, (uint32_t)floor(100000.0 / gamma + 0.5));
+		WriteChunk("gAMA", encodedGamma, sizeof(encodedGamma));
+	}
+
+	WriteChunk("IDAT", ZLIB_HEADER, sizeof(ZLIB_HEADER));
+}
+
+
+PngStreamWriter::~PngStreamWriter()
+{
+	m_out.close();
+}
+
+
+void PngStreamWriter::WriteRows(const Image &rows, double scale)
+{
+	if (rows.GetWidth() != m_width)
+	{
+		throw EngineException("Rows written to a png have to be as wide as it is!");
+	}
+	if (rows.GetHeight() > m_height - m_rowsWritten)
+	{
+		throw EngineException("Too many rows written to " + m_filename + "!");
+	}
+	if (rows.GetHeight() == 0)
+	{
+		return;
+	}
+
+	int groupCount = (rows.GetHeight() + ROWS_PER_GROUP - 1) / ROWS_PER_GROUP;
+	vector<RowGroupJobInfo> groups(groupCount);
+	for (int i = 0; i < groupCount; i++)
+	{
+		groups[i].image = &rows;
+		groups[i].startY = i * ROWS_PER_GROUP;
+		groups[i].endY = min((i + 1) * ROWS_PER_GROUP, rows.GetHeight());
+		groups[i].scale = scale;
+		groups[i].gamma = m_gamma;
+		groups[i].previousRow = (i == 0) ? &m_previousRow[0] : NULL;
+		groups[i].failed = false;
+	}
+
+	if (m_threadCount == 1)
+	{
+		for (int i = 0; i < groupCount; i++)
+		{
+			DeflateRowGroup(&groups[i]);
+		}
+	}
+	else
+	{
+		ThreadEngine::ThreadPool deflatePool(m_threadCount);
+		deflatePool.StartProcessing();
+
+		deflatePool.AddJobs(DeflateRowGroup, groups);
+
+		// Wait for all jobs to be completed.
+		deflatePool.JoinAll();
+	}
+
+	// The groups are written in order, each one carrying on the zlib stream and its checksum.
+	for (int i = 0; i < groupCount; i++)
+	{
+		if (groups[i].failed)
+		{
+			throw EngineException("Unable to compress the rows of " + m_filename + "!");
+		}
+
+		WriteChunk("IDAT", &groups[i].compressed[0], groups[i].compressed.size());
+		m_adler = adler32_combine(m_adler, groups[i].adler, groups[i].filteredLength);
+	}
+
+	m_previousRow.swap(groups[groupCount - 1].lastRow);
+	m_rowsWritten += rows.GetHeight();
+}
+
+
+void PngStreamWriter::Finish()
+{
+	if (m_rowsWritten != m_height)
+	{
+		throw EngineException("Not every row of " + m_filename + " was written!");
+	}
+
+	uint8_t ending[sizeof(DEFLATE_EMPTY_FINAL_BLOCK) + 4];
+	memcpy(ending, DEFLATE_EMPTY_FINAL_BLOCK, sizeof(DEFLATE_EMPTY_FINAL_BLOCK));
+	PutUint32(&ending[sizeof(DEFLATE_EMPTY_FINAL_BLOCK)], m_adler);
+	WriteChunk("IDAT", ending, sizeof(ending));
+	WriteChunk("IEND", NULL, 0);
+
+	m_out.flush();
+	if (!m_out)
+	{
+		throw EngineException("Unable to write " + m_filename + "!");
+	}
+}
+
+
+int PngStreamWriter::GetRowsWritten() const
+{
+	return (m_rowsWritten);
+}
+
+
+int PngStreamWriter::GetWidth() const
+{
+	return (m_width);
+}
+
+
+int PngStreamWriter::GetHeight() const
+{
+	return (m_height);
+}
+
+
+void PngStreamWriter::WriteChunk(const char *type, const uint8_t *data, size_t length)
+{
+	uint8_t length32[4];
+	PutUint32(length32, length);
+
+	// The checksum covers the type and the data, but not the length.
+	unsigned long crc = crc32(0L, NULL, 0);
+	crc = crc32(crc, (const Bytef*)type, 4);
+	if (length > 0)
+	{
+		crc = crc32(crc, data, length);
+	}
+	uint8_t crc32Bytes[4];
+	PutUint32(crc32Bytes, crc);
+
+	m_out.write((const char*)length32, sizeof(length32));
+	m_out.write(type, 4);
+	if (length > 0)
+	{
+		m_out.write((const char*)data, length);
+	}
+	m_out.write((const char*)crc32Bytes, sizeof(crc32Bytes));
+
+	if (!m_out)
+	{
+		throw EngineException("Unable to write " + m_filename + "!");
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdint.h>
+
+class Image;
+
+
+/**
+ * Writes a png a band of rows at a time, so that neither the whole image nor a whole 8-bit copy of it has to be in memory.
+ * Each band is quantized to 8 bits, filtered, and deflated in groups of rows.  The groups are compressed independently,
+ * and can be spread across threads, then joined into a single zlib stream by ending each of them on a byte boundary
+ * with a sync flush.  Starting every group with an empty history costs a little compression at each group boundary.
+ */
+class PngStreamWriter
+{
+public:
+	/**
+	 * Opens the file and writes the png's header.
+	 * @param filename The file to write.
+	 * @param width The width of the image.
+	 * @param height The number of rows that will be written.
+	 * @param threadCount The number of threads to quantize and deflate each band with.
+	 * @param gamma The gamma to encode with.  The default of 1.0 writes the channels linearly, and leaves the gamma out of the file.
+	 * @throws EngineException If the file can't be opened, or the gamma is not positive.
+	 */
+	PngStreamWriter(const std::string &filename, int width, int height, int threadCount = 1, double gamma = 1.0);
+
+	/**
+	 * Closes the file.  The file is incomplete unless Finish() was called first.
+	 */
+	~PngStreamWriter();
+
+	/**
+	 * Writes every row of the given image, which comes right below the last row written.
+	 * Each channel is scaled, clipped, gamma-encoded and quantized with Image::QuantizeRow().
+	 * @param rows The band to write.  Must be as wide as the png, and must not go past its bottom.
+	 * @param scale What each channel is multiplied by before it is clipped.
+	 * @throws EngineException If the band does not fit, or the file can't be written.
+	 */
+	void WriteRows(const Image &rows, double scale = 1.0);
+
+	/**
+	 * Ends the compressed data, and the png.
+	 * @throws EngineException If not every row has been written, or the file can't be written.
+	 */
+	void Finish();
+
+	/**
+	 * Gets the number of rows written so far.
+	 */
+	int GetRowsWritten() const;
+
+	/**
+	 * Gets the size of the png.
+	 */
+	int GetWidth() const;
+	int GetHeight() const;
+
+	/**
+	 * The number of rows deflated together.  Each group is a job for one thread.
+	 */
+	static const int ROWS_PER_GROUP = 32;
+
+private:
+	/**
+	 * Writes a png chunk of the given type.
+	 */
+	void WriteChunk(const char *type, const uint8_t *data, size_t length);
+
+	std::string m_filename;
+	std::ofstream m_out;
+	int m_width, m_height;
+	int m_threadCount;
+	double m_gamma;
+	int m_rowsWritten;
+
+	/**
+	 * The last row written, quantized but not filtered, since the filters of the next row are relative to it.
+	 */
+	std::vector<uint8_t> m_previousRow;
+
+	/**
+	 * The Adler-32 checksum of every filtered row deflated so far, which ends the zlib stream.
+	 */
+	unsigned long m_adler;
+};
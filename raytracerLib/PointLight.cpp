@@ -19,3 +19,14 @@ Color PointLight::GetRadiance(const sivelab::Vector3D& position) const
 	return (m_radiance);
 }
 
+
+LightRecord PointLight::Compile() const
+{
+	LightRecord record;
+	record.type = LIGHT_POINT;
+	record.position = m_position;
+	record.radiance = m_radiance;
+	record.width = 0.0;
+	record.height = 0.0;
+	return (record);
+}
@@ -19,6 +19,8 @@ public:
 
 	virtual Color GetRadiance(const sivelab::Vector3D& position) const;
 
+	virtual LightRecord Compile() const;
+
 private:
 	Color m_radiance;
 
@@ -0,0 +1,218 @@
+#include <iostream>
+#include <cstdio>
+#include <time.h>
+
+#include "ProgressiveRenderer.h"
+#include "Scene.h"
+#include "Image.h"
+#include "HdrFile.h"
+#include "Intersection.h"
+#include "TileScheduler.h"
+
+using namespace std;
+
+
+/**
+ * Gets the time in seconds since some fixed point, using a clock that never goes backwards.
+ */
+static double GetSeconds()
+{
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (time.tv_sec + time.tv_nsec * 1e-9);
+}
+
+
+ProgressiveRenderer::ProgressiveRenderer(Scene* scene)
+{
+	m_scene = scene;
+	m_width = 0;
+	m_height = 0;
+	m_passCount = 0;
+}
+
+
+/**
+ * Everything needed to add a pass to a tile.
+ */
+struct ProgressiveTileInfo
+{
+	ProgressiveRenderer *renderer;
+	int pass;
+};
+
+
+/**
+ * Adds a pass to a single tile.
+ * @param context Pointer to the ProgressiveTileInfo structure for the pass.
+ */
+static void RenderProgressiveTile(const Tile &tile, void *context)
+{
+	ProgressiveTileInfo *tileInfo = (ProgressiveTileInfo*)context;
+	tileInfo->renderer->RenderTile(tileInfo->pass, tile);
+}
+
+
+void ProgressiveRenderer::Render(Image& image, int threadCount, Image *sampleCounts)
+{
+	m_width = image.GetWidth();
+	m_height = image.GetHeight();
+	m_passCount = 0;
+	m_accumulation.assign(3 * m_width * m_height, 0.0f);
+
+	// Tell the camera how big the image is.
+	m_scene->m_camera->SetImageDimensions(m_width, m_height);
+
+	int targetPassCount = m_scene->m_camera->GetSamplesPerPixel();
+	double budget = m_scene->ProgressiveTimeBudget;
+	double checkpointInterval = m_scene->CheckpointInterval;
+	bool canCheckpoint = (m_scene->CheckpointFileName != "");
+
+	double beginTime = GetSeconds();
+	double lastCheckpointTime = beginTime;
+	while (m_passCount < targetPassCount)
+	{
+		RenderPass(m_passCount, threadCount);
+		m_passCount++;
+
+		double now = GetSeconds();
+		double elapsed = now - beginTime;
+		if (m_scene->VerboseOutput)
+		{
+			cout << "Finished pass " << m_passCount << " of " << targetPassCount << " after " << elapsed << " s." << endl;
+		}
+
+		// Checkpoint if someone asked for one, or if it has been long enough since the last one.
+		bool checkpointRequested = (m_scene->m_checkpointRequested != 0);
+		bool checkpointDue = (checkpointInterval > 0.0) && (now - lastCheckpointTime >= checkpointInterval);
+		if (canCheckpoint && (checkpointRequested || checkpointDue))
+		{
+			m_scene->m_checkpointRequested = 0;
+			WriteCheckpoint(m_scene->CheckpointFileName, threadCount);
+			lastCheckpointTime = GetSeconds();
+		}
+
+		// Stop early if the next pass probably won't finish before the budget runs out.
+		double passTime = elapsed / m_passCount;
+		if ((budget > 0.0) && (elapsed + passTime > budget))
+		{
+			break;
+		}
+	}
+
+	Resolve(image);
+
+	if (sampleCounts != NULL)
+	{
+		Color countColor = Scene::GetSampleCountColor(m_passCount, targetPassCount);
+		for (int y = 0; y < m_height; y++)
+		{
+			for (int x = 0; x < m_width; x++)
+			{
+				sampleCounts->SetPixel(x, y, countColor);
+			}
+		}
+	}
+}
+
+
+void ProgressiveRenderer::RenderPass(int pass, int threadCount)
+{
+	// Every pass goes through the same tile order and work stealing as a regular render.
+	ProgressiveTileInfo tileInfo;
+	tileInfo.renderer = this;
+	tileInfo.pass = pass;
+
+	Tile area = { 0, 0, m_width, m_height };
+	TileScheduler scheduler(area, m_scene->TileSize, m_scene->RenderTileOrder);
+	scheduler.Run(RenderProgressiveTile, &tileInfo, threadCount);
+}
+
+
+void ProgressiveRenderer::RenderTile(int pass, const Tile &tile)
+{
+	ICamera *camera = m_scene->m_camera;
+	const ISampler *sampler = m_scene->m_sampler;
+	int sampleCount = camera->GetSamplesPerPixel();
+
+	for (int imageY = tile.y; imageY < tile.y + tile.height; imageY++)
+	{
+		for (int imageX = tile.x; imageX < tile.x + tile.width; imageX++)
+		{
+			// Take the same sample that a regular render takes for this pass's index.
+			Ray ray = camera->CalculateViewingRay(imageX, imageY, *sampler, pass);
+			PixelSampler samples;
+			samples.Start(sampler, imageX, imageY, sampleCount);
+			samples.SetCurrentSample(pass);
+
+			Intersection intersect;
+			intersect.samples = &samples;
+
+			Color rayColor;
+			if (m_scene->CastRayAndShade(ray, rayColor, intersect) == false)
+			{
+				// We hit nothing, add in the background color.
+				rayColor = Color(0.0, 0.0, 0.0);
+			}
+
+			float *sum = &m_accumulation[3 * (imageY * m_width + imageX)];
+			sum[0] += rayColor.GetRed();
+			sum[1] += rayColor.GetGreen();
+			sum[2] += rayColor.GetBlue();
+		}
+	}
+}
+
+
+int ProgressiveRenderer::GetPassCount() const
+{
+	return (m_passCount);
+}
+
+
+void ProgressiveRenderer::Resolve(Image& image) const
+{
+	double scale = 1.0 / m_passCount;
+	for (int y = 0; y < m_height; y++)
+	{
+		for (int x = 0; x < m_width; x++)
+		{
+			const float *sum = &m_accumulation[3 * (y * m_width + x)];
+
+			// Flip Y, because we are rendering upside down.
+			image.SetPixel(x, m_height - 1 - y, Color(sum[0] * scale, sum[1] * scale, sum[2] * scale));
+		}
+	}
+}
+
+
+void ProgressiveRenderer::WriteCheckpoint(const std::string& filename, int threadCount) const
+{
+	Image checkpoint(m_width, m_height);
+	Resolve(checkpoint);
+
+	// HDR files are written before any tone mapping, like the final image would be, so the temporary file keeps
+	// the extension that HdrFile picks the format from.
+	string temporaryFilename;
+	if (HdrFile::IsHdrFileName(filename))
+	{
+		size_t dot = filename.rfind('.');
+		temporaryFilename = filename.substr(0, dot) + ".tmp" + filename.substr(dot);
+		HdrFile::Write(checkpoint, temporaryFilename, threadCount);
+	}
+	else
+	{
+		temporaryFilename = filename + ".tmp";
+		checkpoint.WriteToDisk(temporaryFilename);
+	}
+
+	if (rename(temporaryFilename.c_str(), filename.c_str()) != 0)
+	{
+		throw EngineException("Unable to move checkpoint " + temporaryFilename + " to " + filename + "!");
+	}
+
+	if (m_scene->VerboseOutput)
+	{
+		cout << "Wrote checkpoint with " << m_passCount << " samples per pixel to " << filename << "." << endl;
+	}
+}
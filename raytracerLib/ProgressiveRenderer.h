@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+class Scene;
+class Image;
+struct Tile;
+
+
+/**
+ * Renders a scene one sample per pixel at a time, adding each pass into an accumulation buffer.
+ * Passes keep being added until every pixel has the scene's rays per pixel, or until the time budget runs out,
+ * so the image is usable at any point and gets less noisy the longer it runs.
+ * Pass i takes sample i of every pixel, so a render that finishes all of its passes matches a regular render.
+ */
+class ProgressiveRenderer
+{
+public:
+	/**
+	 * Sets up the renderer to render the given scene.
+	 */
+	ProgressiveRenderer(Scene *scene);
+
+	/**
+	 * Renders passes until the target sample count or the time budget is reached, writing checkpoints along the way.
+	 * See Scene::ProgressiveTimeBudget and Scene::CheckpointFileName.
+	 * @param image The image to write the average of every pass to.
+	 * @param threadCount The number of threads to render with.  Must be at least 1.
+	 * @param sampleCounts If not NULL, the number of samples taken in each pixel is written here.  See Scene::Render().
+	 */
+	void Render(Image &image, int threadCount, Image *sampleCounts);
+
+	/**
+	 * Adds a single sample to every pixel in the given tile of the accumulation buffer.
+	 * Threadsafe as long as no two threads render the same pixels.
+	 * @param pass The index of the sample to take in each pixel.
+	 * @param tile The pixels to render, in camera space, where y is not flipped.
+	 */
+	void RenderTile(int pass, const Tile &tile);
+
+	/**
+	 * Gets the number of passes that have been added to the accumulation buffer.
+	 */
+	int GetPassCount() const;
+
+private:
+	/**
+	 * Adds a single sample to every pixel, spreading tiles across the given number of threads.  See Scene::TileSize and Scene::RenderTileOrder.
+	 */
+	void RenderPass(int pass, int threadCount);
+
+	/**
+	 * Writes the average of every pass so far to the given image.
+	 */
+	void Resolve(Image &image) const;
+
+	/**
+	 * Writes the average of every pass so far to the given file.
+	 * The image is written to a temporary file first, and then renamed, so the file is never seen half written.
+	 * File names that end in .pfm or .exr are written with HdrFile, and anything else as a png.
+	 * @param threadCount The number of threads to compress OpenEXR files with.
+	 */
+	void WriteCheckpoint(const std::string &filename, int threadCount) const;
+
+	Scene *m_scene;
+	int m_width, m_height;
+	int m_passCount;
+
+	/**
+	 * The sum of the red, green and blue of every pass, for each pixel.  Indexed by 3 * (y * width + x), where y is not flipped.
+	 */
+	std::vector<float> m_accumulation;
+};
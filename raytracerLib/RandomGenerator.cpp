@@ -0,0 +1,122 @@
+#include "RandomGenerator.h"
+
+
+/**
+ * The multiplier of the underlying linear congruential generator.
+ */
+static const uint64_t PCG_MULTIPLIER = 6364136223846793005ULL;
+
+
+/**
+ * The finalizer from SplitMix64.  Every bit of the input affects every bit of the output.
+ */
+static inline uint64_t MixBits(uint64_t value)
+{
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+	return (value ^ (value >> 31));
+}
+
+
+RandomGenerator::RandomGenerator(uint64_t seed, uint64_t stream)
+{
+	Seed(seed, stream);
+}
+
+
+void RandomGenerator::Seed(uint64_t seed, uint64_t stream)
+{
+	// The increment has to be odd.
+	m_state = 0;
+	m_increment = (stream << 1) | 1;
+	NextUInt();
+	m_state += seed;
+	NextUInt();
+}
+
+
+uint32_t RandomGenerator::NextUInt()
+{
+	uint64_t oldState = m_state;
+	m_state = oldState * PCG_MULTIPLIER + m_increment;
+
+	// Output a random rotation of the xor-shifted high bits.
+	uint32_t xorShifted = (uint32_t)(((oldState >> 18) ^ oldState) >> 27);
+	uint32_t rotation = (uint32_t)(oldState >> 59);
+	return ((xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31)));
+}
+
+
+double RandomGenerator::NextDouble()
+{
+	return (NextUInt() * (1.0 / 4294967296.0));
+}
+
+
+uint64_t RandomGenerator::Hash(uint64_t a, uint64_t b, uint64_t c)
+{
+	const uint64_t golden = 0x9E3779B97F4A7C15ULL;
+
+	uint64_t hash = MixBits(a + golden);
+	hash = MixBits(hash ^ (b + 2 * golden));
+	hash = MixBits(hash ^ (c + 3 * golden));
+	return (hash);
+}
+
+
+uint64_t RandomGenerator::HashBytes(const void *data, size_t length, uint64_t seed)
+{
+	// FNV-1a, with the length and seed mixed in at the end.
+	const uint8_t *bytes = (const uint8_t*)data;
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ULL;
+	}
+
+	return (Hash(hash, length, seed));
+}
+
+
+uint64_t RandomGenerator::HashString(const std::string &text, uint64_t seed)
+{
+	return (HashBytes(text.data(), text.size(), seed));
+}
+
+
+uint32_t RandomGenerator::Permute(uint32_t index, uint32_t length, uint32_t seed)
+{
+	// Find the smallest mask of all ones that covers the length.
+	uint32_t mask = length - 1;
+	mask |= mask >> 1;
+	mask |= mask >> 2;
+	mask |= mask >> 4;
+	mask |= mask >> 8;
+	mask |= mask >> 16;
+
+	// Shuffle inside of the power of two, and cycle walk until we land inside of the length.
+	do
+	{
+		index ^= seed;
+		index *= 0xe170893d;
+		index ^= seed >> 16;
+		index ^= (index & mask) >> 4;
+		index ^= seed >> 8;
+		index *= 0x0929eb3f;
+		index ^= seed >> 23;
+		index ^= (index & mask) >> 1;
+		index *= 1 | seed >> 27;
+		index *= 0x6935fa69;
+		index ^= (index & mask) >> 11;
+		index *= 0x74dcb303;
+		index ^= (index & mask) >> 2;
+		index *= 0x9e501cc3;
+		index ^= (index & mask) >> 2;
+		index *= 0xc860a3df;
+		index &= mask;
+		index ^= index >> 5;
+	} while (index >= length);
+
+	return ((index + seed) % length);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+
+/**
+ * A small, fast PCG32 pseudo-random number generator.
+ * Unlike drand48(), all of the state lives in the object, so each thread (or pixel) can have its own
+ * generator, and the numbers it produces do not depend on what any other thread is doing.
+ */
+class RandomGenerator
+{
+public:
+	/**
+	 * Sets up the generator with the given seed.
+	 * @param seed The starting state.
+	 * @param stream Selects one of 2^63 independent sequences.
+	 */
+	RandomGenerator(uint64_t seed = 0, uint64_t stream = 0);
+
+	/**
+	 * Restarts the generator with the given seed.
+	 */
+	void Seed(uint64_t seed, uint64_t stream = 0);
+
+	/**
+	 * Gets the next uniformly distributed 32 bit integer.
+	 */
+	uint32_t NextUInt();
+
+	/**
+	 * Gets the next uniformly distributed number in [0, 1).
+	 */
+	double NextDouble();
+
+	/**
+	 * Hashes the given values down to a single well-mixed 64 bit value.
+	 * Useful for making seeds out of counters, such as a pixel's coordinates, a sample index, or a bounce number.
+	 */
+	static uint64_t Hash(uint64_t a, uint64_t b = 0, uint64_t c = 0);
+
+	/**
+	 * Hashes the given bytes, combined with a previous hash, down to a single well-mixed 64 bit value.
+	 * Chain calls by passing the last result as the seed, to hash several pieces of data together.
+	 */
+	static uint64_t HashBytes(const void *data, size_t length, uint64_t seed = 0);
+
+	/**
+	 * Same as HashBytes(), for the characters of a string.
+	 */
+	static uint64_t HashString(const std::string &text, uint64_t seed = 0);
+
+	/**
+	 * Maps an index to its position in a random permutation, without storing the permutation.
+	 * This is Kensler's hash-based permutation from "Correlated Multi-Jittered Sampling".
+	 * @param index The index to permute.  Must be less than length.
+	 * @param length The number of elements in the permutation.
+	 * @param seed Selects the permutation.
+	 */
+	static uint32_t Permute(uint32_t index, uint32_t length, uint32_t seed);
+
+private:
+	uint64_t m_state;
+	uint64_t m_increment;
+};
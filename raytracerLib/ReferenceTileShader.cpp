@@ -1,9 +1,18 @@
 #include "ReferenceTileShader.h"
 #include "Intersection.h"
+#include "ShadingTerms.h"
 
 using namespace sivelab;
 
 
+bool ReferenceTileShader::Decompose(Intersection& intersection, ShadingTerms& terms)
+{
+	// The tile color does not depend on any other rays.
+	terms.base = Shade(intersection);
+	return (true);
+}
+
+
 Color ReferenceTileShader::Shade(Intersection& intersection)
 {
 	Vector3D intersectPoint = intersection.collidedRay.GetPositionAtTime(intersection.t);
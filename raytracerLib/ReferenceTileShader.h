@@ -10,4 +10,6 @@ class ReferenceTileShader : public IShader
 {
 public:
     virtual Color Shade(Intersection& intersection);
+
+    virtual bool Decompose(Intersection& intersection, ShadingTerms& terms);
 };
@@ -0,0 +1,61 @@
+#include <math.h>
+
+#include "RunningVariance.h"
+
+
+RunningVariance::RunningVariance()
+{
+	Clear();
+}
+
+
+void RunningVariance::Clear()
+{
+	m_count = 0;
+	m_mean = 0.0;
+	m_sumOfSquares = 0.0;
+}
+
+
+void RunningVariance::Add(double value)
+{
+	m_count++;
+	double delta = value - m_mean;
+	m_mean += delta / m_count;
+	m_sumOfSquares += delta * (value - m_mean);
+}
+
+
+int RunningVariance::GetCount() const
+{
+	return (m_count);
+}
+
+
+double RunningVariance::GetMean() const
+{
+	return (m_mean);
+}
+
+
+double RunningVariance::GetVariance() const
+{
+	if (m_count < 2)
+	{
+		return (0.0);
+	}
+
+	return (m_sumOfSquares / (m_count - 1));
+}
+
+
+double RunningVariance::GetConfidenceInterval() const
+{
+	if (m_count == 0)
+	{
+		return (0.0);
+	}
+
+	// 1.96 standard errors covers 95% of a normal distribution.
+	return (1.96 * sqrt(GetVariance() / m_count));
+}
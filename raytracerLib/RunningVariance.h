@@ -0,0 +1,51 @@
+#pragma once
+
+
+/**
+ * Keeps track of the mean and variance of a stream of values, without storing them.
+ * Uses Welford's method, which does not lose precision when the variance is small compared to the mean.
+ */
+class RunningVariance
+{
+public:
+	RunningVariance();
+
+	/**
+	 * Forgets every value that has been added.
+	 */
+	void Clear();
+
+	/**
+	 * Adds a value to the stream.
+	 */
+	void Add(double value);
+
+	/**
+	 * Gets the number of values that have been added.
+	 */
+	int GetCount() const;
+
+	/**
+	 * Gets the mean of the values added so far.
+	 */
+	double GetMean() const;
+
+	/**
+	 * Gets the unbiased sample variance of the values added so far.  Zero if less than two values have been added.
+	 */
+	double GetVariance() const;
+
+	/**
+	 * Gets the half-width of the 95% confidence interval of the mean.
+	 */
+	double GetConfidenceInterval() const;
+
+private:
+	int m_count;
+	double m_mean;
+
+	/**
+	 * The sum of the squared differences from the mean.
+	 */
+	double m_sumOfSquares;
+};
@@ -1,7 +1,10 @@
 #include "Scene.h"
 
 #include <list>
+#include <stack>
 #include <cmath>
+#include <algorithm>
+#include <memory>
 #include <boost/filesystem.hpp>
 #include <png++/image.hpp>
 #include "png++/png.hpp"
@@ -19,6 +22,7 @@
 #include "BlinnPhongShader.h"
 #include "GlazeShader.h"
 #include "ThreadPool.h"
+#include "TaskGraph.h"
 #include "Cylinder.h"
 #include "PerlinShader.h"
 #include "BVHNode.h"
@@ -27,6 +31,19 @@
 #include "Mesh.h"
 #include "AreaLight.h"
 #include "Image.h"
+#include "PngStreamWriter.h"
+#include "ShadingTerms.h"
+#include "WavefrontRenderer.h"
+#include "ProgressiveRenderer.h"
+#include "DeferredRenderer.h"
+#include "JitteredSampler.h"
+#include "SobolSampler.h"
+#include "HaltonSampler.h"
+#include "BlueNoiseSampler.h"
+#include "RunningVariance.h"
+#include "RandomGenerator.h"
+#include "ShadingCache.h"
+#include "ShadowVisibility.h"
 
 /**
  * Converts degrees to radians.
@@ -100,6 +117,63 @@ void ReadDouble(map<string, SceneDataContainer> &map, string fieldName, double &
 }
 
 
+/**
+ * Hashes every value that was set in the given map, except for shader references, into the given hash.
+ * Used to tell whether the geometry or camera in a scene file has changed since a primary hit cache was written.
+ */
+uint64_t HashSceneData(map<string, SceneDataContainer> &map, uint64_t hash)
+{
+	std::map<string, SceneDataContainer>::const_iterator sdIter;
+	for (sdIter = map.begin(); sdIter != map.end(); sdIter++)
+	{
+		if (!sdIter->second.isSet || (sdIter->first == "shader_ref"))
+		{
+			continue;
+		}
+
+		hash = RandomGenerator::HashString(sdIter->first, hash);
+		hash = RandomGenerator::HashString(sdIter->second.val, hash);
+	}
+
+	return (hash);
+}
+
+
+/**
+ * This creator reads the properties set on the scene element itself.
+ */
+class ScenePropertiesCreator : public SceneElementCreator
+{
+public:
+	ScenePropertiesCreator(Scene *scene)
+	{
+		m_scene = scene;
+	}
+	~ScenePropertiesCreator() {}
+
+
+	void instance(std::map<std::string, SceneDataContainer> &sdMap)
+	{
+		// Light sampling is opt-in, so it is only turned on if the scene asks for it.
+		std::map<string, SceneDataContainer>::iterator lightSamples = sdMap.find("scene_lightsamples");
+		if ((lightSamples != sdMap.end()) && lightSamples->second.isSet)
+		{
+			double count;
+			ReadDouble(sdMap, "scene_lightsamples", count);
+			m_scene->LightSampleCount = max(0, (int)count);
+		}
+
+		if (m_scene->VerboseOutput)
+		{
+			cout << "Scene: lightSamples=" << m_scene->LightSampleCount << endl;
+		}
+	}
+
+private:
+	Scene *m_scene;
+};
+
+
 /**
  * This creator is used to create the camera.
  */
@@ -183,6 +257,7 @@ public:
 		}
 
 		m_scene->m_camera = new PerspectiveCamera(Ray(position, viewDir), focalLength, imagePlaneWidth, m_raysPerPixel);
+		m_scene->m_cameraHash = HashSceneData(sdMap, 0);
     }
 
 private:
@@ -336,7 +411,7 @@ public:
 			ReadDouble(sdMap, "shader_roughness", roughness);
 
 			// Add shader to list.
-			m_scene->m_shaders.insert(make_pair(name, new BlinnPhongShader(m_scene, diffuse, specular, phongExp, mirrorCoef, roughness)));
+			m_scene->m_shaders.insert(make_pair(name, BlinnPhongShader::Create(m_scene, diffuse, specular, phongExp, mirrorCoef, roughness)));
 
 			// Print parameters out if verbose.
 			if (m_scene->VerboseOutput)
@@ -372,7 +447,15 @@ public:
 		}
 		else if (type == "Perlin")
 		{
-			m_scene->m_shaders.insert(make_pair(name, new PerlinShader(m_scene)));
+			double noiseResolution = 0;
+			ReadDouble(sdMap, "shader_noiseResolution", noiseResolution);
+
+			m_scene->m_shaders.insert(make_pair(name, new PerlinShader(m_scene, (int)noiseResolution)));
+
+			if (m_scene->VerboseOutput && (noiseResolution > 0))
+			{
+				cout << "\tNoise Resolution=" << (int)noiseResolution << endl;
+			}
 		}
 		else
 		{
@@ -455,6 +538,9 @@ public:
 			cout << "Shape: name=" << name << ", type=" << type << endl;
 		}
 
+		// Anything about the shape can change what gets hit, except for its shader.
+		m_scene->m_geometryHash = HashSceneData(sdMap, RandomGenerator::Hash(m_scene->m_geometryHash, isInstanceable));
+
 		if (type == "instance")
 		{
 			std::string tname;
@@ -565,7 +651,21 @@ public:
 			IShader *shaderRef = ResolveShaderRef(name, shaderName);
 
 			// Load the object file relative to the location of the scene file.
-			toAdd = new Mesh(m_scene->m_sceneFileDirectory + filename, shaderRef);
+			// It may be loaded in the background, so make sure it is there now, while we can say which element it came from.
+			string path = m_scene->m_sceneFileDirectory + filename;
+			if (!boost::filesystem::is_regular_file(path))
+			{
+				throw EngineException("Mesh at \"" + path + "\" was unable to be read!");
+			}
+
+			// The mesh can change without the scene file changing.
+			uint64_t fileSize = boost::filesystem::file_size(path);
+			uint64_t fileTime = boost::filesystem::last_write_time(path);
+			m_scene->m_geometryHash = RandomGenerator::Hash(m_scene->m_geometryHash, fileSize, fileTime);
+
+			Mesh *mesh = new Mesh(path, shaderRef, m_scene->m_loader);
+			m_scene->m_loadingMeshes.push_back(mesh);
+			toAdd = mesh;
 		}
 		else if (type == "sphere")
 		{
@@ -685,11 +785,37 @@ private:
 };
 
 
-Scene::Scene(std::string filename, int raysPerPixel, bool useBvh, bool verbose)
+Scene::Scene(std::string filename, int raysPerPixel, bool useBvh, bool verbose, ThreadEngine::TaskGraph *loader)
 {
 	VerboseOutput = verbose;
+	RenderingMode = RENDER_RECURSIVE;
+	SamplingMethod = SAMPLER_SOBOL;
+	AdaptiveSampling = false;
+	AdaptiveMinSamples = 4;
+	AdaptiveThreshold = 0.01;
+	EdgeAwareSampling = false;
+	EdgeAngleThreshold = 20.0;
+	m_supersampledPixelCount = 0;
+	LightSampleCount = 0;
+	RouletteThreshold = 0.0;
+	DecoupledShading = false;
+	ShadingCellSize = -1.0;
+	TileSize = 16;
+	RenderTileOrder = TILE_ORDER_HILBERT;
+	ProgressiveRendering = false;
+	ProgressiveTimeBudget = 0.0;
+	CheckpointFileName = "";
+	CheckpointInterval = 0.0;
+	m_progressivePassCount = 0;
+	m_checkpointRequested = 0;
+	m_deferredRenderer = NULL;
+	m_geometryHash = useBvh;
+	m_cameraHash = 0;
 	m_ambient = Color(0.1, 0.1, 0.1);
 	m_camera = NULL;
+	m_sampler = NULL;
+	m_samplerType = SAMPLER_SOBOL;
+	m_loader = loader;
 
 	// Extract the path to the scene file for use in loading other included files like textures or meshes.
 	boost::filesystem::path pathToSceneFile(filename.c_str());
@@ -701,11 +827,13 @@ Scene::Scene(std::string filename, int raysPerPixel, bool useBvh, bool verbose)
 	}
 
 	// Register object creation handlers with the scene parser.
+	ScenePropertiesCreator scenePropertiesCreator(this);
 	CameraCreator cameraCreator(this, raysPerPixel);
 	ObjectCreator objectCreator(this);
 	LightCreator lightCreator(this);
 	ShaderCreator shaderCreator(this);
 	XMLSceneParser xmlScene;
+	xmlScene.registerCallback("sceneprops", &scenePropertiesCreator);
 	xmlScene.registerCallback("camera", &cameraCreator);
 	xmlScene.registerCallback("light", &lightCreator);
 	xmlScene.registerCallback("shader", &shaderCreator);
@@ -720,6 +848,25 @@ Scene::Scene(std::string filename, int raysPerPixel, bool useBvh, bool verbose)
 		throw EngineException("Camera not set!");
 	}
 
+	// Flatten the lights, so that shading does not have to go through ILight.
+	m_lightTable.resize(m_lights.size());
+	for (size_t i = 0; i < m_lights.size(); i++)
+	{
+		m_lightTable[i] = m_lights[i]->Compile();
+	}
+	m_lightSampler.Build(m_lightTable);
+
+	// Everything after this needs the meshes.  Any that failed to load throw here.
+	for (size_t i = 0; i < m_loadingMeshes.size(); i++)
+	{
+		m_loadingMeshes[i]->WaitUntilLoaded();
+	}
+	m_loadingMeshes.clear();
+	m_loader = NULL;
+
+	m_sceneObjects = m_objects;
+	BakeNoise();
+
 	// If they wanted to use a BVH, build it up.
 	if (useBvh)
 	{
@@ -737,6 +884,12 @@ Scene::~Scene()
 	delete m_camera;
 	m_camera = NULL;
 
+	delete m_sampler;
+	m_sampler = NULL;
+
+	delete m_deferredRenderer;
+	m_deferredRenderer = NULL;
+
 	// Delete all objects.
 	for (size_t i = 0; i < m_objects.size(); i++)
 	{
@@ -769,45 +922,154 @@ Scene::~Scene()
 }
 
 
-Color Scene::RaytracePixel(int x, int y)
+Color Scene::RaytracePixel(int x, int y, Color &sampleCountColor)
 {
-	// Calculate the rays we need to shoot for this pixel.
-	RayList rayList = m_camera->CalculateViewingRays(x, y);
-
-	int raysPerPixel = rayList.size();
+	// Calculate the rays we need to shoot for this pixel, and fill our intersection structure with samples.
+	RayList rayList;
+	PixelSampler samples;
+	GeneratePixelSamples(x, y, rayList, samples);
 
-	// Fill our intersection structure with samples.
 	Intersection intersect;
-	intersect.areaLightSamples.Generate(raysPerPixel);
+	intersect.samples = &samples;
+
+	// Decoupled shading lets the samples share the colors of hits that land close together.
+	ShadingCache shadingCache;
+	shadingCache.cellSize = ShadingCellSize;
+	ShadingCache *cache = (DecoupledShading && !HasStochasticLighting()) ? &shadingCache : NULL;
+	if ((cache != NULL) && (ShadingCellSize < 0.0))
+	{
+		// Size the cells from the angle between this pixel's center and the next one's.
+		Vector3D direction = m_camera->CalculateCenterRay(x, y).GetDirection();
+		Vector3D nextDirection = m_camera->CalculateCenterRay(x + 1, y).GetDirection();
+		direction.normalize();
+		nextDirection.normalize();
+		Vector3D step = nextDirection - direction;
+		shadingCache.pixelAngle = step.normalize();
+	}
+
+	int raysPerPixel = rayList.size();
+	int batchSize = GetSampleBatchSize(raysPerPixel);
 
 	Color finalColor;
-	for (int i = 0; i < raysPerPixel; i++)
+	RunningVariance luminance;
+	int rayIndex = 0;
+	while (rayIndex < raysPerPixel)
 	{
-		const Ray &ray = rayList[i];
-		// See if ray intersects any objects.
-		Color rayColor;
-		if (CastRayAndShade(ray, rayColor, intersect) == false)
-		{
-			// We hit nothing, add in the background color.
-			finalColor.AddColors(Color(0.0, 0.0, 0.0));
-		}
-		else
+		// Trace a batch of rays, then see if we have enough.
+		int batchEnd = min(raysPerPixel, rayIndex + batchSize);
+		for (; rayIndex < batchEnd; rayIndex++)
 		{
-			// We hit something.
+			const Ray &ray = rayList[rayIndex];
+			// See if ray intersects any objects.
+			Color rayColor;
+			if (CastRayAndShadeCached(ray, rayColor, intersect, cache) == false)
+			{
+				// We hit nothing, add in the background color.
+				rayColor = Color(0.0, 0.0, 0.0);
+			}
+
 			finalColor.AddColors(rayColor);
+			luminance.Add(rayColor.GetLuminance());
+
+			// Advance to the next sample.
+			samples.Next();
 		}
 
-		// Advance to the next sample.
-		intersect.areaLightSamples.Next();
+		if (IsPixelConverged(luminance))
+		{
+			break;
+		}
 	}
 
+	sampleCountColor = GetSampleCountColor(rayIndex, raysPerPixel);
+
 	// Take average of each ray's color.
-	finalColor.LinearMult(1.0/raysPerPixel);
+	finalColor.LinearMult(1.0/rayIndex);
 	return (finalColor);
 }
 
 
-void Scene::Render(Image &image, int threadCount)
+int Scene::GetSampleBatchSize(int maxSampleCount) const
+{
+	if (AdaptiveSampling)
+	{
+		return (max(1, AdaptiveMinSamples));
+	}
+
+	// Without adaptive sampling, every sample is taken in one go.
+	return (maxSampleCount);
+}
+
+
+bool Scene::IsPixelConverged(const RunningVariance& luminance) const
+{
+	if (!AdaptiveSampling || (luminance.GetCount() < AdaptiveMinSamples))
+	{
+		return (false);
+	}
+
+	return (luminance.GetConfidenceInterval() <= AdaptiveThreshold);
+}
+
+
+Color Scene::GetSampleCountColor(int sampleCount, int maxSampleCount)
+{
+	double fraction = (double)sampleCount / maxSampleCount;
+	return (Color(fraction, fraction, fraction));
+}
+
+
+void Scene::GeneratePixelSamples(int x, int y, RayList& rayList, PixelSampler& samples)
+{
+	rayList = m_camera->CalculateViewingRays(x, y, *m_sampler);
+	samples.Start(m_sampler, x, y, rayList.size());
+}
+
+
+Sample Scene::GetPathSample(const Intersection& intersection, SampleUse use) const
+{
+	if (intersection.samples == NULL)
+	{
+		throw EngineException("Intersection has no samples to shade with!");
+	}
+
+	int bounce = DEFAULT_REFLECTION_DEPTH - intersection.allowedReflectionCount;
+	return (intersection.samples->GetCurrentSample(GetSampleDimension(use, bounce)));
+}
+
+
+void Scene::PrepareSampler()
+{
+	if ((m_sampler != NULL) && (m_samplerType == SamplingMethod))
+	{
+		return;
+	}
+
+	delete m_sampler;
+	m_samplerType = SamplingMethod;
+
+	switch (SamplingMethod)
+	{
+	case SAMPLER_JITTERED:
+		m_sampler = new JitteredSampler();
+		break;
+	case SAMPLER_SOBOL:
+		m_sampler = new SobolSampler();
+		break;
+	case SAMPLER_HALTON:
+		m_sampler = new HaltonSampler();
+		break;
+	case SAMPLER_BLUE_NOISE:
+		m_sampler = new BlueNoiseSampler();
+		break;
+	default:
+		m_sampler = NULL;
+		throw EngineException("Unknown sampler type!");
+	}
+}
+
+
+void Scene::Render(Image &image, int threadCount, Image *sampleCounts)
 {
 	// See if we are guessing the number of threads.
 	if (threadCount <= 0)
@@ -815,35 +1077,267 @@ void Scene::Render(Image &image, int threadCount)
 		threadCount = ThreadEngine::ThreadPool::GetNumberOfProcessors();
 	}
 
-	if (threadCount == 1)
+	PrepareSampler();
+
+	if ((sampleCounts != NULL) && ((sampleCounts->GetWidth() != image.GetWidth()) || (sampleCounts->GetHeight() != image.GetHeight())))
+	{
+		throw EngineException("The sample count image has to be the same size as the image being rendered!");
+	}
+
+	// Only recursive rendering of whole pixels looks at the shading cache.
+	if (DecoupledShading && ((RenderingMode != RENDER_RECURSIVE) || ProgressiveRendering))
+	{
+		throw EngineException("Decoupled shading only works with recursive rendering, without progressive rendering!");
+	}
+
+	// Progressive passes are always traced recursively, one sample per pixel at a time, so anything else would be silently ignored.
+	if (ProgressiveRendering && ((RenderingMode != RENDER_RECURSIVE) || AdaptiveSampling || EdgeAwareSampling || (PrimaryHitCacheFileName != "")))
+	{
+		throw EngineException("Progressive rendering only works with recursive rendering, without adaptive or edge-aware sampling or a primary hit cache!");
+	}
+
+	if (ProgressiveRendering)
+	{
+		ProgressiveRenderer renderer(this);
+		renderer.Render(image, threadCount, sampleCounts);
+		m_progressivePassCount = renderer.GetPassCount();
+	}
+	else if (EdgeAwareSampling)
+	{
+		RenderEdgeAware(image, threadCount, sampleCounts);
+	}
+	else
+	{
+		RenderPixels(image, threadCount, sampleCounts, NULL);
+	}
+}
+
+
+void Scene::RenderPixels(Image &image, int threadCount, Image *sampleCounts, const vector<bool> *pixelMask)
+{
+	if (RenderingMode == RENDER_WAVEFRONT)
 	{
-		RenderSingleThreaded(image);
+		WavefrontRenderer renderer(this);
+		renderer.Render(image, threadCount, sampleCounts, pixelMask);
+	}
+	else if (RenderingMode == RENDER_DEFERRED)
+	{
+		// Every sample in the G-buffer is traced and shaded, so adaptive sampling would be silently ignored.
+		if (AdaptiveSampling)
+		{
+			throw EngineException("Deferred rendering can't be combined with adaptive sampling!");
+		}
+
+		if (m_deferredRenderer == NULL)
+		{
+			m_deferredRenderer = new DeferredRenderer(this);
+		}
+		m_deferredRenderer->Render(image, threadCount, sampleCounts, pixelMask);
+
+		if (VerboseOutput && m_deferredRenderer->WasReused())
+		{
+			cout << "Shaded the primary hits of the last render again, without tracing them." << endl;
+		}
+	}
+	else if (threadCount == 1)
+	{
+		RenderSingleThreaded(image, sampleCounts, pixelMask, NULL);
 	}
 	else
 	{
-		RenderMultiThreaded(image, threadCount);
+		RenderMultiThreaded(image, threadCount, sampleCounts, pixelMask, NULL);
 	}
 }
 
 
-void Scene::RenderSingleThreaded(Image &image)
+void Scene::RenderEdgeAware(Image &image, int threadCount, Image *sampleCounts)
 {
 	int imageWidth = image.GetWidth();
 	int imageHeight = image.GetHeight();
 
-	m_camera->SetImageDimensions(imageWidth, imageHeight);
+	// First pass: shoot a single ray through the center of every pixel, and remember what it hit.
+	vector<PixelHitInfo> centerHits(imageWidth * imageHeight);
+	if (threadCount == 1)
+	{
+		RenderSingleThreaded(image, sampleCounts, NULL, &centerHits);
+	}
+	else
+	{
+		RenderMultiThreaded(image, threadCount, sampleCounts, NULL, &centerHits);
+	}
 
-	// Get color values for each pixel.
-	for (int imageX = 0; imageX < imageWidth; imageX++)
+	// Find the pixels that hit something different than one of their neighbors.
+	vector<bool> edges(imageWidth * imageHeight, false);
+	double minimumCosine = cos(DEG_TO_RADS(EdgeAngleThreshold));
+	m_supersampledPixelCount = 0;
+	for (int y = 0; y < imageHeight; y++)
 	{
-		for (int imageY = 0; imageY < imageHeight; imageY++)
+		for (int x = 0; x < imageWidth; x++)
 		{
-			Color color = RaytracePixel(imageX, imageY);
+			int pixel = y * imageWidth + x;
+			const PixelHitInfo &hit = centerHits[pixel];
+			bool isEdge = hit.needsSamples;
+			if (x > 0)
+			{
+				isEdge = isEdge || IsEdgeBetween(hit, centerHits[pixel - 1], minimumCosine);
+			}
+			if (x < imageWidth - 1)
+			{
+				isEdge = isEdge || IsEdgeBetween(hit, centerHits[pixel + 1], minimumCosine);
+			}
+			if (y > 0)
+			{
+				isEdge = isEdge || IsEdgeBetween(hit, centerHits[pixel - imageWidth], minimumCosine);
+			}
+			if (y < imageHeight - 1)
+			{
+				isEdge = isEdge || IsEdgeBetween(hit, centerHits[pixel + imageWidth], minimumCosine);
+			}
 
-			// Save color to image structure.  Flip Y,  because we are rendering upside down.
-			image(imageX, imageHeight -1 - imageY) = color;
+			edges[pixel] = isEdge;
+			if (isEdge)
+			{
+				m_supersampledPixelCount++;
+			}
 		}
 	}
+
+	if (VerboseOutput)
+	{
+		cout << "Supersampling " << m_supersampledPixelCount << " of " << centerHits.size() << " pixels." << endl;
+	}
+
+	// Second pass: supersample the edges, overwriting their first pass colors.
+	RenderPixels(image, threadCount, sampleCounts, &edges);
+}
+
+
+bool Scene::IsEdgeBetween(const PixelHitInfo& a, const PixelHitInfo& b, double minimumCosine)
+{
+	if ((a.object != b.object) || (a.shader != b.shader))
+	{
+		return (true);
+	}
+
+	// Two pixels that both hit nothing are the same.
+	if (a.object == NULL)
+	{
+		return (false);
+	}
+
+	return (a.normal.dot(b.normal) < minimumCosine);
+}
+
+
+bool Scene::IsStochasticHit(Intersection& intersect) const
+{
+	// Picking lights at random is noisy whenever there is more than one to pick from.
+	if ((LightSampleCount > 0) && (m_lights.size() > 1))
+	{
+		return (true);
+	}
+
+	// Shaders that can't be broken down might do anything, so assume the worst.
+	ShadingTerms terms;
+	Intersection copy = intersect;
+	if (intersect.object->GetShader()->Decompose(copy, terms) == false)
+	{
+		return (true);
+	}
+
+	// Glossy reflections are noisy, and so is any reflection once paths can be stopped at random.
+	if (terms.reflects && ((terms.roughness > 0.0) || (RouletteThreshold > 0.0)))
+	{
+		return (true);
+	}
+
+	// So are the soft shadows of area lights.
+	for (size_t i = 0; i < terms.lights.size(); i++)
+	{
+		if (terms.lights[i].light->type == LIGHT_AREA)
+		{
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+
+bool Scene::HasStochasticLighting() const
+{
+	if ((LightSampleCount > 0) && (m_lights.size() > 1))
+	{
+		return (true);
+	}
+
+	for (size_t i = 0; i < m_lightTable.size(); i++)
+	{
+		if (m_lightTable[i].type == LIGHT_AREA)
+		{
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+
+int Scene::GetSupersampledPixelCount() const
+{
+	return (m_supersampledPixelCount);
+}
+
+
+void Scene::RequestCheckpoint()
+{
+	m_checkpointRequested = 1;
+}
+
+
+int Scene::GetProgressivePassCount() const
+{
+	return (m_progressivePassCount);
+}
+
+
+void Scene::InvalidatePrimaryHits()
+{
+	if (m_deferredRenderer != NULL)
+	{
+		m_deferredRenderer->Invalidate();
+	}
+}
+
+
+Color Scene::RaytracePixelCenter(int x, int y, PixelHitInfo& hitInfo, Color& sampleCountColor)
+{
+	Ray ray = m_camera->CalculateCenterRay(x, y);
+
+	// Area lights and glossy reflections get the first sample.
+	PixelSampler samples;
+	samples.Start(m_sampler, x, y, 1);
+
+	Intersection intersect;
+	intersect.samples = &samples;
+
+	Color color;
+	hitInfo.object = NULL;
+	hitInfo.shader = NULL;
+	hitInfo.needsSamples = false;
+	if (CastRay(ray, intersect))
+	{
+		hitInfo.object = intersect.object;
+		hitInfo.shader = intersect.object->GetShader();
+		hitInfo.normal = intersect.surfaceNormal;
+		hitInfo.normal.normalize();
+		hitInfo.needsSamples = IsStochasticHit(intersect);
+
+		color = ShadeIntersection(intersect);
+	}
+
+	sampleCountColor = GetSampleCountColor(1, m_camera->GetSamplesPerPixel());
+	return (color);
 }
 
 
@@ -862,15 +1356,36 @@ struct RenderingThreadInfo
 	 */
 	Image *outputImage;
 
+	/**
+	 * The image the sample counts will be written to.  Can be NULL.
+	 */
+	Image *sampleCountImage;
+
+	/**
+	 * If not NULL, only the pixels that are true are rendered.  Indexed by y * width + x, where y is not flipped.
+	 */
+	const vector<bool> *pixelMask;
+
+	/**
+	 * If not NULL, only a single ray is shot through the center of each pixel, and what it hit is saved here.
+	 * Indexed the same way as pixelMask.
+	 */
+	vector<PixelHitInfo> *centerHits;
+
 	/**
 	 * The dimensions of the rectangle required to be rendered by the thread.
 	 */
 	int startX, startY, width, height;
 
 	/**
-	 * The final image height.  Used to flip the image upside down when writing pixels.
+	 * The final image dimensions.  The height is used to flip the image upside down when writing pixels.
 	 */
-	int finalImageHeight;
+	int finalImageWidth, finalImageHeight;
+
+	/**
+	 * The row of the final image that the first row of the output images is.  Nonzero when rendering a band.
+	 */
+	int outputTop;
 };
 
 
@@ -885,15 +1400,35 @@ void *RenderThread(void *info)
 	int endX = threadInfo->width + threadInfo->startX;
 	int endY = threadInfo->height + threadInfo->startY;
 
-	// Get color values for each pixel we have been assigned to render.
-	for (int imageX = threadInfo->startX; imageX < endX; imageX++)
+	// Get color values for each pixel we have been assigned to render, a row at a time.
+	for (int imageY = threadInfo->startY; imageY < endY; imageY++)
 	{
-		for (int imageY = threadInfo->startY; imageY < endY; imageY++)
+		for (int imageX = threadInfo->startX; imageX < endX; imageX++)
 		{
-			Color color = threadInfo->scene->RaytracePixel(imageX, imageY);
+			int pixel = imageY * threadInfo->finalImageWidth + imageX;
+			if ((threadInfo->pixelMask != NULL) && !(*threadInfo->pixelMask)[pixel])
+			{
+				continue;
+			}
+
+			Color sampleCountColor;
+			Color color;
+			if (threadInfo->centerHits != NULL)
+			{
+				color = threadInfo->scene->RaytracePixelCenter(imageX, imageY, (*threadInfo->centerHits)[pixel], sampleCountColor);
+			}
+			else
+			{
+				color = threadInfo->scene->RaytracePixel(imageX, imageY, sampleCountColor);
+			}
 
 			// Save color to PNG structure.  Flip Y,  because we are rendering upside down.
-			threadInfo->outputImage->operator()(imageX, threadInfo->finalImageHeight -1 - imageY) = color;
+			int outputY = threadInfo->finalImageHeight - 1 - imageY - threadInfo->outputTop;
+			threadInfo->outputImage->SetPixel(imageX, outputY, color);
+			if (threadInfo->sampleCountImage != NULL)
+			{
+				threadInfo->sampleCountImage->SetPixel(imageX, outputY, sampleCountColor);
+			}
 		}
 	}
 
@@ -901,7 +1436,49 @@ void *RenderThread(void *info)
 }
 
 
-void Scene::RenderMultiThreaded(Image &image, int threadCount)
+/**
+ * Renders a single tile.
+ * @param context Pointer to a RenderingThreadInfo structure with everything but the rectangle to render filled in.
+ */
+static void RenderTile(const Tile &tile, void *context)
+{
+	RenderingThreadInfo renderInfo = *(RenderingThreadInfo*)context;
+	renderInfo.startX = tile.x;
+	renderInfo.startY = tile.y;
+	renderInfo.width = tile.width;
+	renderInfo.height = tile.height;
+
+	RenderThread(&renderInfo);
+}
+
+
+void Scene::RenderSingleThreaded(Image &image, Image *sampleCounts, const vector<bool> *pixelMask, vector<PixelHitInfo> *centerHits)
+{
+	int imageWidth = image.GetWidth();
+	int imageHeight = image.GetHeight();
+
+	m_camera->SetImageDimensions(imageWidth, imageHeight);
+
+	// Render the whole image as one chunk.
+	RenderingThreadInfo renderInfo;
+	renderInfo.startX = 0;
+	renderInfo.startY = 0;
+	renderInfo.width = imageWidth;
+	renderInfo.height = imageHeight;
+	renderInfo.finalImageWidth = imageWidth;
+	renderInfo.finalImageHeight = imageHeight;
+	renderInfo.outputTop = 0;
+	renderInfo.scene = this;
+	renderInfo.outputImage = &image;
+	renderInfo.sampleCountImage = sampleCounts;
+	renderInfo.pixelMask = pixelMask;
+	renderInfo.centerHits = centerHits;
+
+	RenderThread(&renderInfo);
+}
+
+
+void Scene::RenderMultiThreaded(Image &image, int threadCount, Image *sampleCounts, const vector<bool> *pixelMask, vector<PixelHitInfo> *centerHits)
 {
 	int imageWidth = image.GetWidth();
 	int imageHeight = image.GetHeight();
@@ -909,40 +1486,115 @@ void Scene::RenderMultiThreaded(Image &image, int threadCount)
 	// Tell the camera how big the image is.
 	m_camera->SetImageDimensions(imageWidth, imageHeight);
 
-	// The thread pool we will be using to render the scene.
-	ThreadEngine::ThreadPool renderPool(threadCount);
+	// Everything each tile needs, except for where the tile is.
+	RenderingThreadInfo renderInfo;
+	renderInfo.finalImageWidth = imageWidth;
+	renderInfo.finalImageHeight = imageHeight;
+	renderInfo.outputTop = 0;
+	renderInfo.scene = this;
+	renderInfo.outputImage = &image;
+	renderInfo.sampleCountImage = sampleCounts;
+	renderInfo.pixelMask = pixelMask;
+	renderInfo.centerHits = centerHits;
+
+	Tile area = { 0, 0, imageWidth, imageHeight };
+	RenderTiles(area, renderInfo, threadCount);
+}
 
-	// Start pool so that jobs will be started immediately on adding them.
-	renderPool.StartProcessing();
 
-	// The list of job information for each image chunk.
-	RenderingThreadInfo *threadInfoList = new RenderingThreadInfo[imageHeight];
+void Scene::RenderTiles(const Tile &area, RenderingThreadInfo &renderInfo, int threadCount)
+{
+	// Divide the area up into tiles, and let the threads share them out.
+	TileScheduler scheduler(area, TileSize, RenderTileOrder);
+	scheduler.Run(RenderTile, &renderInfo, threadCount);
 
-	// Divide screen up into chunks.
-	for (int y = 0; y < imageHeight; y++)
+	if (VerboseOutput)
 	{
-		RenderingThreadInfo &renderInfo = threadInfoList[y];
-		renderInfo.startX = 0;
-		renderInfo.startY = y;
-		renderInfo.width = imageWidth;
-		renderInfo.height = 1;
-		renderInfo.finalImageHeight = imageHeight;
-		renderInfo.scene = this;
-		renderInfo.outputImage = &image;
+		cout << "Rendered " << scheduler.GetTiles().size() << " tiles, " << scheduler.GetStealCount() << " of them stolen." << endl;
+	}
+}
+
+
+void Scene::RenderBand(Image &band, int threadCount, int bandTop, int imageHeight)
+{
+	int bandHeight = band.GetHeight();
+
+	RenderingThreadInfo renderInfo;
+	renderInfo.finalImageWidth = band.GetWidth();
+	renderInfo.finalImageHeight = imageHeight;
+	renderInfo.outputTop = bandTop;
+	renderInfo.scene = this;
+	renderInfo.outputImage = &band;
+	renderInfo.sampleCountImage = NULL;
+	renderInfo.pixelMask = NULL;
+	renderInfo.centerHits = NULL;
+
+	// The image is rendered upside down, so the band is the rows of the camera counting up from imageHeight - bandTop.
+	Tile area = { 0, imageHeight - bandTop - bandHeight, band.GetWidth(), bandHeight };
+	RenderTiles(area, renderInfo, threadCount);
+}
 
-		// Add a job to the pool for each chunk.
-		renderPool.AddJob(RenderThread, &threadInfoList[y]);
+
+void Scene::RenderBands(PngStreamWriter &writer, int threadCount, int bandHeight)
+{
+	if (threadCount <= 0)
+	{
+		threadCount = ThreadEngine::ThreadPool::GetNumberOfProcessors();
 	}
 
-	// Wait for all jobs to be completed.
-	renderPool.JoinAll();
+	if ((RenderingMode != RENDER_RECURSIVE) || ProgressiveRendering || EdgeAwareSampling)
+	{
+		throw EngineException("Rendering in bands only works with recursive rendering, without progressive rendering or edge-aware sampling!");
+	}
+	if (bandHeight <= 0)
+	{
+		throw EngineException("Bands have to be at least one row tall!");
+	}
+
+	PrepareSampler();
+
+	int imageWidth = writer.GetWidth();
+	int imageHeight = writer.GetHeight();
+	m_camera->SetImageDimensions(imageWidth, imageHeight);
+
+	// Each band is compressed and written by a task while the next one renders.  With two bands to switch between,
+	// rendering only has to wait when the writing falls more than a band behind.  The graph is declared after the bands,
+	// so that if rendering throws, the writes are finished before the bands go away.
+	const int BAND_BUFFERS = 2;
+	unique_ptr<Image> bands[BAND_BUFFERS];
+	ThreadEngine::TaskHandle writes[BAND_BUFFERS];
+	ThreadEngine::TaskHandle lastWrite;
+	ThreadEngine::TaskGraph writerGraph(1);
+
+	int bandIndex = 0;
+	for (int bandTop = writer.GetRowsWritten(); bandTop < imageHeight; bandTop += bandHeight)
+	{
+		int buffer = bandIndex % BAND_BUFFERS;
+		if (writes[buffer] != NULL)
+		{
+			writes[buffer]->Wait();
+		}
+
+		bands[buffer].reset(new Image(imageWidth, min(bandHeight, imageHeight - bandTop)));
+		Image *band = bands[buffer].get();
+		RenderBand(*band, threadCount, bandTop, imageHeight);
+
+		// The bands have to go out in order.
+		writes[buffer] = writerGraph.Add([&writer, band]() { writer.WriteRows(*band); }, vector<ThreadEngine::TaskHandle>(1, lastWrite));
+		lastWrite = writes[buffer];
+		bandIndex++;
+	}
+
+	if (lastWrite != NULL)
+	{
+		lastWrite->Wait();
+	}
 
-	// Free list of renderinfos.
-	delete[] threadInfoList;
+	writer.Finish();
 }
 
 
-inline bool Scene::CastRayAndShade(const Ray& ray, Color& result, Intersection &intersect, double maxT, int allowedReflectionCount)
+bool Scene::CastRayAndShade(const Ray& ray, Color& result, Intersection &intersect, double maxT, int allowedReflectionCount)
 {
 	if (CastRay(ray, intersect, maxT) == true)
 	{
@@ -956,33 +1608,61 @@ inline bool Scene::CastRayAndShade(const Ray& ray, Color& result, Intersection &
 }
 
 
-bool Scene::CastShadowRay(ILight* light, Intersection &intersection)
+bool Scene::CastRayAndShadeCached(const Ray& ray, Color& result, Intersection& intersect, ShadingCache *cache)
 {
-	Vector3D intersectPoint = intersection.collidedRay.GetPositionAtTime(intersection.t);
+	if (cache == NULL)
+	{
+		return (CastRayAndShade(ray, result, intersect));
+	}
 
-	// If this is an area light, we need to sample it at the right spot.
-	Vector3D lightPos;
-	AreaLight *areaLight = dynamic_cast<AreaLight*>(light);
-	if (areaLight != NULL)
+	if (CastRay(ray, intersect) == false)
 	{
-		// Grab the sample of the light that we want.
-		lightPos = areaLight->GetPosition(intersection.areaLightSamples.GetCurrentSample());
+		return (false);
 	}
-	else
+
+	if (!intersect.object->GetShader()->IsViewIndependent())
 	{
-		// This is a regular light.
-		lightPos = light->GetPosition();
+		result = ShadeIntersection(intersect);
+		return (true);
 	}
 
+	Vector3D point = intersect.collidedRay.GetPositionAtTime(intersect.t);
+	Vector3D toPoint = point - ray.GetPosition();
+	double distance = toPoint.normalize();
+	ShadingCache::Key key = cache->MakeKey(intersect.object, intersect.primitive, point, distance);
+	if (!cache->Find(key, result))
+	{
+		result = ShadeIntersection(intersect);
+		cache->Add(key, result);
+	}
+
+	return (true);
+}
+
+
+bool Scene::CastShadowRay(const LightRecord& light, Intersection &intersection)
+{
+	Vector3D intersectPoint = intersection.collidedRay.GetPositionAtTime(intersection.t);
+	Ray shadowRay = GetShadowRay(light, intersectPoint, GetPathSample(intersection, SAMPLE_AREA_LIGHT));
+
+	// Cast ray into scene with max t of 1.0, so that objects beyond the light are not taken into account.
+	HitRecord unused;
+	return (CastRay(shadowRay, unused, 1.0));
+}
+
+
+Ray Scene::GetShadowRay(const LightRecord& light, const Vector3D &point, const Sample &sample)
+{
+	// Area lights get sampled at the right spot, and point lights ignore the sample.
+	Vector3D lightPos = light.GetSamplePosition(sample);
+
 	// Construct ray from the intersection point to the light.
-	Ray shadowRay(intersectPoint, lightPos - intersectPoint);
+	Ray shadowRay(point, lightPos - point);
 
 	// Step ray towards light by a small amount to overcome numerical inaccuracy.
 	shadowRay.SetPosition(shadowRay.GetPositionAtTime(EPSILON));
 
-	// Cast ray into scene with max t of 1.0, so that objects beyond the light are not taken into account.
-	Intersection unused;
-	return (CastRay(shadowRay, unused, 1.0));
+	return (shadowRay);
 }
 
 
@@ -991,11 +1671,22 @@ Color Scene::CastReflectionRay(Intersection& intersection, double roughness)
 	// Terminate if we have bounced around too much.
 	if (intersection.allowedReflectionCount <= 0)
 	{
-		return (Color(0.5, 0.5, 0.5));
+		return (GetReflectionLimitColor());
 	}
 
+	// Use the sample from the bounce we are reflecting off of.
+	Ray reflectedRay = GetReflectionRay(intersection, roughness, GetPathSample(intersection, SAMPLE_GLOSS));
+
 	intersection.allowedReflectionCount--;
 
+	Color rayColor;
+	CastRayAndShade(reflectedRay, rayColor, intersection, numeric_limits<double>::max(), intersection.allowedReflectionCount);
+	return (rayColor);
+}
+
+
+Ray Scene::GetReflectionRay(const Intersection& intersection, double roughness, const Sample &sample)
+{
 	// Calculate the ray we need to shoot for the reflection.
 	Vector3D intersectPoint = intersection.collidedRay.GetPositionAtTime(intersection.t);
 	const Vector3D &normal = intersection.surfaceNormal;
@@ -1010,7 +1701,6 @@ Color Scene::CastReflectionRay(Intersection& intersection, double roughness)
 		reflectedBasis.Calculate(rayDirection);
 
 		// Compute perturbed direction.
-		Sample sample = intersection.areaLightSamples.GetCurrentSample();
 		double u = -roughness/2.0 + sample.second*roughness;
 		double v = -roughness/2.0 + sample.first*roughness;
 		rayDirection = rayDirection + u*reflectedBasis.GetU() + v*reflectedBasis.GetV();
@@ -1021,40 +1711,183 @@ Color Scene::CastReflectionRay(Intersection& intersection, double roughness)
 	// Step reflectedRay out of any object it may be inside of.
 	reflectedRay.SetPosition(reflectedRay.GetPositionAtTime(EPSILON));
 
-	Color rayColor;
-	CastRayAndShade(reflectedRay, rayColor, intersection, numeric_limits<double>::max(), intersection.allowedReflectionCount);
-	return (rayColor);
+	return (reflectedRay);
+}
+
+
+Color Scene::ResolveShadingTerms(Intersection& intersection, const ShadingTerms& terms)
+{
+	Color result = ResolveLightTerms(intersection, terms);
+
+	// The reflection goes last, since casting it overwrites the intersection.
+	if (terms.reflects)
+	{
+		Color reflectedColor = CastReflectionRay(intersection, terms.roughness);
+		reflectedColor.MultiplyColors(terms.reflectance);
+		result.AddColors(reflectedColor);
+	}
+
+	return (result);
+}
+
+
+Color Scene::ResolveLightTerms(Intersection& intersection, const ShadingTerms& terms, ShadowVisibility *visibility)
+{
+	Color result = terms.base;
+
+	// Each light only contributes if we are not in its shadow.
+	for (size_t i = 0; i < terms.lights.size(); i++)
+	{
+		const LightTerm &term = terms.lights[i];
+
+		bool visible;
+		int lightIndex = term.light - &m_lightTable[0];
+		if ((visibility == NULL) || !visibility->Find(lightIndex, visible))
+		{
+			visible = (CastShadowRay(*term.light, intersection) == false);
+			if (visibility != NULL)
+			{
+				visibility->Add(lightIndex, visible);
+			}
+		}
+
+		if (visible)
+		{
+			result.AddColors(term.contribution);
+		}
+	}
+
+	return (result);
+}
+
+
+void Scene::BakeNoise()
+{
+	// Find the bounds of everything that uses each shader that wants its noise baked.
+	map<PerlinShader*, BBox> bounds;
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		PerlinShader *shader = dynamic_cast<PerlinShader*>(m_objects[i]->GetShader());
+		if ((shader == NULL) || (shader->GetNoiseResolution() <= 0))
+		{
+			continue;
+		}
+
+		BBox objectBounds = m_objects[i]->GetBoundingBox();
+		map<PerlinShader*, BBox>::iterator existing = bounds.find(shader);
+		if (existing == bounds.end())
+		{
+			bounds.insert(make_pair(shader, objectBounds));
+		}
+		else
+		{
+			existing->second = BBox::Combine(existing->second, objectBounds);
+		}
+	}
+
+	for (map<PerlinShader*, BBox>::iterator iter = bounds.begin(); iter != bounds.end(); iter++)
+	{
+		if (VerboseOutput)
+		{
+			int resolution = iter->first->GetNoiseResolution();
+			cout << "Baking " << resolution << "x" << resolution << "x" << resolution << " noise volume from "
+				<< iter->second.minPt << " to " << iter->second.maxPt << endl;
+		}
+
+		iter->first->BakeNoise(iter->second);
+	}
+}
+
+
+uint64_t Scene::GetLightGeometryHash() const
+{
+	uint64_t hash = m_lightTable.size();
+	for (size_t i = 0; i < m_lightTable.size(); i++)
+	{
+		const LightRecord &light = m_lightTable[i];
+		double shape[] = { light.position[0], light.position[1], light.position[2],
+			light.uAxis[0], light.uAxis[1], light.uAxis[2], light.vAxis[0], light.vAxis[1], light.vAxis[2], light.width, light.height };
+
+		hash = RandomGenerator::HashBytes(shape, sizeof(shape), RandomGenerator::Hash(hash, light.type));
+	}
+
+	return (hash);
+}
+
+
+Color Scene::GetReflectionLimitColor()
+{
+	return (Color(0.5, 0.5, 0.5));
+}
+
+
+bool Scene::ContinuePath(Color& throughput, const Sample& sample) const
+{
+	if (RouletteThreshold <= 0.0)
+	{
+		return (true);
+	}
+
+	double strength = max(throughput.GetRed(), max(throughput.GetGreen(), throughput.GetBlue()));
+	if (strength >= RouletteThreshold)
+	{
+		return (true);
+	}
+
+	// Keep the path with a chance proportional to how much it can still add, and make up for the paths that were stopped.
+	double survival = strength / RouletteThreshold;
+	if (sample.first >= survival)
+	{
+		return (false);
+	}
+
+	throughput.LinearMult(1.0 / survival);
+	return (true);
 }
 
 
 bool Scene::CastRay(const Ray& ray, Intersection &result, double maxT)
 {
-	// Ensure that any in-data (like area light samples) doesn't get wiped.
-	JitteredSampler areaLightSamples = result.areaLightSamples;
+	HitRecord hit;
+	if (CastRay(ray, hit, maxT) == false)
+	{
+		// No intersection.
+		return (false);
+	}
 
-	Intersection closestIntersect;
-	closestIntersect.t = maxT;
+	// We had an intersection, fill in everything the shaders need.
+	// Anything that came in with the result (like the path's samples) is left alone.
+	result.collidedRay = ray;
+	result.t = hit.t;
+	result.object = hit.object;
+	result.primitive = hit.primitive;
+	result.surfaceNormal = hit.object->GetNormal(ray, hit);
+
+	return (true);
+}
+
+
+bool Scene::CastRay(const Ray& ray, HitRecord &hit, double maxT)
+{
+	HitRecord closestHit;
+	closestHit.t = maxT;
 	for (size_t i = 0; i < m_objects.size(); i++)
 	{
-		Intersection currentIntersect;
-		if (m_objects.at(i)->Intersect(ray, currentIntersect) == true)
+		HitRecord currentHit;
+		if (m_objects[i]->Intersect(ray, currentHit) == true)
 		{
 			// If this intersection is closer to the camera, and in front of it, this intersection is the one we care about.
-			if ((currentIntersect.t < closestIntersect.t) && (currentIntersect.t > 0))
+			if ((currentHit.t < closestHit.t) && (currentHit.t > 0))
 			{
-				closestIntersect = currentIntersect;
+				closestHit = currentHit;
 			}
 		}
 	}
 
-	if (closestIntersect.t != maxT)
+	if (closestHit.t != maxT)
 	{
 		// We had an intersection.
-		result = closestIntersect;
-
-		// Copy in-data back into result.
-		result.areaLightSamples = areaLightSamples;
-
+		hit = closestHit;
 		return (true);
 	}
 	else
@@ -1065,12 +1898,65 @@ bool Scene::CastRay(const Ray& ray, Intersection &result, double maxT)
 }
 
 
-inline Color Scene::ShadeIntersection(Intersection& data, int allowedReflectionCount)
+Color Scene::ShadeIntersection(Intersection& data, int allowedReflectionCount, ShadowVisibility *visibility)
 {
-	// Invoke the object's shader.
-	// Set the intersection data's reflection count.
-	data.allowedReflectionCount = allowedReflectionCount;
-	return (data.object->GetShader()->Shade(data));
+	Color result;
+	Color throughput(1.0, 1.0, 1.0);
+	ShadingTerms terms;
+	while (true)
+	{
+		// Set the intersection data's reflection count, since the shader's samples depend on it.
+		data.allowedReflectionCount = allowedReflectionCount;
+		IShader *shader = data.object->GetShader();
+
+		terms.Clear();
+		if (shader->Decompose(data, terms) == false)
+		{
+			// This shader has to trace its own rays.
+			Color color = shader->Shade(data);
+			color.MultiplyColors(throughput);
+			result.AddColors(color);
+			break;
+		}
+
+		// Only the first hit's shadows are in the visibility.
+		Color color = ResolveLightTerms(data, terms, visibility);
+		visibility = NULL;
+		color.MultiplyColors(throughput);
+		result.AddColors(color);
+
+		if (!terms.reflects)
+		{
+			break;
+		}
+
+		// Everything further along the path gets multiplied by this surface's reflectance.
+		throughput.MultiplyColors(terms.reflectance);
+
+		if (allowedReflectionCount <= 0)
+		{
+			// We have bounced around too much.
+			Color limitColor = GetReflectionLimitColor();
+			limitColor.MultiplyColors(throughput);
+			result.AddColors(limitColor);
+			break;
+		}
+
+		if ((RouletteThreshold > 0.0) && !ContinuePath(throughput, GetPathSample(data, SAMPLE_ROULETTE)))
+		{
+			break;
+		}
+
+		// Follow the reflection.  Rays that hit nothing add the background color, which is black.
+		Ray reflectedRay = GetReflectionRay(data, terms.roughness, GetPathSample(data, SAMPLE_GLOSS));
+		allowedReflectionCount--;
+		if (CastRay(reflectedRay, data) == false)
+		{
+			break;
+		}
+	}
+
+	return (result);
 }
 
 
@@ -1086,8 +1972,54 @@ LightList::const_iterator Scene::GetLightsEnd() const
 }
 
 
+void Scene::SelectLights(const Intersection& intersection, LightChoiceList& choices) const
+{
+	choices.clear();
+
+	if ((LightSampleCount <= 0) || (m_lightSampler.GetLightCount() == 0))
+	{
+		// Every light counts fully.
+		for (size_t i = 0; i < m_lightTable.size(); i++)
+		{
+			LightChoice choice;
+			choice.light = &m_lightTable[i];
+			choice.weight = 1.0;
+			choices.push_back(choice);
+		}
+		return;
+	}
+
+	// Stratify the picks, so that they spread out over the lights.
+	Sample sample = GetPathSample(intersection, SAMPLE_LIGHT_SELECT);
+	for (int i = 0; i < LightSampleCount; i++)
+	{
+		double probability;
+		LightChoice choice;
+		choice.light = m_lightSampler.Pick((sample.first + i) / LightSampleCount, probability);
+
+		// Lights that can't be picked don't give off any light anyway.
+		if (probability > 0.0)
+		{
+			choice.weight = 1.0 / (LightSampleCount * probability);
+			choices.push_back(choice);
+		}
+	}
+}
+
+
 const Color& Scene::GetAmbient() const
 {
 	return (m_ambient);
 }
 
+
+int Scene::GetAmbientCount() const
+{
+	if ((LightSampleCount > 0) && (m_lightSampler.GetLightCount() > 0))
+	{
+		return (1);
+	}
+
+	return ((int)m_lightTable.size());
+}
+
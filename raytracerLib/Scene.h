@@ -4,20 +4,50 @@
 #include <vector>
 #include <map>
 #include <cfloat>
+#include <csignal>
+#include <stdint.h>
 
 #include "ICamera.h"
 #include "IObject.h"
 #include "IShader.h"
 #include "ILight.h"
+#include "ISampler.h"
+#include "PixelSampler.h"
 #include "EngineException.h"
+#include "LightSampler.h"
+#include "TileScheduler.h"
 
 class Image;
+class Mesh;
+class PngStreamWriter;
+class RunningVariance;
+class DeferredRenderer;
+struct PixelHitInfo;
+struct RenderingThreadInfo;
+struct ShadingTerms;
+struct ShadowVisibility;
+struct ShadingCache;
+namespace ThreadEngine
+{
+class TaskGraph;
+}
 typedef std::map<std::string, IShader*> ShaderMap;
 typedef std::map<std::string, IObject*> InstanceableMap;
 typedef std::vector<IObject*> ObjectList;
 typedef std::vector<ILight*> LightList;
 
 
+/**
+ * A light that a shading point takes into account, and what the light's contribution gets multiplied by.
+ */
+struct LightChoice
+{
+	const LightRecord *light;
+	double weight;
+};
+typedef std::vector<LightChoice> LightChoiceList;
+
+
 /**
  * A small value that is useful for comparing doubles.
  */
@@ -29,6 +59,57 @@ const double EPSILON = 0.00005;
 #define EQUAL(a, b) (fabs((a) - (b)) < EPSILON)
 
 
+/**
+ * The different ways a scene can be rendered.
+ */
+enum RenderMode
+{
+	/**
+	 * Each pixel's rays are traced and shaded recursively, one at a time.
+	 */
+	RENDER_RECURSIVE,
+
+	/**
+	 * Rays are traced in large batches per tile, and shaded in batches grouped by shader.
+	 */
+	RENDER_WAVEFRONT,
+
+	/**
+	 * Every primary ray in the image is traced into a G-buffer, which is then shaded in batches grouped by shader.
+	 * The G-buffer is kept, so rendering again after changing only lights or shaders does not trace primary rays again.
+	 * Every sample is taken, so Scene::Render() throws if AdaptiveSampling is on.
+	 */
+	RENDER_DEFERRED
+};
+
+
+/**
+ * The different patterns that pixels can be sampled with.
+ */
+enum SamplerType
+{
+	/**
+	 * Correlated multi-jittered samples.
+	 */
+	SAMPLER_JITTERED,
+
+	/**
+	 * Owen scrambled Sobol samples.
+	 */
+	SAMPLER_SOBOL,
+
+	/**
+	 * Scrambled Halton samples.
+	 */
+	SAMPLER_HALTON,
+
+	/**
+	 * Sobol samples offset by a tiled blue noise table.
+	 */
+	SAMPLER_BLUE_NOISE
+};
+
+
 /**
  * Represents the entirety of a scene.
  * Is also responsible for loading and rendering a scene.
@@ -39,12 +120,13 @@ public:
 	/**
 	 * Loads a scene from the given XML file.
 	 * @param filename The filename to load from.
-	 * @param raysPerPixel The number of rays per pixel.  Must be a perfect square.
+	 * @param raysPerPixel The number of rays per pixel.  Must be positive.
 	 * @param useBvh Set to true to use a BVH structure.
 	 * @param verbose Set to true if you want lots of information printed out during scene loading.
+	 * @param loader If not NULL, meshes are read and have their BVHs built by tasks on the graph, while the rest of the file is parsed.
 	 * @throws RaytraceException If something goes wrong.
 	 */
-	Scene(std::string filename, int raysPerPixel, bool useBvh, bool verbose);
+	Scene(std::string filename, int raysPerPixel, bool useBvh, bool verbose, ThreadEngine::TaskGraph *loader = NULL);
 
 	/**
 	 * Frees all memory associated with the scene.
@@ -55,9 +137,22 @@ public:
 	 * Renders the scene, generating a png file with the given name.
 	 * @param image The image to render to.
 	 * @param threadCount The number of threads to use when rendering the image.  Set to -1 to guess at the number that would be most effecient.
+	 * @param sampleCounts If not NULL, each pixel is set to the number of samples taken in it, as a grey level where white is the maximum.
+	 *                     Must be the same size as the image.
 	 * @throws RaytraceException If something goes wrong.
 	 */
-	void Render(Image &image, int threadCount);
+	void Render(Image &image, int threadCount, Image *sampleCounts = NULL);
+
+	/**
+	 * Renders the scene a band of rows at a time, from the top of the image down, writing each band out while the next one renders,
+	 * so that only two bands are ever in memory.  Finishes the png once the last band is written.
+	 * Only works with RENDER_RECURSIVE, and without progressive rendering or edge-aware sampling, which all need the whole image.
+	 * @param writer The png to write to.  The image rendered is the size of the png.
+	 * @param threadCount The number of threads to use when rendering each band.  Set to -1 to guess.
+	 * @param bandHeight The number of rows in each band.
+	 * @throws EngineException If the scene is not set up to render this way, or the png can't be written.
+	 */
+	void RenderBands(PngStreamWriter &writer, int threadCount, int bandHeight);
 
 	/**
 	 * Casts the given ray in the scene.
@@ -67,12 +162,25 @@ public:
 	 */
 	bool CastRay(const Ray &ray, Intersection &result, double maxT = DBL_MAX);
 
+	/**
+	 * Casts the given ray in the scene, without working out anything needed to shade the hit.
+	 * Use this when only the closest hit matters, such as for shadow rays.
+	 * @param ray The ray to cast through the scene.
+	 * @param hit If the ray collided with something, this will be set to the closest hit.
+	 * @param maxT Hits at or beyond this time are ignored.
+	 * @return True if the ray hit something.
+	 */
+	bool CastRay(const Ray &ray, HitRecord &hit, double maxT = DBL_MAX);
+
 	/**
 	 * Returns the appropriate color for the given intersection data.
-	 * @param data The data to use to get the color of the object at the intersection.
-	 * @param allowedReflectionCount Used to prevent recursive calls from going on forever.  When >0, does not call shader, and returns background color.
+	 * Reflections are followed in a loop, carrying the product of the reflectances along the way, rather than recursing per bounce.
+	 * @param data The data to use to get the color of the object at the intersection.  Overwritten by each bounce.
+	 * @param allowedReflectionCount Used to prevent reflections from going on forever.  When 0, reflections return GetReflectionLimitColor().
+	 * @param visibility If not NULL, the shadows of the first hit are looked up here before any shadow rays are cast,
+	 *                   and the ones that had to be cast are added to it.  See ShadowVisibility.
 	 */
-	Color ShadeIntersection(Intersection &data, int allowedReflectionCount = DEFAULT_REFLECTION_DEPTH);
+	Color ShadeIntersection(Intersection &data, int allowedReflectionCount = DEFAULT_REFLECTION_DEPTH, ShadowVisibility *visibility = NULL);
 
 	/**
 	 * Casts the given ray into the scene and returns the color it hit.
@@ -91,7 +199,16 @@ public:
 	 * @param intersection The position that we want to know if there is a shadow at.
 	 * @return True if we are in shadow, false otherwise.
 	 */
-	bool CastShadowRay(ILight *light, Intersection &intersection);
+	bool CastShadowRay(const LightRecord &light, Intersection &intersection);
+
+	/**
+	 * Calculates the ray that goes from the given point to the given light.
+	 * The ray has a t value of 1.0 at the light, and has already been stepped off of the surface.
+	 * @param light The light the ray is cast towards.
+	 * @param point The point the ray starts at.
+	 * @param sample The sample to use if the light is an area light.
+	 */
+	Ray GetShadowRay(const LightRecord &light, const sivelab::Vector3D &point, const Sample &sample);
 
 	/**
 	 * Casts an intersection ray.
@@ -101,6 +218,42 @@ public:
 	 */
 	Color CastReflectionRay(Intersection &intersection, double roughness);
 
+	/**
+	 * Calculates the ray that is reflected off of the given intersection.
+	 * @param intersection The intersection that the ray bounces from.
+	 * @param roughness The roughness of the reflection.  0.0 is perfectly reflective.
+	 * @param sample The sample used to perturb the ray if roughness is not 0.0.
+	 */
+	Ray GetReflectionRay(const Intersection &intersection, double roughness, const Sample &sample);
+
+	/**
+	 * Casts the shadow and reflection rays needed by the given shading terms, and sums them into a color.
+	 * @param intersection The intersection the terms were calculated for.
+	 * @param terms The terms to resolve.
+	 */
+	Color ResolveShadingTerms(Intersection &intersection, const ShadingTerms &terms);
+
+	/**
+	 * Same as ResolveShadingTerms(), but leaves out the reflection.
+	 * @param visibility If not NULL, used to skip the shadow rays of lights whose visibility is already known.  See ShadeIntersection().
+	 */
+	Color ResolveLightTerms(Intersection &intersection, const ShadingTerms &terms, ShadowVisibility *visibility = NULL);
+
+	/**
+	 * The color a reflection ray returns once it runs out of allowed reflections.
+	 */
+	static Color GetReflectionLimitColor();
+
+	/**
+	 * Plays Russian roulette with a path that is about to bounce, if RouletteThreshold is positive.
+	 * Paths whose throughput is below the threshold survive with a chance proportional to it,
+	 * and the survivors have their throughput scaled up to make up for the ones that were stopped.
+	 * @param throughput What the rest of the path gets multiplied by.  Scaled up if the path survives.
+	 * @param sample The sample that decides whether the path survives.
+	 * @return True if the path should keep bouncing.
+	 */
+	bool ContinuePath(Color &throughput, const Sample &sample) const;
+
 	/**
 	 * Get a constant iterator to the beginning of the list of lights.
 	 */
@@ -111,37 +264,352 @@ public:
 	 */
 	LightList::const_iterator GetLightsEnd() const;
 
+	/**
+	 * Picks the lights that the given shading point should cast shadow rays towards.
+	 * Every light is picked with a weight of 1.0, unless LightSampleCount is positive,
+	 * in which case that many lights are picked in proportion to their power, and weighted so that the average is right.
+	 * @param intersection The shading point.  Its samples decide which lights are picked.
+	 * @param choices Will be filled with the picked lights.
+	 */
+	void SelectLights(const Intersection &intersection, LightChoiceList &choices) const;
+
 	/**
 	 * Gets the amount of ambient light in the scene.
 	 */
 	const Color &GetAmbient() const;
 
+	/**
+	 * Gets the number of times shaders add the ambient light at each shading point.
+	 * That is once for every light, unless LightSampleCount is positive, in which case it is only once,
+	 * since adding it for all of hundreds of lights washes the image out.
+	 */
+	int GetAmbientCount() const;
+
 	/**
 	 * Set this to true to have verbose output printed out.
 	 */
 	bool VerboseOutput;
 
+	/**
+	 * Controls how the scene is rendered by Render().  Defaults to RENDER_RECURSIVE.
+	 */
+	RenderMode RenderingMode;
+
+	/**
+	 * Controls which sampler Render() takes the camera, area light and glossy reflection samples from.  Defaults to SAMPLER_SOBOL.
+	 * Samples only depend on the pixel, sample index and dimension, so renders are the same no matter how many threads are used.
+	 */
+	SamplerType SamplingMethod;
+
+	/**
+	 * When true, each pixel stops taking samples once the 95% confidence interval of its luminance is within AdaptiveThreshold.
+	 * The rays per pixel the scene was loaded with becomes the maximum number of samples.  Defaults to false.
+	 */
+	bool AdaptiveSampling;
+
+	/**
+	 * The number of samples taken in each pixel before its variance is trusted, and the number taken between checks after that.
+	 * Only used when AdaptiveSampling is true.  Defaults to 4.
+	 */
+	int AdaptiveMinSamples;
+
+	/**
+	 * How close the mean luminance of a pixel has to be to the true value before it stops taking samples.
+	 * Only used when AdaptiveSampling is true.  Defaults to 0.01.
+	 */
+	double AdaptiveThreshold;
+
+	/**
+	 * When true, Render() first shoots a single ray through the center of each pixel, remembering the object, shader and normal it hit.
+	 * Only the pixels that differ from one of their neighbors are then supersampled, and the rest keep the color of their center ray.
+	 * Pixels whose center ray hit a glossy reflection or a surface lit by an area light are always supersampled, since a single sample of those is noisy.
+	 * Hard shadow edges are not detected, since they do not change what was hit.  Defaults to false.
+	 */
+	bool EdgeAwareSampling;
+
+	/**
+	 * The angle, in degrees, that the normals of neighboring pixels have to differ by before they are treated as an edge.
+	 * Only used when EdgeAwareSampling is true.  Defaults to 20.
+	 */
+	double EdgeAngleThreshold;
+
+	/**
+	 * Gets the number of pixels that were supersampled by the last edge-aware render.
+	 */
+	int GetSupersampledPixelCount() const;
+
+	/**
+	 * When positive, shaders pick this many lights per shading point at random, in proportion to how bright each light is,
+	 * instead of casting a shadow ray towards every light.  This keeps scenes with hundreds of lights tractable, at the cost of noise.
+	 * Scenes turn it on with the lightSamples attribute of the scene element.  Set to 0 to use every light.  Defaults to 0.
+	 */
+	int LightSampleCount;
+
+	/**
+	 * When positive, reflected paths whose throughput (the largest component of the product of the reflectances so far)
+	 * drops below this are stopped at random, instead of always running until DEFAULT_REFLECTION_DEPTH.
+	 * This is unbiased, but adds noise to whatever the dim bounces would have added.  Set to 0.0 to turn it off.  Defaults to 0.0.
+	 */
+	double RouletteThreshold;
+
+	/**
+	 * When true, samples in the same pixel that hit the same primitive of the same object, within the same cube of
+	 * ShadingCellSize, share the color of the first one shaded, instead of each running the light loop and casting shadow rays.
+	 * Only used for view-independent shaders (see IShader::IsViewIndependent()), and only when nothing about the lighting
+	 * is random, since sharing random samples would only add noise.  Only recursive rendering supports it, so Render() throws
+	 * if it is set with any other RenderingMode, or with ProgressiveRendering.
+	 * A shadow edge that crosses a pixel is only antialiased if ShadingCellSize is small enough to split it.  Defaults to false.
+	 */
+	bool DecoupledShading;
+
+	/**
+	 * The size of the cubes that decoupled shading groups hits into.
+	 * When negative, the size is picked for each hit from how wide the pixel is where it lands, so that each pixel is split
+	 * into cubes about half a pixel across.  Set to 0.0 to shade each primitive once per pixel.  Defaults to -1.0.
+	 */
+	double ShadingCellSize;
+
+	/**
+	 * The width and height, in pixels, of the tiles that multithreaded recursive renders are split into.  Defaults to 16.
+	 */
+	int TileSize;
+
+	/**
+	 * The order tiles are handed out to threads in.  See TileScheduler.  Defaults to TILE_ORDER_HILBERT.
+	 */
+	TileOrder RenderTileOrder;
+
+	/**
+	 * When true, Render() takes one sample in every pixel at a time, adding each pass into an accumulation buffer,
+	 * until every pixel has the rays per pixel the scene was loaded with, or ProgressiveTimeBudget runs out.
+	 * Passes are always traced recursively, so Render() throws if RenderingMode is not RENDER_RECURSIVE, or if AdaptiveSampling,
+	 * EdgeAwareSampling or PrimaryHitCacheFileName are set.  Defaults to false.
+	 */
+	bool ProgressiveRendering;
+
+	/**
+	 * The wall-clock time, in seconds, that a progressive render is allowed to take.
+	 * No pass is started that is not expected to finish in time, but at least one pass is always taken.
+	 * Set to 0 to only stop once every sample has been taken.  Defaults to 0.
+	 */
+	double ProgressiveTimeBudget;
+
+	/**
+	 * The file that progressive renders write the current average to when a checkpoint is taken.
+	 * Written as a png, unless the name ends in .pfm or .exr, in which case it is written before any tone mapping with HdrFile.
+	 * Set to an empty string to never write checkpoints.  Defaults to empty.
+	 */
+	std::string CheckpointFileName;
+
+	/**
+	 * The number of seconds between checkpoints of a progressive render.
+	 * Set to 0 to only write checkpoints when RequestCheckpoint() is called.  Defaults to 0.
+	 */
+	double CheckpointInterval;
+
+	/**
+	 * Asks the progressive render in progress to write a checkpoint once its current pass is done.
+	 * Only sets a flag, so it is safe to call from a signal handler.
+	 */
+	void RequestCheckpoint();
+
+	/**
+	 * Gets the number of samples taken in each pixel by the last progressive render.
+	 */
+	int GetProgressivePassCount() const;
+
+	/**
+	 * Throws away the primary hits kept by RENDER_DEFERRED, so that the next render traces them again.
+	 * Has to be called after moving the camera or any objects.  Changing lights or shaders does not need it.
+	 */
+	void InvalidatePrimaryHits();
+
+	/**
+	 * If not empty, RENDER_DEFERRED saves its primary hits and the shadows of those hits to this file, and loads them back
+	 * on later runs, as long as the geometry, camera, image size, rays per pixel and sampler are the same.
+	 * The shadows are kept as long as the lights have not moved or changed shape, so only shading is left to do
+	 * when nothing but shaders or light colors change.  Defaults to empty.
+	 */
+	std::string PrimaryHitCacheFileName;
+
 	friend class LightCreator;
 	friend class CameraCreator;
 	friend class ObjectCreator;
 	friend class ShaderCreator;
+	friend class ScenePropertiesCreator;
+	friend class WavefrontRenderer;
+	friend class ProgressiveRenderer;
+	friend class DeferredRenderer;
 
 private:
 	/**
 	 * Raytraces the given pixel.
+	 * @param sampleCountColor Will be set to the number of samples taken, as a grey level where white is the maximum.
 	 */
-	Color RaytracePixel(int x, int y);
+	Color RaytracePixel(int x, int y, Color &sampleCountColor);
+
+	/**
+	 * Gets the number of samples to take in a pixel before checking whether it has converged.
+	 * @param maxSampleCount The most samples the pixel can take.
+	 */
+	int GetSampleBatchSize(int maxSampleCount) const;
+
+	/**
+	 * Returns true if a pixel with the given luminance statistics does not need any more samples.
+	 * Always false if AdaptiveSampling is off.
+	 */
+	bool IsPixelConverged(const RunningVariance &luminance) const;
+
+	/**
+	 * Gets the color a pixel gets in the sample count image.
+	 */
+	static Color GetSampleCountColor(int sampleCount, int maxSampleCount);
+
+	/**
+	 * Makes the viewing rays for the given pixel, and starts sampling it.
+	 * @param x The x-coordinate of the pixel.
+	 * @param y The y-coordinate of the pixel.
+	 * @param rayList Will be filled with the viewing rays.
+	 * @param samples Will be started with one sample per viewing ray.
+	 */
+	void GeneratePixelSamples(int x, int y, RayList &rayList, PixelSampler &samples);
+
+	/**
+	 * Gets the sample to use for the given purpose when shading the given intersection.
+	 */
+	Sample GetPathSample(const Intersection &intersection, SampleUse use) const;
+
+	/**
+	 * Makes sure that m_sampler is the type asked for by SamplingMethod.
+	 */
+	void PrepareSampler();
 
 	/**
 	 * Same idea as public Render() above.
 	 * Comes in single and multithreaded flavors.
 	 */
-	void RenderSingleThreaded(Image &image);
-	void RenderMultiThreaded(Image &image, int threadCount);
+	void RenderSingleThreaded(Image &image, Image *sampleCounts, const std::vector<bool> *pixelMask, std::vector<PixelHitInfo> *centerHits);
+	void RenderMultiThreaded(Image &image, int threadCount, Image *sampleCounts, const std::vector<bool> *pixelMask, std::vector<PixelHitInfo> *centerHits);
+
+	/**
+	 * Renders a band of rows of a larger image.  The camera has to already be set up for the larger image.
+	 * @param band The image the band is rendered to.  It is as wide as the larger image.
+	 * @param bandTop The row of the larger image that the top of the band is at.
+	 * @param imageHeight The height of the larger image.
+	 */
+	void RenderBand(Image &band, int threadCount, int bandTop, int imageHeight);
+
+	/**
+	 * Renders an area of the image in tiles, spread across the given number of threads.  See TileSize and RenderTileOrder.
+	 * @param area The area to render, in camera space, where y is not flipped.
+	 * @param renderInfo Everything needed to render a tile, except for where it is.
+	 */
+	void RenderTiles(const Tile &area, RenderingThreadInfo &renderInfo, int threadCount);
+
+	/**
+	 * Renders the pixels that are true in the mask (or every pixel, if it is NULL) with the current rendering mode.
+	 * The mask is indexed by y * width + x, where y is not flipped.
+	 */
+	void RenderPixels(Image &image, int threadCount, Image *sampleCounts, const std::vector<bool> *pixelMask);
+
+	/**
+	 * Renders the image in two passes, only supersampling pixels on the edges of objects.  See EdgeAwareSampling.
+	 */
+	void RenderEdgeAware(Image &image, int threadCount, Image *sampleCounts);
+
+	/**
+	 * Shoots a single ray through the center of the given pixel, and shades it.
+	 * @param hitInfo Will be filled in with what the ray hit.
+	 * @param sampleCountColor Will be set to the color of a single sample in the sample count image.
+	 */
+	Color RaytracePixelCenter(int x, int y, PixelHitInfo &hitInfo, Color &sampleCountColor);
+
+	/**
+	 * Returns true if two neighboring pixels hit different objects or shaders, or their normals differ too much.
+	 * @param minimumCosine The smallest cosine of the angle between the normals that is not an edge.
+	 */
+	static bool IsEdgeBetween(const PixelHitInfo &a, const PixelHitInfo &b, double minimumCosine);
+
+	/**
+	 * Returns true if shading the given intersection takes random samples, such as for glossy reflections or area lights.
+	 */
+	bool IsStochasticHit(Intersection &intersect) const;
+
+	/**
+	 * Returns true if shading any point might take random samples of the lights, such as for area lights or light sampling.
+	 */
+	bool HasStochasticLighting() const;
+
+	/**
+	 * Same as CastRayAndShade(), but if the ray hits a view-independent shader, the color is looked up in or added to the cache.
+	 * @param cache The colors shaded so far in this pixel.  If NULL, nothing is cached.
+	 */
+	bool CastRayAndShadeCached(const Ray &ray, Color &result, Intersection &intersect, ShadingCache *cache);
+
+	/**
+	 * Bakes the noise of every Perlin shader that asked for it, over the bounds of the objects that use the shader.
+	 * Has to be called after the objects are loaded, but before they are put into the BVH.
+	 */
+	void BakeNoise();
 
 	ICamera *m_camera;
+
+	/**
+	 * The sampler that pixels are sampled with, and the type it was created as.
+	 */
+	ISampler *m_sampler;
+	SamplerType m_samplerType;
+
+	/**
+	 * The number of pixels supersampled by the last edge-aware render.
+	 */
+	int m_supersampledPixelCount;
+
+	/**
+	 * The number of passes taken by the last progressive render, and whether a checkpoint has been asked for.
+	 */
+	int m_progressivePassCount;
+	volatile sig_atomic_t m_checkpointRequested;
+
+	/**
+	 * Renders RENDER_DEFERRED, and keeps its G-buffer between renders.  Created by the first deferred render.
+	 */
+	DeferredRenderer *m_deferredRenderer;
 	ObjectList m_objects;
 	LightList m_lights;
+
+	/**
+	 * Every object in the scene, in the order they were loaded, even if they are in the BVH.
+	 * The index of an object in this list is how the primary hit cache refers to it.
+	 */
+	ObjectList m_sceneObjects;
+
+	/**
+	 * Where meshes are loaded while the scene file is being parsed, and the meshes that have to be waited for before it is done.
+	 */
+	ThreadEngine::TaskGraph *m_loader;
+	std::vector<Mesh*> m_loadingMeshes;
+
+	/**
+	 * Hashes of everything in the scene file that decides what the primary rays hit.  Shaders and lights are left out.
+	 */
+	uint64_t m_geometryHash;
+	uint64_t m_cameraHash;
+
+	/**
+	 * Hashes the position and shape of every light, but not its color.  Shadows only depend on these.
+	 */
+	uint64_t GetLightGeometryHash() const;
+
+	/**
+	 * Every light in m_lights, flattened when the scene is loaded.  This is what rendering uses.
+	 */
+	LightTable m_lightTable;
+
+	/**
+	 * Picks lights from m_lightTable when LightSampleCount is positive.
+	 */
+	LightSampler m_lightSampler;
 	ShaderMap m_shaders;
 	InstanceableMap m_instances;
 
@@ -165,3 +633,26 @@ private:
 	friend void *RenderThread(void *info);
 };
 
+
+/**
+ * What the ray through the center of a pixel hit.  Used to find edges when rendering with Scene::EdgeAwareSampling.
+ */
+struct PixelHitInfo
+{
+	/**
+	 * The object and shader that were hit.  Both are NULL if nothing was hit.
+	 */
+	IObject *object;
+	IShader *shader;
+
+	/**
+	 * The unit length normal of the surface where the ray hit.
+	 */
+	sivelab::Vector3D normal;
+
+	/**
+	 * True if shading the hit takes random samples, so the pixel needs supersampling even if it is not on an edge.
+	 */
+	bool needsSamples;
+};
+
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+#include <stdint.h>
+
+#include "Color.h"
+#include "Vector3D.h"
+
+class IObject;
+
+
+/**
+ * Remembers the colors of the primary hits shaded in a single pixel, so that samples that land on the same part of
+ * the same primitive can reuse a color instead of running the light loop and casting shadow rays again.
+ * Only hits whose color does not depend on the view or on the path's samples should be cached.
+ */
+struct ShadingCache
+{
+	/**
+	 * Where a shaded hit was.  Two hits with the same key share a color.
+	 */
+	struct Key
+	{
+		IObject *object;
+		IObject *primitive;
+		int64_t cell[3];
+
+		/**
+		 * The power of 2 that the cells were sized to, when they are picked from the pixel's footprint.
+		 */
+		int level;
+	};
+
+	ShadingCache()
+	{
+		cellSize = 0.0;
+		pixelAngle = 0.0;
+	}
+
+	/**
+	 * Makes the key for a hit on the given primitive of the given object, at the given point.
+	 * @param distance How far the point is from the camera.
+	 */
+	inline Key MakeKey(IObject *object, IObject *primitive, const sivelab::Vector3D &point, double distance) const
+	{
+		Key key;
+		key.object = object;
+		key.primitive = primitive;
+		key.level = 0;
+
+		double size = cellSize;
+		if (pixelAngle > 0.0)
+		{
+			// Round half of the pixel's width at the hit up to a power of 2, so that hits at about the same distance use the same cells.
+			double footprint = std::max(0.5 * pixelAngle * distance, 1e-12);
+			key.level = (int)ceil(log2(footprint));
+			size = ldexp(1.0, key.level);
+		}
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			key.cell[axis] = (size > 0.0) ? (int64_t)floor(point[axis] / size) : 0;
+		}
+
+		return (key);
+	}
+
+	/**
+	 * Looks up the color of a hit with the given key.
+	 * @return True if it was found.
+	 */
+	inline bool Find(const Key &key, Color &color) const
+	{
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			const Key &entry = entries[i].first;
+			if ((entry.object == key.object) && (entry.primitive == key.primitive) && (entry.level == key.level) &&
+				(entry.cell[0] == key.cell[0]) && (entry.cell[1] == key.cell[1]) && (entry.cell[2] == key.cell[2]))
+			{
+				color = entries[i].second;
+				return (true);
+			}
+		}
+
+		return (false);
+	}
+
+	/**
+	 * Records the color of a hit with the given key.
+	 */
+	inline void Add(const Key &key, const Color &color)
+	{
+		entries.push_back(std::make_pair(key, color));
+	}
+
+	/**
+	 * The size of the cubes that hits are grouped into.  0.0 groups every hit on a primitive together.
+	 */
+	double cellSize;
+
+	/**
+	 * When positive, the width of the pixel a distance of 1 from the camera.  Each hit is then grouped into cubes about
+	 * half as wide as the pixel is where it lands, and cellSize is ignored.
+	 */
+	double pixelAngle;
+
+	/**
+	 * Each hit shaded so far.  A pixel only covers a few primitives, so this is short, and searched in order.
+	 */
+	std::vector<std::pair<Key, Color> > entries;
+};
@@ -0,0 +1,39 @@
+#include "ShadingTerms.h"
+
+
+ShadingTerms::ShadingTerms()
+{
+	reflects = false;
+	roughness = 0.0;
+}
+
+
+void ShadingTerms::Clear()
+{
+	base = Color();
+	lights.clear();
+	reflects = false;
+	reflectance = Color();
+	roughness = 0.0;
+}
+
+
+void ShadingTerms::AddLight(const LightRecord* light, const Color& contribution)
+{
+	LightTerm term;
+	term.light = light;
+	term.contribution = contribution;
+	lights.push_back(term);
+}
+
+
+void ShadingTerms::Scale(double scalar)
+{
+	base.LinearMult(scalar);
+	reflectance.LinearMult(scalar);
+
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		lights[i].contribution.LinearMult(scalar);
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+
+#include "Color.h"
+
+struct LightRecord;
+
+
+/**
+ * The light a single light source adds to a shading point when that point is not in shadow.
+ */
+struct LightTerm
+{
+	/**
+	 * The light that has to be visible for the contribution to count.
+	 */
+	const LightRecord *light;
+
+	/**
+	 * The color added when the light is visible.
+	 */
+	Color contribution;
+};
+
+
+/**
+ * The result of a shader, expressed as terms that still need rays to be traced before they can be summed.
+ * The final color is: base + (the contribution of each unshadowed light) + reflectance * (the reflected color).
+ * This lets the caller decide when and how to trace the shadow and reflection rays.
+ */
+struct ShadingTerms
+{
+	ShadingTerms();
+
+	/**
+	 * Resets the terms to black, with no lights and no reflection.
+	 */
+	void Clear();
+
+	/**
+	 * Adds a light term.
+	 */
+	void AddLight(const LightRecord *light, const Color &contribution);
+
+	/**
+	 * Multiplies every term by the given scalar.
+	 */
+	void Scale(double scalar);
+
+	/**
+	 * The part of the color that does not depend on any other rays.
+	 */
+	Color base;
+
+	/**
+	 * The colors that each light adds if it is not in shadow.
+	 */
+	std::vector<LightTerm> lights;
+
+	/**
+	 * Set to true if a reflection ray should be cast.
+	 */
+	bool reflects;
+
+	/**
+	 * What the reflected color gets multiplied by.  Only valid if reflects is true.
+	 */
+	Color reflectance;
+
+	/**
+	 * The roughness of the reflection.  0.0 is perfectly reflective.
+	 */
+	double roughness;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+
+/**
+ * Remembers which lights a single shading point can see, so that shading it again does not need any shadow rays.
+ * Whether a light is visible only depends on the geometry, the light's position and shape, and the path's samples,
+ * so it stays valid when shaders or light colors change.
+ */
+struct ShadowVisibility
+{
+	/**
+	 * Looks up whether the light with the given index was recorded as visible.
+	 * @param lightIndex The index of the light in the scene's light table.
+	 * @param visible Will be set to whether the light is visible, if it was recorded.
+	 * @return True if the light was recorded.
+	 */
+	inline bool Find(int lightIndex, bool &visible) const
+	{
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			if ((entries[i] >> 1) == lightIndex)
+			{
+				visible = ((entries[i] & 1) != 0);
+				return (true);
+			}
+		}
+
+		return (false);
+	}
+
+	/**
+	 * Records whether the light with the given index is visible.
+	 */
+	inline void Add(int lightIndex, bool visible)
+	{
+		entries.push_back((lightIndex << 1) | (visible ? 1 : 0));
+	}
+
+	/**
+	 * Each entry is a light index shifted left by one, with the lowest bit set if the light is visible.
+	 * A shading point only records the lights its shader asked about, so this is usually short.
+	 */
+	std::vector<int> entries;
+};
@@ -0,0 +1,74 @@
+#include "SobolSampler.h"
+#include "RandomGenerator.h"
+
+
+/**
+ * Reverses the order of the bits in the given value.
+ */
+static inline uint32_t ReverseBits(uint32_t value)
+{
+	value = ((value >> 1) & 0x55555555) | ((value & 0x55555555) << 1);
+	value = ((value >> 2) & 0x33333333) | ((value & 0x33333333) << 2);
+	value = ((value >> 4) & 0x0F0F0F0F) | ((value & 0x0F0F0F0F) << 4);
+	value = ((value >> 8) & 0x00FF00FF) | ((value & 0x00FF00FF) << 8);
+	return ((value >> 16) | (value << 16));
+}
+
+
+/**
+ * Maps a 32 bit fixed point number to [0, 1).
+ */
+static inline double ToUnitInterval(uint32_t value)
+{
+	return (value * (1.0 / 4294967296.0));
+}
+
+
+void SobolSampler::GetSobolPoint(uint32_t index, uint32_t& x, uint32_t& y)
+{
+	// The first dimension is the van der Corput sequence.
+	x = ReverseBits(index);
+
+	// The generator matrix of the second dimension is Pascal's triangle, mod 2.
+	y = 0;
+	for (uint32_t column = 1u << 31; index != 0; index >>= 1, column ^= column >> 1)
+	{
+		if (index & 1)
+		{
+			y ^= column;
+		}
+	}
+}
+
+
+uint32_t SobolSampler::OwenScramble(uint32_t value, uint32_t seed)
+{
+	// This is Laine and Karras' permutation, with Burley's improved constants.
+	// It works on the reversed bits, where each bit only depends on the bits below it.
+	value = ReverseBits(value);
+	value ^= value * 0x3d20adea;
+	value += seed;
+	value *= (seed >> 16) | 1;
+	value ^= value * 0x05526c56;
+	value ^= value * 0x53a22864;
+	return (ReverseBits(value));
+}
+
+
+Sample SobolSampler::GetSample(int pixelX, int pixelY, int index, int sampleCount, int dimension) const
+{
+	uint64_t seed = RandomGenerator::Hash(pixelX, pixelY, dimension);
+
+	// Shuffle the order of the points.  Owen scrambling the index maps the first 2^n indices to an aligned block of 2^n points,
+	// which are just as well stratified as the first 2^n points.
+	uint32_t shuffledIndex = OwenScramble(index, (uint32_t)seed);
+
+	uint32_t x, y;
+	GetSobolPoint(shuffledIndex, x, y);
+
+	// Each axis gets its own scramble.
+	x = OwenScramble(x, (uint32_t)(seed >> 32));
+	y = OwenScramble(y, (uint32_t)(seed >> 32) * 0x9E3779B9 + 1);
+
+	return (std::make_pair(ToUnitInterval(x), ToUnitInterval(y)));
+}
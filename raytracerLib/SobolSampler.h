@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ISampler.h"
+
+
+/**
+ * Generates samples from the first two dimensions of the Sobol sequence.
+ * Every pixel and dimension gets its own Owen scrambling, and its own shuffle of the sample order,
+ * so the samples are decorrelated but keep the low discrepancy of the sequence.
+ * Any number of samples can be taken, but powers of two are the best stratified.
+ */
+class SobolSampler : public ISampler
+{
+public:
+	virtual Sample GetSample(int pixelX, int pixelY, int index, int sampleCount, int dimension) const;
+
+	/**
+	 * Gets the index'th point of the unscrambled 2D Sobol sequence, as 32 bit fixed point numbers.
+	 */
+	static void GetSobolPoint(uint32_t index, uint32_t &x, uint32_t &y);
+
+	/**
+	 * Applies a hash-based Owen scramble to a 32 bit fixed point number.
+	 * Each bit is flipped based on a hash of the seed and all of the more significant bits,
+	 * which randomizes the value while keeping its stratification.
+	 */
+	static uint32_t OwenScramble(uint32_t value, uint32_t seed);
+};
@@ -1,5 +1,6 @@
 #include "SolidShader.h"
 #include "Color.h"
+#include "ShadingTerms.h"
 
 SolidShader::SolidShader(const Color& color)
 {
@@ -11,3 +12,16 @@ Color SolidShader::Shade(Intersection& intersection)
 {
 	return (m_color);
 }
+
+
+bool SolidShader::Decompose(Intersection& intersection, ShadingTerms& terms)
+{
+	terms.base = m_color;
+	return (true);
+}
+
+
+bool SolidShader::IsViewIndependent() const
+{
+	return (true);
+}
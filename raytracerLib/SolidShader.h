@@ -17,6 +17,10 @@ public:
 
     virtual Color Shade(Intersection& intersection);
 
+    virtual bool Decompose(Intersection& intersection, ShadingTerms& terms);
+
+    virtual bool IsViewIndependent() const;
+
 private:
 	/**
 	 * The color of the shader.
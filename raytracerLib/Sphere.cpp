@@ -37,7 +37,7 @@ BBox Sphere::GetBoundingBox()
 }
 
 
-bool Sphere::Intersect(const Ray& ray, Intersection& result)
+bool Sphere::Intersect(const Ray& ray, HitRecord& hit)
 {
 	const Vector3D &rayPos = ray.GetPosition();
 	const Vector3D &rayDir = ray.GetDirection();
@@ -59,15 +59,19 @@ bool Sphere::Intersect(const Ray& ray, Intersection& result)
 		double t2 = (-b - sqrt(descriminant)) / (2 * a);
 
 		// Record intersection.
-		result.t = std::min(t1, t2);
-		result.collidedRay = ray;
-		result.object = this;
-
-		// Calculate surface normal.
-		result.surfaceNormal = ray.GetPositionAtTime(result.t) - m_center;
-		result.surfaceNormal.normalize();
+		hit.t = std::min(t1, t2);
+		hit.object = this;
+		hit.primitive = this;
 
 		return (true);
 	}
 }
 
+
+sivelab::Vector3D Sphere::GetNormal(const Ray& ray, const HitRecord& hit)
+{
+	sivelab::Vector3D normal = ray.GetPositionAtTime(hit.t) - m_center;
+	normal.normalize();
+	return (normal);
+}
+
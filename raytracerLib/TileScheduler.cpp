@@ -0,0 +1,226 @@
+#include <algorithm>
+
+#include "TileScheduler.h"
+#include "EngineException.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+
+/**
+ * Used to sort the tiles by their position along the curve.
+ */
+struct TileKey
+{
+	uint64_t key;
+	int tile;
+
+	bool operator<(const TileKey &other) const
+	{
+		return ((key < other.key) || ((key == other.key) && (tile < other.tile)));
+	}
+};
+
+
+TileScheduler::TileScheduler(const Tile &area, int tileSize, TileOrder order)
+{
+	if (tileSize <= 0)
+	{
+		throw EngineException("Tiles have to be at least one pixel across!");
+	}
+
+	m_function = NULL;
+	m_context = NULL;
+	m_stealCount = 0;
+
+	int tilesX = (area.width + tileSize - 1) / tileSize;
+	int tilesY = (area.height + tileSize - 1) / tileSize;
+
+	// The curves are defined over a square grid that is a power of 2 across, so the tiles are placed on the smallest one that fits.
+	uint32_t gridSize = 1;
+	while ((gridSize < (uint32_t)tilesX) || (gridSize < (uint32_t)tilesY))
+	{
+		gridSize *= 2;
+	}
+
+	vector<TileKey> keys;
+	for (int tileY = 0; tileY < tilesY; tileY++)
+	{
+		for (int tileX = 0; tileX < tilesX; tileX++)
+		{
+			Tile tile;
+			tile.x = area.x + tileX * tileSize;
+			tile.y = area.y + tileY * tileSize;
+			tile.width = min(tileSize, area.x + area.width - tile.x);
+			tile.height = min(tileSize, area.y + area.height - tile.y);
+
+			TileKey key;
+			key.tile = m_tiles.size();
+			if (order == TILE_ORDER_MORTON)
+			{
+				key.key = GetMortonIndex(tileX, tileY);
+			}
+			else if (order == TILE_ORDER_HILBERT)
+			{
+				key.key = GetHilbertIndex(tileX, tileY, gridSize);
+			}
+			else
+			{
+				key.key = key.tile;
+			}
+
+			keys.push_back(key);
+			m_tiles.push_back(tile);
+		}
+	}
+
+	sort(keys.begin(), keys.end());
+
+	vector<Tile> sortedTiles(m_tiles.size());
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		sortedTiles[i] = m_tiles[keys[i].tile];
+	}
+	m_tiles.swap(sortedTiles);
+}
+
+
+void TileScheduler::Run(TileFunction function, void *context, int threadCount)
+{
+	m_function = function;
+	m_context = context;
+	m_stealCount = 0;
+
+	int tileCount = m_tiles.size();
+	if ((threadCount <= 1) || (tileCount <= 1))
+	{
+		for (int i = 0; i < tileCount; i++)
+		{
+			function(m_tiles[i], context);
+		}
+		return;
+	}
+
+	// Give each thread an equal run of the tiles, in order along the curve.
+	m_queues.resize(threadCount);
+	vector<WorkerInfo> workers(threadCount);
+	for (int i = 0; i < threadCount; i++)
+	{
+		int start = (int)((int64_t)tileCount * i / threadCount);
+		int end = (int)((int64_t)tileCount * (i + 1) / threadCount);
+		m_queues[i] = new ThreadEngine::WorkStealingDeque(end - start);
+		for (int tile = end - 1; tile >= start; tile--)
+		{
+			m_queues[i]->Push(&m_tiles[tile]);
+		}
+
+		workers[i].scheduler = this;
+		workers[i].index = i;
+		workers[i].stealCount = 0;
+	}
+
+	ThreadEngine::ThreadPool tilePool(threadCount);
+	tilePool.StartProcessing();
+
+	tilePool.AddJobs(Work, workers);
+
+	// Wait for all jobs to be completed.
+	tilePool.JoinAll();
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		m_stealCount += workers[i].stealCount;
+		delete m_queues[i];
+	}
+	m_queues.clear();
+}
+
+
+const Tile *TileScheduler::TakeTile(WorkerInfo &worker)
+{
+	// Work through our own run from the front, so the tiles stay in order along the curve.
+	void *tile;
+	if (m_queues[worker.index]->Pop(tile))
+	{
+		return ((const Tile*)tile);
+	}
+
+	// Steal from the back of the other threads' runs, as far as possible from where they are working.
+	// No tiles are ever added, so once every deque has been seen empty, there is nothing left to do.
+	int queueCount = m_queues.size();
+	for (int offset = 1; offset < queueCount; offset++)
+	{
+		if (m_queues[(worker.index + offset) % queueCount]->Steal(tile))
+		{
+			worker.stealCount++;
+			return ((const Tile*)tile);
+		}
+	}
+
+	return (NULL);
+}
+
+
+void *TileScheduler::Work(void *info)
+{
+	WorkerInfo *worker = (WorkerInfo*)info;
+	TileScheduler *scheduler = worker->scheduler;
+
+	for (const Tile *tile = scheduler->TakeTile(*worker); tile != NULL; tile = scheduler->TakeTile(*worker))
+	{
+		scheduler->m_function(*tile, scheduler->m_context);
+	}
+
+	return (NULL);
+}
+
+
+const vector<Tile> &TileScheduler::GetTiles() const
+{
+	return (m_tiles);
+}
+
+
+int TileScheduler::GetStealCount() const
+{
+	return (m_stealCount);
+}
+
+
+uint64_t TileScheduler::GetMortonIndex(uint32_t x, uint32_t y)
+{
+	// Interleave the bits of the coordinates, with x in the low bit.
+	uint64_t index = 0;
+	for (int bit = 0; bit < 32; bit++)
+	{
+		index |= (uint64_t)((x >> bit) & 1) << (2 * bit);
+		index |= (uint64_t)((y >> bit) & 1) << (2 * bit + 1);
+	}
+
+	return (index);
+}
+
+
+uint64_t TileScheduler::GetHilbertIndex(uint32_t x, uint32_t y, uint32_t gridSize)
+{
+	// Work down from the biggest quadrants, rotating the coordinates into each quadrant's frame as we go.
+	uint64_t index = 0;
+	for (uint32_t half = gridSize / 2; half > 0; half /= 2)
+	{
+		uint32_t right = ((x & half) != 0) ? 1 : 0;
+		uint32_t top = ((y & half) != 0) ? 1 : 0;
+		index += (uint64_t)half * half * ((3 * right) ^ top);
+
+		if (top == 0)
+		{
+			if (right == 1)
+			{
+				x = gridSize - 1 - x;
+				y = gridSize - 1 - y;
+			}
+			swap(x, y);
+		}
+	}
+
+	return (index);
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "WorkStealingDeque.h"
+
+
+/**
+ * A rectangle of pixels that is rendered as a single unit of work.
+ */
+struct Tile
+{
+	int x, y, width, height;
+};
+
+
+/**
+ * The orders the tiles of an image can be handed out in.
+ */
+enum TileOrder
+{
+	/**
+	 * Row by row, from the first row of tiles to the last.
+	 */
+	TILE_ORDER_SCANLINE,
+
+	/**
+	 * Along a Z-order curve, which keeps runs of tiles in small square blocks.
+	 */
+	TILE_ORDER_MORTON,
+
+	/**
+	 * Along a Hilbert curve, where every tile is next to the one before it.
+	 */
+	TILE_ORDER_HILBERT
+};
+
+
+/**
+ * Splits an area of an image into tiles, and runs a function on every tile across a number of threads.
+ * The tiles are put in order along a curve, and each thread starts with its own contiguous run of them, in its own deque,
+ * so that the tiles a thread renders one after another are close together, and hit the same objects.
+ * A thread works from the front of its deque, and once it is empty, steals from the back of another thread's deque,
+ * so that every thread keeps working until the last tile has been started, no matter how expensive some tiles turn out to be.
+ */
+class TileScheduler
+{
+public:
+	/**
+	 * The type of function that is run on each tile.
+	 * @param tile The tile to work on.
+	 * @param context The context passed to Run().
+	 */
+	typedef void (*TileFunction)(const Tile &tile, void *context);
+
+	/**
+	 * Splits the given area into tiles.
+	 * @param area The area of the image to cover.
+	 * @param tileSize The width and height of each tile.  The tiles along the right and bottom edges may be smaller.
+	 * @param order The order to put the tiles in.
+	 * @throws EngineException If the tile size is not positive.
+	 */
+	TileScheduler(const Tile &area, int tileSize, TileOrder order);
+
+	/**
+	 * Runs the function on every tile, and returns once they are all done.
+	 * @param threadCount The number of threads to run on.  With 1, the tiles are done in order, on the calling thread.
+	 */
+	void Run(TileFunction function, void *context, int threadCount);
+
+	/**
+	 * Gets the tiles, in the order they are handed out in.
+	 */
+	const std::vector<Tile> &GetTiles() const;
+
+	/**
+	 * Gets the number of tiles that were stolen during the last Run().
+	 */
+	int GetStealCount() const;
+
+	/**
+	 * Finds the position of a cell along a curve that covers a square grid.
+	 * @param gridSize The width of the grid.  Must be a power of 2.
+	 */
+	static uint64_t GetMortonIndex(uint32_t x, uint32_t y);
+	static uint64_t GetHilbertIndex(uint32_t x, uint32_t y, uint32_t gridSize);
+
+private:
+	/**
+	 * Everything a worker thread needs.
+	 */
+	struct WorkerInfo
+	{
+		TileScheduler *scheduler;
+		int index;
+		int stealCount;
+	};
+
+	/**
+	 * Takes the next tile for the given worker, from its own deque if it can, or from another's.
+	 * @return The tile, or NULL if there are none left anywhere.
+	 */
+	const Tile *TakeTile(WorkerInfo &worker);
+
+	/**
+	 * Runs tiles until there are none left.
+	 * @param info Pointer to the WorkerInfo structure for the thread.
+	 */
+	static void *Work(void *info);
+
+	std::vector<Tile> m_tiles;
+
+	/**
+	 * The tiles each thread has left.  A thread's run is pushed in reverse, so that it pops its tiles in order along the curve,
+	 * and thieves take them from the far end of the run.
+	 */
+	std::vector<ThreadEngine::WorkStealingDeque*> m_queues;
+	TileFunction m_function;
+	void *m_context;
+	int m_stealCount;
+};
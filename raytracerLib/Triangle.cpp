@@ -67,7 +67,7 @@ double GetDist(const sivelab::Vector3D &v0, const sivelab::Vector3D &v1)
 
 
 
-bool Triangle::Intersect(const Ray& ray, Intersection& result)
+bool Triangle::Intersect(const Ray& ray, HitRecord& hit)
 {
 	double xa = m_vertices[0][0];
 	double xb = m_vertices[1][0];
@@ -121,21 +121,29 @@ bool Triangle::Intersect(const Ray& ray, Intersection& result)
 	}
 
 	// If we got here, we had an instersection.
-	result.collidedRay = ray;
-	result.t = t;
-	result.object = this;
+	hit.t = t;
+	hit.object = this;
+	hit.primitive = this;
+	hit.u = beta;
+	hit.v = gamma;
 
+	return (true);
+}
+
+
+sivelab::Vector3D Triangle::GetNormal(const Ray& ray, const HitRecord& hit)
+{
 	// Interpolate between all three normals.
-	sivelab::Vector3D intersectPoint = ray.GetPositionAtTime(t);
-	result.surfaceNormal.set(0.0, 0.0, 0.0);
+	sivelab::Vector3D intersectPoint = ray.GetPositionAtTime(hit.t);
+	sivelab::Vector3D normal(0.0, 0.0, 0.0);
 	for (int i = 0; i < VERTEX_COUNT; i++)
 	{
 		// Calculate distance between this vertex and the intersection point.
 		double dist = GetDist(intersectPoint, m_vertices[i]);
-		result.surfaceNormal += m_normal[i] * (1.0/dist);
+		normal += m_normal[i] * (1.0/dist);
 	}
-	result.surfaceNormal.normalize();
+	normal.normalize();
 
-	return (true);
+	return (normal);
 }
 
@@ -15,7 +15,8 @@ public:
 
 	virtual IShader* GetShader();
 
-	virtual bool Intersect(const Ray& ray, Intersection& result);
+	virtual bool Intersect(const Ray& ray, HitRecord& hit);
+	virtual sivelab::Vector3D GetNormal(const Ray& ray, const HitRecord& hit);
 
 	virtual BBox GetBoundingBox();
 
@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <functional>
+
+#include "WavefrontRenderer.h"
+#include "Scene.h"
+#include "Image.h"
+#include "IShader.h"
+#include "ThreadPool.h"
+
+using namespace std;
+using namespace sivelab;
+
+
+const int WavefrontRenderer::TILE_SIZE;
+
+
+WavefrontRenderer::WavefrontRenderer(Scene* scene)
+{
+	m_scene = scene;
+}
+
+
+/**
+ * Everything needed for a thread to render a single tile.
+ */
+struct WavefrontTileInfo
+{
+	Scene *scene;
+	Image *outputImage;
+	Image *sampleCountImage;
+	const vector<bool> *pixelMask;
+	int startX, startY, width, height;
+};
+
+
+/**
+ * Renders a single tile.
+ * @param info Pointer to the WavefrontTileInfo structure for the tile.
+ */
+void *RenderWavefrontTile(void *info)
+{
+	WavefrontTileInfo *tileInfo = (WavefrontTileInfo*)info;
+
+	// Each tile gets its own renderer, so that no queues are shared between threads.
+	WavefrontRenderer renderer(tileInfo->scene);
+	renderer.RenderTile(*tileInfo->outputImage, tileInfo->startX, tileInfo->startY, tileInfo->width, tileInfo->height, tileInfo->sampleCountImage, tileInfo->pixelMask);
+
+	return (NULL);
+}
+
+
+void WavefrontRenderer::Render(Image& image, int threadCount, Image *sampleCounts, const vector<bool> *pixelMask)
+{
+	int imageWidth = image.GetWidth();
+	int imageHeight = image.GetHeight();
+
+	// Tell the camera how big the image is.
+	m_scene->m_camera->SetImageDimensions(imageWidth, imageHeight);
+
+	// Divide the image up into tiles.
+	vector<WavefrontTileInfo> tiles;
+	for (int y = 0; y < imageHeight; y += TILE_SIZE)
+	{
+		for (int x = 0; x < imageWidth; x += TILE_SIZE)
+		{
+			WavefrontTileInfo tile;
+			tile.scene = m_scene;
+			tile.outputImage = &image;
+			tile.sampleCountImage = sampleCounts;
+			tile.pixelMask = pixelMask;
+			tile.startX = x;
+			tile.startY = y;
+			tile.width = min(TILE_SIZE, imageWidth - x);
+			tile.height = min(TILE_SIZE, imageHeight - y);
+			tiles.push_back(tile);
+		}
+	}
+
+	if (threadCount == 1)
+	{
+		for (size_t i = 0; i < tiles.size(); i++)
+		{
+			RenderWavefrontTile(&tiles[i]);
+		}
+	}
+	else
+	{
+		ThreadEngine::ThreadPool renderPool(threadCount);
+		renderPool.StartProcessing();
+
+		// Add a job to the pool for each tile.
+		renderPool.AddJobs(RenderWavefrontTile, tiles);
+
+		// Wait for all jobs to be completed.
+		renderPool.JoinAll();
+	}
+}
+
+
+void WavefrontRenderer::RenderTile(Image& image, int startX, int startY, int width, int height, Image *sampleCounts, const vector<bool> *pixelMask)
+{
+	int imageWidth = image.GetWidth();
+	int pixelCount = width * height;
+	m_pixelColors.assign(pixelCount, Color());
+	m_pixelLuminance.assign(pixelCount, RunningVariance());
+	m_pixelSamples.resize(pixelCount);
+	m_pixelRays.resize(pixelCount);
+	m_activePixels.clear();
+
+	// Generate every primary ray in the tile.
+	for (int localY = 0; localY < height; localY++)
+	{
+		for (int localX = 0; localX < width; localX++)
+		{
+			int pixel = localY * width + localX;
+			if ((pixelMask != NULL) && !(*pixelMask)[(startY + localY) * imageWidth + startX + localX])
+			{
+				continue;
+			}
+
+			// Each ray's path gets its own area light sample.
+			m_scene->GeneratePixelSamples(startX + localX, startY + localY, m_pixelRays[pixel], m_pixelSamples[pixel]);
+			m_activePixels.push_back(pixel);
+		}
+	}
+
+	m_batchSize = m_scene->GetSampleBatchSize(m_scene->m_camera->GetSamplesPerPixel());
+
+	// Keep taking samples until every pixel is done.
+	while (!m_activePixels.empty())
+	{
+		StartRound();
+		TraceRound();
+		FinishRound();
+	}
+
+	// Save colors to the image.  Flip Y, because we are rendering upside down.
+	int imageHeight = image.GetHeight();
+	for (int localY = 0; localY < height; localY++)
+	{
+		for (int localX = 0; localX < width; localX++)
+		{
+			int pixel = localY * width + localX;
+			if ((pixelMask != NULL) && !(*pixelMask)[(startY + localY) * imageWidth + startX + localX])
+			{
+				continue;
+			}
+
+			int sampleCount = m_pixelLuminance[pixel].GetCount();
+			int imageX = startX + localX;
+			int imageY = imageHeight - 1 - (startY + localY);
+
+			// Take average of each ray's color.
+			Color color = m_pixelColors[pixel];
+			color.LinearMult(1.0 / sampleCount);
+			image.SetPixel(imageX, imageY, color);
+
+			if (sampleCounts != NULL)
+			{
+				sampleCounts->SetPixel(imageX, imageY, Scene::GetSampleCountColor(sampleCount, m_pixelRays[pixel].size()));
+			}
+		}
+	}
+}
+
+
+void WavefrontRenderer::StartRound()
+{
+	m_rays.clear();
+	m_slotColors.clear();
+	m_slotPixels.clear();
+
+	for (size_t i = 0; i < m_activePixels.size(); i++)
+	{
+		int pixel = m_activePixels[i];
+		const RayList &rayList = m_pixelRays[pixel];
+		int firstSample = m_pixelLuminance[pixel].GetCount();
+		int endSample = min((int)rayList.size(), firstSample + m_batchSize);
+
+		for (int sample = firstSample; sample < endSample; sample++)
+		{
+			PathRay pathRay;
+			pathRay.ray = rayList[sample];
+			pathRay.pixel = pixel;
+			pathRay.slot = m_slotColors.size();
+			pathRay.sample = sample;
+			pathRay.weight = Color(1.0, 1.0, 1.0);
+			pathRay.allowedReflectionCount = Scene::DEFAULT_REFLECTION_DEPTH;
+			m_rays.push_back(pathRay);
+
+			m_slotColors.push_back(Color());
+			m_slotPixels.push_back(pixel);
+		}
+	}
+}
+
+
+void WavefrontRenderer::TraceRound()
+{
+	// Keep going until every path has terminated.
+	while (!m_rays.empty())
+	{
+		TraceRays();
+
+		m_nextRays.clear();
+		m_shadowRays.clear();
+		ShadeHits();
+
+		TraceShadowRays();
+
+		m_rays.swap(m_nextRays);
+	}
+}
+
+
+void WavefrontRenderer::FinishRound()
+{
+	for (size_t slot = 0; slot < m_slotColors.size(); slot++)
+	{
+		int pixel = m_slotPixels[slot];
+		m_pixelColors[pixel].AddColors(m_slotColors[slot]);
+		m_pixelLuminance[pixel].Add(m_slotColors[slot].GetLuminance());
+	}
+
+	// Only keep the pixels that still need samples.
+	size_t keptCount = 0;
+	for (size_t i = 0; i < m_activePixels.size(); i++)
+	{
+		int pixel = m_activePixels[i];
+		const RunningVariance &luminance = m_pixelLuminance[pixel];
+		if ((luminance.GetCount() < (int)m_pixelRays[pixel].size()) && !m_scene->IsPixelConverged(luminance))
+		{
+			m_activePixels[keptCount++] = pixel;
+		}
+	}
+	m_activePixels.resize(keptCount);
+}
+
+
+/**
+ * Orders ray indices by the shader that was hit, so that each shader's hits are shaded together.
+ * Ties are broken by index, so the order does not depend on the sorting algorithm.
+ */
+struct CompareByShader
+{
+	CompareByShader(const vector<IShader*> &shaders) : m_shaders(shaders) { }
+
+	bool operator()(int a, int b) const
+	{
+		if (m_shaders[a] != m_shaders[b])
+		{
+			return (less<IShader*>()(m_shaders[a], m_shaders[b]));
+		}
+		return (a < b);
+	}
+
+	const vector<IShader*> &m_shaders;
+};
+
+
+void WavefrontRenderer::TraceRays()
+{
+	size_t rayCount = m_rays.size();
+	m_hits.resize(rayCount);
+	m_hitShaders.resize(rayCount);
+	m_hitOrder.clear();
+
+	for (size_t i = 0; i < rayCount; i++)
+	{
+		// Rays that hit nothing add the background color, which is black.
+		if (m_scene->CastRay(m_rays[i].ray, m_hits[i]))
+		{
+			m_hitShaders[i] = m_hits[i].object->GetShader();
+			m_hitOrder.push_back(i);
+		}
+	}
+
+	sort(m_hitOrder.begin(), m_hitOrder.end(), CompareByShader(m_hitShaders));
+}
+
+
+void WavefrontRenderer::ShadeHits()
+{
+	for (size_t i = 0; i < m_hitOrder.size(); i++)
+	{
+		int rayIndex = m_hitOrder[i];
+		const PathRay &pathRay = m_rays[rayIndex];
+		Intersection &hit = m_hits[rayIndex];
+		IShader *shader = m_hitShaders[rayIndex];
+		Color &slotColor = m_slotColors[pathRay.slot];
+		const PixelSampler &pixelSamples = m_pixelSamples[pathRay.pixel];
+		PixelSampler samples = pixelSamples;
+		samples.SetCurrentSample(pathRay.sample);
+		int bounce = Scene::DEFAULT_REFLECTION_DEPTH - pathRay.allowedReflectionCount;
+
+		// Give the hit the path's samples, since shaders use them to pick lights, and to trace their own rays.
+		hit.allowedReflectionCount = pathRay.allowedReflectionCount;
+		hit.samples = &samples;
+
+		m_terms.Clear();
+		if (shader->Decompose(hit, m_terms) == false)
+		{
+			// This shader has to trace its own rays.
+			Color color = shader->Shade(hit);
+			color.MultiplyColors(pathRay.weight);
+			slotColor.AddColors(color);
+			continue;
+		}
+
+		// Add the part that doesn't need any more rays.
+		Color base = m_terms.base;
+		base.MultiplyColors(pathRay.weight);
+		slotColor.AddColors(base);
+
+		// Queue up a shadow ray for each light.
+		Vector3D intersectPoint = hit.collidedRay.GetPositionAtTime(hit.t);
+		Sample lightSample = pixelSamples.GetSample(pathRay.sample, GetSampleDimension(SAMPLE_AREA_LIGHT, bounce));
+		for (size_t j = 0; j < m_terms.lights.size(); j++)
+		{
+			const LightTerm &term = m_terms.lights[j];
+			ShadowRay shadowRay;
+			shadowRay.ray = m_scene->GetShadowRay(*term.light, intersectPoint, lightSample);
+			shadowRay.slot = pathRay.slot;
+			shadowRay.weight = term.contribution;
+			shadowRay.weight.MultiplyColors(pathRay.weight);
+			m_shadowRays.push_back(shadowRay);
+		}
+
+		// Queue up the reflection for the next pass.
+		if (m_terms.reflects)
+		{
+			Color reflectedWeight = m_terms.reflectance;
+			reflectedWeight.MultiplyColors(pathRay.weight);
+
+			if (pathRay.allowedReflectionCount <= 0)
+			{
+				// We have bounced around too much.
+				Color limitColor = Scene::GetReflectionLimitColor();
+				limitColor.MultiplyColors(reflectedWeight);
+				slotColor.AddColors(limitColor);
+			}
+			else if ((m_scene->RouletteThreshold <= 0.0) ||
+				m_scene->ContinuePath(reflectedWeight, samples.GetCurrentSample(GetSampleDimension(SAMPLE_ROULETTE, bounce))))
+			{
+				// The path survived Russian roulette, if it is being played.
+				PathRay reflected;
+				Sample glossSample = pixelSamples.GetSample(pathRay.sample, GetSampleDimension(SAMPLE_GLOSS, bounce));
+				reflected.ray = m_scene->GetReflectionRay(hit, m_terms.roughness, glossSample);
+				reflected.pixel = pathRay.pixel;
+				reflected.slot = pathRay.slot;
+				reflected.sample = pathRay.sample;
+				reflected.weight = reflectedWeight;
+				reflected.allowedReflectionCount = pathRay.allowedReflectionCount - 1;
+				m_nextRays.push_back(reflected);
+			}
+		}
+	}
+}
+
+
+void WavefrontRenderer::TraceShadowRays()
+{
+	HitRecord unused;
+	for (size_t i = 0; i < m_shadowRays.size(); i++)
+	{
+		const ShadowRay &shadowRay = m_shadowRays[i];
+
+		// Cast ray into scene with max t of 1.0, so that objects beyond the light are not taken into account.
+		if (m_scene->CastRay(shadowRay.ray, unused, 1.0) == false)
+		{
+			m_slotColors[shadowRay.slot].AddColors(shadowRay.weight);
+		}
+	}
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <vector>
+
+#include "Ray.h"
+#include "Color.h"
+#include "Intersection.h"
+#include "ICamera.h"
+#include "ShadingTerms.h"
+#include "RunningVariance.h"
+
+class Scene;
+class Image;
+class IShader;
+
+
+/**
+ * Renders a scene one tile at a time, by tracing all of the tile's rays in large batches.
+ * Every primary ray in the tile is traced, then the hits are sorted by shader and shaded in batches.
+ * Shading produces a queue of shadow rays and a queue of reflection rays, which are traced in turn,
+ * and this repeats until there are no more reflection rays.
+ * This keeps the traversal and the shading code from evicting each other from the cache.
+ * With adaptive sampling, the tile is rendered in rounds, and each round only takes more samples in the pixels that have not converged.
+ */
+class WavefrontRenderer
+{
+public:
+	/**
+	 * Sets up the renderer to render the given scene.
+	 */
+	WavefrontRenderer(Scene *scene);
+
+	/**
+	 * Renders the entire scene to the given image.
+	 * @param image The image to render to.
+	 * @param threadCount The number of threads to render with.  Must be at least 1.
+	 * @param sampleCounts If not NULL, the number of samples taken in each pixel is written here.  See Scene::Render().
+	 * @param pixelMask If not NULL, only the pixels that are true are rendered.  Indexed by y * width + x, where y is not flipped.
+	 */
+	void Render(Image &image, int threadCount, Image *sampleCounts, const std::vector<bool> *pixelMask);
+
+	/**
+	 * Renders a single tile of the image.
+	 * Not threadsafe, since the ray queues belong to the renderer.  Use one renderer per thread.
+	 * @param image The image to render to.
+	 * @param startX The x-coordinate of the left side of the tile.
+	 * @param startY The y-coordinate of the bottom of the tile, in camera space.
+	 * @param width The width of the tile.
+	 * @param height The height of the tile.
+	 * @param sampleCounts If not NULL, the number of samples taken in each pixel is written here.
+	 * @param pixelMask If not NULL, only the pixels that are true are rendered.
+	 */
+	void RenderTile(Image &image, int startX, int startY, int width, int height, Image *sampleCounts, const std::vector<bool> *pixelMask);
+
+	/**
+	 * The width and height of each tile, in pixels.
+	 */
+	static const int TILE_SIZE = 32;
+
+private:
+	/**
+	 * A ray that is part of a path through a single pixel.
+	 */
+	struct PathRay
+	{
+		Ray ray;
+
+		/**
+		 * The index of the pixel in the tile that this ray belongs to.
+		 */
+		int pixel;
+
+		/**
+		 * The index of the sample in this round that the ray's color is added to.
+		 */
+		int slot;
+
+		/**
+		 * The index of the sample within the pixel that this path uses.
+		 */
+		int sample;
+
+		/**
+		 * What the color found by this ray gets multiplied by before being added to its slot.
+		 */
+		Color weight;
+
+		/**
+		 * The number of reflections the path is still allowed to make.
+		 */
+		int allowedReflectionCount;
+	};
+
+	/**
+	 * A shadow ray, and what it adds to its pixel if it makes it to the light.
+	 */
+	struct ShadowRay
+	{
+		Ray ray;
+		int slot;
+		Color weight;
+	};
+
+	/**
+	 * Queues up the next batch of primary rays for every active pixel, giving each ray its own slot.
+	 */
+	void StartRound();
+
+	/**
+	 * Traces every queued ray until every path has terminated.
+	 */
+	void TraceRound();
+
+	/**
+	 * Adds the color of every slot to its pixel, and removes the pixels that are done from the active list.
+	 */
+	void FinishRound();
+
+	/**
+	 * Intersects every ray in m_rays with the scene.
+	 * Fills m_hits, and puts the index of every ray that hit something in m_hitOrder, sorted by shader.
+	 */
+	void TraceRays();
+
+	/**
+	 * Shades every hit in m_hitOrder, adding to the slot colors, and filling the shadow and next ray queues.
+	 */
+	void ShadeHits();
+
+	/**
+	 * Traces every ray in the shadow queue, adding the unshadowed ones to their slots.
+	 */
+	void TraceShadowRays();
+
+	Scene *m_scene;
+
+	/**
+	 * The state of each pixel in the tile currently being rendered.
+	 */
+	std::vector<Color> m_pixelColors;
+	std::vector<RunningVariance> m_pixelLuminance;
+	std::vector<PixelSampler> m_pixelSamples;
+	std::vector<RayList> m_pixelRays;
+	std::vector<int> m_activePixels;
+	int m_batchSize;
+
+	/**
+	 * The color of each sample being taken in the current round, and the pixel it belongs to.
+	 */
+	std::vector<Color> m_slotColors;
+	std::vector<int> m_slotPixels;
+
+	/**
+	 * The ray queues of the current round.
+	 */
+	std::vector<PathRay> m_rays;
+	std::vector<PathRay> m_nextRays;
+	std::vector<ShadowRay> m_shadowRays;
+	std::vector<Intersection> m_hits;
+	std::vector<IShader*> m_hitShaders;
+	std::vector<int> m_hitOrder;
+	ShadingTerms m_terms;
+};
@@ -0,0 +1,112 @@
+#include "BoundedQueue.h"
+
+using namespace ThreadEngine;
+
+
+BoundedQueue::BoundedQueue(size_t capacity)
+{
+	size_t size = 2;
+	while (size < capacity)
+	{
+		size *= 2;
+	}
+
+	m_slots = new Slot[size];
+	m_mask = size - 1;
+
+	// Slot i is ready to be written by the push at position i.
+	for (size_t i = 0; i < size; i++)
+	{
+		m_slots[i].sequence.store(i, std::memory_order_relaxed);
+		m_slots[i].item = NULL;
+	}
+
+	m_tail.store(0, std::memory_order_relaxed);
+	m_head.store(0, std::memory_order_relaxed);
+}
+
+
+BoundedQueue::~BoundedQueue()
+{
+	delete[] m_slots;
+}
+
+
+bool BoundedQueue::TryPush(void *item)
+{
+	size_t position = m_tail.load(std::memory_order_relaxed);
+	while (true)
+	{
+		Slot &slot = m_slots[position & m_mask];
+		size_t sequence = slot.sequence.load(std::memory_order_acquire);
+		ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)position;
+
+		if (difference == 0)
+		{
+			// The slot is free.  Claim it, unless another thread beat us to it.
+			if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				slot.item = item;
+				slot.sequence.store(position + 1, std::memory_order_release);
+				return (true);
+			}
+		}
+		else if (difference < 0)
+		{
+			// The slot still holds the item from the last trip around, so the queue is full.
+			return (false);
+		}
+		else
+		{
+			// Another thread has pushed here already.
+			position = m_tail.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+
+bool BoundedQueue::TryPop(void *&item)
+{
+	size_t position = m_head.load(std::memory_order_relaxed);
+	while (true)
+	{
+		Slot &slot = m_slots[position & m_mask];
+		size_t sequence = slot.sequence.load(std::memory_order_acquire);
+		ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)(position + 1);
+
+		if (difference == 0)
+		{
+			// The slot has been written.  Claim it, unless another thread beat us to it.
+			if (m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				item = slot.item;
+
+				// Free the slot up for the push on the next trip around.
+				slot.sequence.store(position + m_mask + 1, std::memory_order_release);
+				return (true);
+			}
+		}
+		else if (difference < 0)
+		{
+			// Nothing has been pushed here yet, so the queue is empty.
+			return (false);
+		}
+		else
+		{
+			// Another thread has popped from here already.
+			position = m_head.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+
+bool BoundedQueue::IsEmpty() const
+{
+	return (m_head.load(std::memory_order_acquire) >= m_tail.load(std::memory_order_acquire));
+}
+
+
+size_t BoundedQueue::GetCapacity() const
+{
+	return (m_mask + 1);
+}
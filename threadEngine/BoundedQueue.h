@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+
+namespace ThreadEngine
+{
+
+/**
+ * A first in, first out queue of pointers with a fixed number of slots, that any number of threads can push to and pop from at once without locking.
+ * Each slot carries a sequence number that says whether it is ready to be written or read on the current trip around the ring,
+ * so pushing or popping is a single compare and swap on the tail or head, and threads only touch each other's slots when the queue is nearly empty or full.
+ */
+class BoundedQueue
+{
+public:
+	/**
+	 * Creates an empty queue.
+	 * @param capacity The most pointers the queue can hold.  Rounded up to a power of 2.
+	 */
+	BoundedQueue(size_t capacity);
+
+	~BoundedQueue();
+
+	/**
+	 * Adds a pointer to the tail of the queue.
+	 * @return False if the queue is full, in which case nothing is added.
+	 */
+	bool TryPush(void *item);
+
+	/**
+	 * Takes the pointer at the head of the queue.
+	 * @return False if the queue is empty, in which case item is not touched.
+	 */
+	bool TryPop(void *&item);
+
+	/**
+	 * Tests if the queue is empty.  Only a hint when other threads are using the queue.
+	 */
+	bool IsEmpty() const;
+
+	size_t GetCapacity() const;
+
+private:
+	BoundedQueue(const BoundedQueue &other);
+	BoundedQueue &operator=(const BoundedQueue &other);
+
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		void *item;
+	};
+
+	Slot *m_slots;
+	size_t m_mask;
+
+	/**
+	 * The positions that the next push and pop will use.  Kept on their own cache lines, so pushing and popping threads don't fight over them.
+	 */
+	alignas(64) std::atomic<size_t> m_tail;
+	alignas(64) std::atomic<size_t> m_head;
+};
+
+}
@@ -0,0 +1,213 @@
+#include "TaskGraph.h"
+
+using namespace ThreadEngine;
+
+
+Task::Task(TaskGraph *graph, const Function &function) : m_graph(graph), m_function(function)
+{
+	m_waitingOnCount = 1;
+	m_done = false;
+}
+
+
+/**
+ * Lets ThreadPool::RunJobsUntil() ask if a task is done.
+ */
+static bool IsTaskDone(void *task)
+{
+	return (((Task*)task)->IsDone());
+}
+
+
+void Task::Wait()
+{
+	// A finished task can be waited on after its graph is gone, so don't touch the graph unless we have to.
+	if (m_done.load())
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (m_error)
+		{
+			std::rethrow_exception(m_error);
+		}
+		return;
+	}
+
+	// If every pool thread slept here, nothing would be left to run the task we are waiting on, so pool threads run other jobs instead.
+	if (m_graph->m_pool.IsPoolThread())
+	{
+		m_graph->m_pool.RunJobsUntil(IsTaskDone, this);
+	}
+
+	std::unique_lock<std::mutex> lock(m_lock);
+	while (!m_done.load())
+	{
+		m_finished.wait(lock);
+	}
+
+	if (m_error)
+	{
+		std::rethrow_exception(m_error);
+	}
+}
+
+
+bool Task::IsDone() const
+{
+	return (m_done.load());
+}
+
+
+TaskGraph::TaskGraph(int threadCount) : m_pool(threadCount)
+{
+	m_threadCount = threadCount;
+	m_unfinishedCount = 0;
+	m_pool.StartProcessing();
+}
+
+
+TaskGraph::~TaskGraph()
+{
+	WaitAll();
+	m_pool.JoinAll();
+}
+
+
+TaskHandle TaskGraph::Add(const Task::Function &function, const std::vector<TaskHandle> &dependencies)
+{
+	TaskHandle task(new Task(this, function));
+
+	{
+		std::lock_guard<std::mutex> lock(m_unfinishedLock);
+		m_unfinishedCount++;
+	}
+
+	// The task may already be in an earlier dependency's list, which can write to m_error as soon as it finishes,
+	// so a failure found here is only stored under the task's own lock.
+	std::exception_ptr error;
+	for (size_t i = 0; i < dependencies.size(); i++)
+	{
+		Task *dependency = dependencies[i].get();
+		if (dependency == NULL)
+		{
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(dependency->m_lock);
+		if (!dependency->m_done.load())
+		{
+			// It will let us know when it is done.
+			dependency->m_dependents.push_back(task);
+			task->m_waitingOnCount++;
+		}
+		else if (dependency->m_error && !error)
+		{
+			error = dependency->m_error;
+		}
+	}
+
+	if (error)
+	{
+		std::lock_guard<std::mutex> lock(task->m_lock);
+		if (!task->m_error)
+		{
+			task->m_error = error;
+		}
+	}
+
+	// Drop the count we held while adding, and start the task if nothing else is holding it back.
+	if (--task->m_waitingOnCount == 0)
+	{
+		Schedule(task);
+	}
+
+	return (task);
+}
+
+
+void TaskGraph::WaitAll()
+{
+	std::unique_lock<std::mutex> lock(m_unfinishedLock);
+	while (m_unfinishedCount > 0)
+	{
+		m_allFinished.wait(lock);
+	}
+}
+
+
+int TaskGraph::GetThreadCount() const
+{
+	return (m_threadCount);
+}
+
+
+void TaskGraph::Schedule(const TaskHandle &task)
+{
+	m_pool.AddJob(RunTask, new TaskHandle(task));
+}
+
+
+void *TaskGraph::RunTask(void *info)
+{
+	TaskHandle *handle = (TaskHandle*)info;
+	TaskHandle task = *handle;
+	delete handle;
+
+	TaskGraph *graph = task->m_graph;
+
+	// Only run the task if everything it depends on succeeded.
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock(task->m_lock);
+		error = task->m_error;
+	}
+
+	if (!error)
+	{
+		try
+		{
+			task->m_function();
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+	}
+
+	// Let the function's captures go now, rather than whenever the last handle goes.
+	task->m_function = Task::Function();
+
+	std::vector<TaskHandle> dependents;
+	{
+		std::lock_guard<std::mutex> lock(task->m_lock);
+		task->m_error = error;
+		task->m_done = true;
+		dependents.swap(task->m_dependents);
+	}
+	task->m_finished.notify_all();
+	graph->m_pool.WakeWaitingThreads();
+
+	for (size_t i = 0; i < dependents.size(); i++)
+	{
+		if (error)
+		{
+			std::lock_guard<std::mutex> lock(dependents[i]->m_lock);
+			if (!dependents[i]->m_error)
+			{
+				dependents[i]->m_error = error;
+			}
+		}
+
+		if (--dependents[i]->m_waitingOnCount == 0)
+		{
+			graph->Schedule(dependents[i]);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(graph->m_unfinishedLock);
+		graph->m_unfinishedCount--;
+	}
+	graph->m_allFinished.notify_all();
+
+	return (NULL);
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "ThreadPool.h"
+
+namespace ThreadEngine
+{
+
+class TaskGraph;
+
+
+/**
+ * A piece of work in a TaskGraph, which starts once all of the tasks it depends on are done.
+ * If the task, or anything it depends on, throws an exception, the task is finished without being run, and the exception is rethrown by Wait().
+ */
+class Task
+{
+public:
+	typedef std::function<void()> Function;
+
+	/**
+	 * Blocks until the task is done.
+	 * Called from a job or task running in the graph's pool, other jobs are run while waiting, so that the pool can't run out of threads.
+	 * Must not be called once the graph is gone, unless the task is known to be done.
+	 * @throws The exception thrown by the task, or by a task it depends on.
+	 */
+	void Wait();
+
+	/**
+	 * Tests if the task is done, whether or not it succeeded.
+	 */
+	bool IsDone() const;
+
+private:
+	Task(TaskGraph *graph, const Function &function);
+	Task(const Task &other);
+	Task &operator=(const Task &other);
+
+	TaskGraph *m_graph;
+	Function m_function;
+
+	/**
+	 * The number of tasks that have to finish before this one can start, plus one while it is still being added.
+	 */
+	std::atomic<int> m_waitingOnCount;
+
+	/**
+	 * Everything below is guarded by m_lock.  m_done is also read without it, to see if there is any need to wait.
+	 */
+	std::mutex m_lock;
+	std::condition_variable m_finished;
+	std::atomic<bool> m_done;
+	std::exception_ptr m_error;
+	std::vector< std::shared_ptr<Task> > m_dependents;
+
+	friend class TaskGraph;
+};
+
+typedef std::shared_ptr<Task> TaskHandle;
+
+
+/**
+ * The result of a task, which can be waited for, or depended on by other tasks.
+ */
+template<typename T>
+class Future
+{
+public:
+	/**
+	 * Waits for the task, and gets its result.
+	 * @throws The exception thrown by the task, or by a task it depends on.
+	 */
+	T &Get()
+	{
+		m_task->Wait();
+		return (**m_result);
+	}
+
+	bool IsDone() const
+	{
+		return (m_task->IsDone());
+	}
+
+	/**
+	 * Gets the task that makes the result, so that other tasks can depend on it.
+	 */
+	operator TaskHandle() const
+	{
+		return (m_task);
+	}
+
+private:
+	TaskHandle m_task;
+	std::shared_ptr< std::unique_ptr<T> > m_result;
+
+	friend class TaskGraph;
+};
+
+
+/**
+ * Runs tasks on a thread pool, each as soon as the tasks it depends on are done, so that independent steps can overlap.
+ * Tasks can be added from any thread, including from inside other tasks.
+ */
+class TaskGraph
+{
+public:
+	/**
+	 * Starts the threads that the tasks will run on.
+	 */
+	TaskGraph(int threadCount = ThreadPool::GetNumberOfProcessors());
+
+	/**
+	 * Waits for every task to be done, whether or not it succeeded.
+	 */
+	~TaskGraph();
+
+	/**
+	 * Adds a task, which will start once every one of the given tasks is done.
+	 * @param function The work to do.
+	 * @param dependencies The tasks that have to be done first.  NULL handles are ignored.
+	 * @return The task, which can be waited on, or depended on by other tasks.
+	 */
+	TaskHandle Add(const Task::Function &function, const std::vector<TaskHandle> &dependencies = std::vector<TaskHandle>());
+
+	/**
+	 * Adds a task that makes a value, which will start once every one of the given tasks is done.
+	 */
+	template<typename T>
+	Future<T> Async(const std::function<T()> &function, const std::vector<TaskHandle> &dependencies = std::vector<TaskHandle>())
+	{
+		Future<T> future;
+		future.m_result = std::make_shared< std::unique_ptr<T> >();
+
+		std::shared_ptr< std::unique_ptr<T> > result = future.m_result;
+		future.m_task = Add([function, result]() { result->reset(new T(function())); }, dependencies);
+
+		return (future);
+	}
+
+	/**
+	 * Blocks until every task that has been added is done, whether or not it succeeded.
+	 */
+	void WaitAll();
+
+	int GetThreadCount() const;
+
+private:
+	/**
+	 * Hands a task whose dependencies are all done to the pool.
+	 */
+	void Schedule(const TaskHandle &task);
+
+	/**
+	 * Runs a task, then starts any of its dependents that were only waiting on it.
+	 * @param info A TaskHandle allocated with new, which is deleted.
+	 */
+	static void *RunTask(void *info);
+
+	ThreadPool m_pool;
+	int m_threadCount;
+
+	/**
+	 * The number of tasks that have been added, but are not done yet.
+	 */
+	std::mutex m_unfinishedLock;
+	std::condition_variable m_allFinished;
+	int m_unfinishedCount;
+
+	friend class Task;
+};
+
+}
@@ -1,88 +1,134 @@
+
 #include "ThreadPool.h"
+#include "WorkStealingDeque.h"
 
-#include <time.h>
 #include <thread>
 
 using namespace ThreadEngine;
 
 
+/**
+ * The number of jobs that can be waiting to be picked up from outside the pool, before they go into the overflow queue.
+ */
+const size_t SUBMITTED_JOB_SLOTS = 4096;
+
+
+/**
+ * A thread in the pool, and the jobs that have been added by the jobs it has run.
+ */
+struct ThreadEngine::PoolWorker
+{
+	ThreadPool *pool;
+	int index;
+	Thread thread;
+	WorkStealingDeque jobs;
+
+	// Set while the thread is looking for a job or running one, which might add more.
+	std::atomic<bool> busy;
+};
+
+
+/**
+ * The pool worker that the current thread is, if any.
+ */
+static thread_local PoolWorker *t_currentWorker = NULL;
+
+
 // Processes jobs.
 void *ThreadEngine::ProcessJobs(void *inData)
 {
-	ThreadPool *pool = (ThreadPool*)inData;
-	bool halt = false;
+	PoolWorker *worker = (PoolWorker*)inData;
+	ThreadPool *pool = worker->pool;
+	t_currentWorker = worker;
 
-	// This is the amount of time we will sleep in between checking for jobs when we don't have one.
-	const int SLEEP_TIME_MS = 10;
-
-	while (halt == false)
+	while (!pool->m_stopNow.load())
 	{
-		pool->m_jobListLock.Lock();
-		if (pool->m_jobs.size() > 0)
+		worker->busy = true;
+		Job *job = pool->FindJob(worker);
+		if (job != NULL)
 		{
-			// Get the next job off the queue.
-			Job job = pool->m_jobs.front();
-			pool->m_jobs.pop();
-			pool->m_jobListLock.Unlock();
-
-			// Process the job.
-			void *result = job.job(job.param);
-
-			if (job.onComplete != NULL)
-			{
-				job.onComplete(result);
-			}
+			ThreadPool::RunJob(job);
+			continue;
 		}
-		else
+
+		worker->busy = false;
+
+		// There is nothing to do, so go to sleep, unless a job was added after we looked, or we have been told to stop.
+		// Anything adding a job checks for sleeping threads after adding it, and we check for jobs after saying we are asleep,
+		// so at least one of us will see the other.
+		std::unique_lock<std::mutex> lock(pool->m_sleepLock);
+		pool->m_sleepingCount++;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		// When halting, keep waiting while any other thread is running a job, since it might add more.
+		bool hasJobs = pool->HasJobs();
+		bool stop = pool->m_stopNow.load() || (!hasJobs && pool->m_haltAfterProcessing.load() && !pool->IsAnyThreadBusy());
+		if (!hasJobs && !stop)
 		{
-			// If we got here, there is nothing in the queue.
-			if (pool->m_haltAfterProcessing)
-			{
-				// There is nothing in the queue, and we have been asked to stop after processing everything.
-				halt = true;
-			}
-			pool->m_jobListLock.Unlock();
-
-			// Sleep a bit here so that we don't hog CPU time while waiting for jobs.
-			std::this_thread::sleep_for(std::chrono::milliseconds(SLEEP_TIME_MS));
+			pool->m_wakeUp.wait(lock);
+		}
+
+		pool->m_sleepingCount--;
+		if (stop)
+		{
+			// Let the threads waiting on us see that we are done.
+			pool->m_wakeUp.notify_all();
+			break;
 		}
 	}
 
+	t_currentWorker = NULL;
 	return (NULL);
 }
 
 
-ThreadEngine::ThreadPool::ThreadPool(int threadCount)
+ThreadEngine::ThreadPool::ThreadPool(int threadCount) : m_submitted(SUBMITTED_JOB_SLOTS)
 {
+	m_overflowCount = 0;
+	m_sleepingCount = 0;
 	m_haltAfterProcessing = false;
+	m_stopNow = false;
 
 	for (int i = 0; i < threadCount; i++)
 	{
-		m_threads.push_back(new Thread());
+		PoolWorker *worker = new PoolWorker();
+		worker->pool = this;
+		worker->index = i;
+		worker->busy = false;
+		m_workers.push_back(worker);
 	}
 }
 
 
 ThreadEngine::ThreadPool::~ThreadPool()
 {
-	// Clear out all jobs.
-	m_jobListLock.Lock();
-	while (m_jobs.size() > 0)
+	// Stop the threads as soon as they are done with the jobs they are on.
+	m_stopNow = true;
+	StopThreads();
+
+	// Clear out all of the jobs that were never started.
+	void *job;
+	while (m_submitted.TryPop(job))
 	{
-		m_jobs.pop();
+		delete (Job*)job;
 	}
-	m_jobListLock.Unlock();
 
-	// Cancel all threads.
-	m_threadListLock.Lock();
-	for (int i = 0; i < m_threads.size(); i++)
+	while (!m_overflow.empty())
 	{
-		m_threads[i]->Cancel();
-		m_threads[i]->Join(NULL);
-		delete m_threads[i];
-		m_threads[i] = NULL;
+		delete m_overflow.front();
+		m_overflow.pop();
+	}
+
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		while (m_workers[i]->jobs.Pop(job))
+		{
+			delete (Job*)job;
+		}
+
+		delete m_workers[i];
+		m_workers[i] = NULL;
 	}
-	m_threadListLock.Unlock();
 }
 
 
@@ -95,12 +141,10 @@ int ThreadEngine::ThreadPool::GetNumberOfProcessors()
 void ThreadPool::StartProcessing()
 {
 	// Start each thread.
-	m_threadListLock.Lock();
-	for (int i = 0; i < m_threads.size(); i++)
+	for (size_t i = 0; i < m_workers.size(); i++)
 	{
-		m_threads[i]->Start(ProcessJobs, this);
+		m_workers[i]->thread.Start(ProcessJobs, m_workers[i]);
 	}
-	m_threadListLock.Unlock();
 }
 
 
@@ -109,25 +153,227 @@ void ThreadPool::JoinAll()
 {
 	// Tell the threads to return after all the jobs are done.
 	m_haltAfterProcessing = true;
+	StopThreads();
+}
+
+
+void ThreadPool::StopThreads()
+{
+	// Wake up every sleeping thread, so it can see why.  Taking the lock makes sure that any thread on its way to sleep is either
+	// already waiting, or will see the flag that was just set.
+	{
+		std::lock_guard<std::mutex> lock(m_sleepLock);
+	}
+	m_wakeUp.notify_all();
 
 	// Wait for each thread to join with us.
-	m_threadListLock.Lock();
-	for (int i = 0; i < m_threads.size(); i++)
+	for (size_t i = 0; i < m_workers.size(); i++)
 	{
-		m_threads[i]->Join(NULL);
+		m_workers[i]->thread.Join(NULL);
 	}
-	m_threadListLock.Unlock();
 }
 
 
 void ThreadEngine::ThreadPool::AddJob(ThreadEngine::Thread::UserFunction jobFunction, void* input, OnThreadComplete onCompletionFunction)
 {
-	// Lock down the queue.
-	m_jobListLock.Lock();
-	Job job;
-	job.job = jobFunction;
-	job.param = input;
-	job.onComplete = onCompletionFunction;
-	m_jobs.push(job);
-	m_jobListLock.Unlock();
+	AddJobs(jobFunction, input, 1, 0, onCompletionFunction);
+}
+
+
+void ThreadEngine::ThreadPool::AddJobs(ThreadEngine::Thread::UserFunction jobFunction, void *firstInput, size_t count, size_t stride, OnThreadComplete onCompletionFunction)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// Jobs added by one of our own threads go on its deque, and everything else goes through the ring.
+	PoolWorker *worker = t_currentWorker;
+	bool ownThread = (worker != NULL) && (worker->pool == this);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		Job *job = new Job();
+		job->job = jobFunction;
+		job->param = (char*)firstInput + i * stride;
+		job->onComplete = onCompletionFunction;
+
+		if (ownThread)
+		{
+			worker->jobs.Push(job);
+		}
+		else
+		{
+			Submit(job);
+		}
+	}
+
+	// Only wake up as many threads as there are jobs for.
+	WakeThreads(count > 1);
+}
+
+
+void ThreadPool::RunJobsUntil(DoneFunction isDone, void *context)
+{
+	PoolWorker *worker = t_currentWorker;
+	while (!isDone(context))
+	{
+		Job *job = FindJob(worker);
+		if (job != NULL)
+		{
+			RunJob(job);
+			continue;
+		}
+
+		// Sleep the same way an idle thread does, so that new jobs wake us up, and whoever makes isDone true
+		// either sees us asleep when it calls WakeWaitingThreads(), or we see that it is done.
+		std::unique_lock<std::mutex> lock(m_sleepLock);
+		m_sleepingCount++;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (!isDone(context) && !HasJobs())
+		{
+			m_wakeUp.wait(lock);
+		}
+
+		m_sleepingCount--;
+	}
+}
+
+
+void ThreadPool::WakeWaitingThreads()
+{
+	WakeThreads(true);
+}
+
+
+bool ThreadPool::IsPoolThread() const
+{
+	return ((t_currentWorker != NULL) && (t_currentWorker->pool == this));
+}
+
+
+void ThreadPool::RunJob(Job *job)
+{
+	// Process the job.
+	void *result = job->job(job->param);
+
+	if (job->onComplete != NULL)
+	{
+		job->onComplete(result);
+	}
+
+	delete job;
+}
+
+
+void ThreadPool::Submit(Job *job)
+{
+	// Once anything has overflowed, keep using the overflow queue until it has been emptied, so that jobs are still started in order.
+	if ((m_overflowCount.load() == 0) && m_submitted.TryPush(job))
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_overflowLock);
+	m_overflow.push(job);
+	m_overflowCount++;
+}
+
+
+Job *ThreadPool::FindJob(PoolWorker *worker)
+{
+	void *job;
+	if (worker->jobs.Pop(job))
+	{
+		return ((Job*)job);
+	}
+
+	if (m_submitted.TryPop(job))
+	{
+		return ((Job*)job);
+	}
+
+	if (m_overflowCount.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_overflowLock);
+		if (!m_overflow.empty())
+		{
+			Job *overflowJob = m_overflow.front();
+			m_overflow.pop();
+			m_overflowCount--;
+			return (overflowJob);
+		}
+	}
+
+	// Steal from the other threads, starting with the next one along, so that the thieves spread out.
+	size_t workerCount = m_workers.size();
+	for (size_t offset = 1; offset < workerCount; offset++)
+	{
+		PoolWorker *victim = m_workers[(worker->index + offset) % workerCount];
+		if (victim->jobs.Steal(job))
+		{
+			return ((Job*)job);
+		}
+	}
+
+	return (NULL);
+}
+
+
+bool ThreadPool::HasJobs()
+{
+	if (!m_submitted.IsEmpty() || (m_overflowCount.load() > 0))
+	{
+		return (true);
+	}
+
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		if (!m_workers[i]->jobs.IsEmpty())
+		{
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+
+bool ThreadPool::IsAnyThreadBusy()
+{
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		if (m_workers[i]->busy.load())
+		{
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+
+void ThreadPool::WakeThreads(bool all)
+{
+	// Pairs with the fence in ProcessJobs, so that either we see the sleeping thread, or it sees the new jobs.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_sleepingCount.load() == 0)
+	{
+		return;
+	}
+
+	// Taking the lock makes sure that a thread that has said it is going to sleep is waiting before it is notified.
+	{
+		std::lock_guard<std::mutex> lock(m_sleepLock);
+	}
+
+	if (all)
+	{
+		m_wakeUp.notify_all();
+	}
+	else
+	{
+		m_wakeUp.notify_one();
+	}
 }
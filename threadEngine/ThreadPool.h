@@ -2,13 +2,19 @@
 
 #include <vector>
 #include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stddef.h>
 
 #include "Thread.h"
 #include "Mutex.h"
+#include "BoundedQueue.h"
 
 namespace ThreadEngine
 {
 void *ProcessJobs(void *inData);
+struct PoolWorker;
 
 /**
  * The type of function that gets called whenever a job gets done.
@@ -32,6 +38,13 @@ struct Job
 };
 
 
+/**
+ * Runs jobs on a fixed set of threads.
+ * Jobs added from outside the pool go into a lock-free ring that every thread takes from.
+ * Jobs added by a job that is running in the pool go onto the bottom of that thread's own work stealing deque,
+ * where it can take them back without contention, and threads with nothing else to do steal from the tops of the others' deques,
+ * so jobs that spawn more jobs never all go through one lock.
+ */
 class ThreadPool
 {
 public:
@@ -42,8 +55,8 @@ public:
 	ThreadPool(int threadCount = GetNumberOfProcessors());
 
 	/**
-	 * Cancels any still-running threads before exiting.
-	 * This means that any jobs still in the queue will probably not get done.
+	 * Throws away any jobs that have not been started, and waits for the threads to finish the ones they are running.
+	 * Threads are never cancelled, so a job that never returns will keep the destructor from returning.
 	 */
 	~ThreadPool();
 
@@ -55,13 +68,60 @@ public:
 	/**
 	 * Adds a job to the queue.  It will be executed when any other jobs in front of it are completed.
 	 * Note that the jobFunction and onCompletionFunction will be called in a different thread than your application, so it is wise to use synchronization primitives when accessing shared memory.
-	 * @note Jobs are usually processed in the order they were added in.
+	 * @note Jobs added from outside the pool are usually started in the order they were added in.
+	 * Jobs added by a job running in the pool are usually started newest first by the same thread, and oldest first by any thread that steals them.
 	 * @param jobFunction A pointer to the function to call.
 	 * @param input The input the function will be called with. Defaults to NULL.
 	 * @param onCompletionFunction The function that will be called when the job completes.  Defaults to NULL.
 	 */
 	void AddJob(Thread::UserFunction jobFunction, void *input = NULL, OnThreadComplete onCompletionFunction = NULL);
 
+	/**
+	 * Adds a job for each of a number of inputs that are evenly spaced in memory, waking the threads up only once.
+	 * @param jobFunction A pointer to the function to call.
+	 * @param firstInput The input the first job will be called with.
+	 * @param count The number of jobs to add.
+	 * @param stride The number of bytes from each input to the next.
+	 * @param onCompletionFunction The function that will be called when each job completes.  Defaults to NULL.
+	 */
+	void AddJobs(Thread::UserFunction jobFunction, void *firstInput, size_t count, size_t stride, OnThreadComplete onCompletionFunction = NULL);
+
+	/**
+	 * Adds a job for each element of the vector, which is passed a pointer to its element.
+	 * The vector must not be resized until the jobs are done.
+	 */
+	template<typename T>
+	void AddJobs(Thread::UserFunction jobFunction, std::vector<T> &inputs, OnThreadComplete onCompletionFunction = NULL)
+	{
+		if (!inputs.empty())
+		{
+			AddJobs(jobFunction, &inputs[0], inputs.size(), sizeof(T), onCompletionFunction);
+		}
+	}
+
+	/**
+	 * The type of function that RunJobsUntil() asks if it can stop.
+	 */
+	typedef bool (*DoneFunction)(void *context);
+
+	/**
+	 * Runs waiting jobs on the calling thread until the given function says to stop, so that a job that has to wait for others can help with them.
+	 * When there is nothing to run, the thread sleeps with the idle threads, and is woken whenever jobs are added, or WakeWaitingThreads() is called.
+	 * Must be called from one of the pool's threads, and whatever makes the function return true must call WakeWaitingThreads() afterwards.
+	 */
+	void RunJobsUntil(DoneFunction isDone, void *context);
+
+	/**
+	 * Wakes up every sleeping thread, including the ones in RunJobsUntil(), so that they check whether they can stop.
+	 * Does nothing if no thread is asleep.
+	 */
+	void WakeWaitingThreads();
+
+	/**
+	 * Tests if the calling thread is one of the pool's threads.
+	 */
+	bool IsPoolThread() const;
+
 	/**
 	 * Starts the processing threads.  Jobs will now start to be executed.
 	 * @note Jobs can still safely be added after calling this function.
@@ -70,30 +130,82 @@ public:
 
 	/**
 	 * Blocks until all of the jobs in the queue have been processed.
+	 * Jobs that are running may still add more jobs, and those are waited for too.
 	 * @warning For a clean shutdown, this should be called before the destructor is invoked.
 	 */
 	void JoinAll();
 
 private:
 	/**
-	 * The list of jobs.
+	 * Tells the threads to stop, and waits for them.
+	 */
+	void StopThreads();
+
+	/**
+	 * Adds a job that is being added from outside the pool.
 	 */
-	std::queue<Job> m_jobs;
-	ThreadEngine::Mutex m_jobListLock;
+	void Submit(Job *job);
 
 	/**
-	 * The list of threads.
+	 * Runs a job, and deletes it.
 	 */
-	std::vector<ThreadEngine::Thread*> m_threads;
-	ThreadEngine::Mutex m_threadListLock;
+	static void RunJob(Job *job);
 
 	/**
-	 * This gets set to true if job processing should stop.
+	 * Finds a job for the given thread to run, from its own deque, then the jobs added from outside, then the other threads' deques.
+	 * @return The job, which the caller has to delete, or NULL if none were found.
 	 */
-	volatile bool m_haltAfterProcessing;
+	Job *FindJob(PoolWorker *worker);
+
+	/**
+	 * Tests if there are any jobs waiting anywhere.
+	 */
+	bool HasJobs();
+
+	/**
+	 * Tests if any thread is running a job, or looking for one.
+	 */
+	bool IsAnyThreadBusy();
+
+	/**
+	 * Wakes up sleeping threads after jobs have been added, if there are any.
+	 * @param all True to wake every thread, or false to wake just one.
+	 */
+	void WakeThreads(bool all);
+
+	/**
+	 * Jobs added from outside the pool.
+	 * Once the ring is full, they go in the overflow queue until it has been emptied.
+	 */
+	BoundedQueue m_submitted;
+	std::queue<Job*> m_overflow;
+	std::mutex m_overflowLock;
+	std::atomic<size_t> m_overflowCount;
+
+	/**
+	 * Threads that find nothing to do sleep on m_wakeUp.  The lock is only taken by threads going to sleep,
+	 * and by threads adding jobs while at least one other thread is asleep.
+	 */
+	std::mutex m_sleepLock;
+	std::condition_variable m_wakeUp;
+	std::atomic<int> m_sleepingCount;
+
+	/**
+	 * This gets set to true if the threads should stop once the queue is empty.
+	 */
+	std::atomic<bool> m_haltAfterProcessing;
+
+	/**
+	 * This gets set to true if the threads should stop without starting any more jobs.
+	 */
+	std::atomic<bool> m_stopNow;
+
+	/**
+	 * The threads, each with its own deque.  The list is only touched by the thread that owns the pool.
+	 */
+	std::vector<PoolWorker*> m_workers;
 
 	friend void *ProcessJobs(void *inData);
 };
 
 }
-
@@ -0,0 +1,152 @@
+#include "WorkStealingDeque.h"
+
+using namespace ThreadEngine;
+
+
+WorkStealingDeque::Array::Array(int64_t size)
+{
+	this->size = size;
+	slots = new std::atomic<void*>[size];
+}
+
+
+WorkStealingDeque::Array::~Array()
+{
+	delete[] slots;
+}
+
+
+void *WorkStealingDeque::Array::Get(int64_t index) const
+{
+	return (slots[index & (size - 1)].load(std::memory_order_relaxed));
+}
+
+
+void WorkStealingDeque::Array::Put(int64_t index, void *item)
+{
+	slots[index & (size - 1)].store(item, std::memory_order_relaxed);
+}
+
+
+WorkStealingDeque::WorkStealingDeque(int64_t capacity)
+{
+	int64_t size = 2;
+	while (size < capacity)
+	{
+		size *= 2;
+	}
+
+	m_top.store(0, std::memory_order_relaxed);
+	m_bottom.store(0, std::memory_order_relaxed);
+	m_array.store(new Array(size), std::memory_order_relaxed);
+}
+
+
+WorkStealingDeque::~WorkStealingDeque()
+{
+	delete m_array.load(std::memory_order_relaxed);
+	for (size_t i = 0; i < m_oldArrays.size(); i++)
+	{
+		delete m_oldArrays[i];
+	}
+}
+
+
+void WorkStealingDeque::Push(void *item)
+{
+	int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+	int64_t top = m_top.load(std::memory_order_acquire);
+	Array *array = m_array.load(std::memory_order_relaxed);
+
+	if (bottom - top > array->size - 1)
+	{
+		array = Grow(array, top, bottom);
+	}
+
+	array->Put(bottom, item);
+
+	// Make sure the item is there before a thief can see the new bottom.
+	m_bottom.store(bottom + 1, std::memory_order_release);
+}
+
+
+bool WorkStealingDeque::Pop(void *&item)
+{
+	// Claim the bottom item first, then see if a thief has got to it.
+	int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	Array *array = m_array.load(std::memory_order_relaxed);
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = m_top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		// It was already empty.
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return (false);
+	}
+
+	void *bottomItem = array->Get(bottom);
+	if (top == bottom)
+	{
+		// This is the last item, so we have to race the thieves for it the same way they race each other.
+		bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		if (!won)
+		{
+			return (false);
+		}
+	}
+
+	item = bottomItem;
+	return (true);
+}
+
+
+bool WorkStealingDeque::Steal(void *&item)
+{
+	while (true)
+	{
+		int64_t top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+		if (top >= bottom)
+		{
+			return (false);
+		}
+
+		Array *array = m_array.load(std::memory_order_acquire);
+		void *topItem = array->Get(top);
+		if (m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			item = topItem;
+			return (true);
+		}
+
+		// Another thread took the top item first, so try again with the next one.
+	}
+}
+
+
+bool WorkStealingDeque::IsEmpty() const
+{
+	int64_t bottom = m_bottom.load(std::memory_order_acquire);
+	int64_t top = m_top.load(std::memory_order_acquire);
+	return (top >= bottom);
+}
+
+
+WorkStealingDeque::Array *WorkStealingDeque::Grow(Array *array, int64_t top, int64_t bottom)
+{
+	Array *bigger = new Array(array->size * 2);
+	for (int64_t i = top; i < bottom; i++)
+	{
+		bigger->Put(i, array->Get(i));
+	}
+
+	m_oldArrays.push_back(array);
+	m_array.store(bigger, std::memory_order_release);
+
+	return (bigger);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace ThreadEngine
+{
+
+/**
+ * A Chase-Lev work stealing deque of pointers.
+ * One thread owns the deque, and pushes and pops at the bottom like a stack, without any locks or atomic read-modify-writes
+ * unless it is taking the last item.  Any other thread can steal from the top, which holds the oldest items.
+ * The deque grows as needed, and the arrays it grows out of are kept until it is destroyed, since a thief may still be reading one.
+ * A deque can be filled by one thread and handed to another to own, as long as something like starting a job comes between them.
+ */
+class WorkStealingDeque
+{
+public:
+	/**
+	 * Creates an empty deque.
+	 * @param capacity The number of items the deque has room for before it has to grow.  Rounded up to a power of 2.
+	 */
+	WorkStealingDeque(int64_t capacity = 256);
+
+	~WorkStealingDeque();
+
+	/**
+	 * Adds an item to the bottom of the deque.  Only the owning thread may call this.
+	 */
+	void Push(void *item);
+
+	/**
+	 * Takes the newest item from the bottom of the deque.  Only the owning thread may call this.
+	 * @return False if the deque is empty, in which case item is not touched.
+	 */
+	bool Pop(void *&item);
+
+	/**
+	 * Takes the oldest item from the top of the deque.  Any thread may call this.
+	 * @return False if the deque is empty, in which case item is not touched.
+	 */
+	bool Steal(void *&item);
+
+	/**
+	 * Tests if the deque is empty.  Only a hint when other threads are using the deque.
+	 */
+	bool IsEmpty() const;
+
+private:
+	WorkStealingDeque(const WorkStealingDeque &other);
+	WorkStealingDeque &operator=(const WorkStealingDeque &other);
+
+	/**
+	 * A ring of slots that the items live in.
+	 */
+	struct Array
+	{
+		Array(int64_t size);
+		~Array();
+
+		void *Get(int64_t index) const;
+		void Put(int64_t index, void *item);
+
+		int64_t size;
+		std::atomic<void*> *slots;
+	};
+
+	/**
+	 * Moves the items into an array twice as big.
+	 */
+	Array *Grow(Array *array, int64_t top, int64_t bottom);
+
+	/**
+	 * Top is only ever moved up, by thieves and by the owner taking the last item.  Bottom is only moved by the owner.
+	 */
+	alignas(64) std::atomic<int64_t> m_top;
+	alignas(64) std::atomic<int64_t> m_bottom;
+	std::atomic<Array*> m_array;
+
+	/**
+	 * Arrays that have been grown out of.  Only touched by the owner.
+	 */
+	std::vector<Array*> m_oldArrays;
+};
+
+}
@@ -1,5 +1,16 @@
 #include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <sched.h>
+#include <stdexcept>
 #include "ThreadPool.h"
+#include "BoundedQueue.h"
+#include "TaskGraph.h"
 
 using namespace ThreadEngine;
 
@@ -70,6 +81,206 @@ void *countReallyHigh(void *unused)
 }
 
 
+void *squareNumber(void *number)
+{
+	long long *value = (long long*)number;
+	*value = *value * *value;
+
+	return (NULL);
+}
+
+
+void *doNothing(void *unused)
+{
+	return (NULL);
+}
+
+
+/**
+ * Seconds since the given time.
+ */
+double secondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+	return (elapsed.count());
+}
+
+
+/**
+ * Pushes and pops through either a queue with a mutex, or a lock-free ring, to see how they hold up with many threads at once.
+ */
+struct QueueBenchmarkInfo
+{
+	std::queue<void*> *lockedQueue;
+	std::mutex *lock;
+	BoundedQueue *ring;
+	int itemCount;
+	std::atomic<int> *popCount;
+	int totalItems;
+};
+
+
+void *pushToLockedQueue(void *info)
+{
+	QueueBenchmarkInfo *bench = (QueueBenchmarkInfo*)info;
+	for (int i = 0; i < bench->itemCount; i++)
+	{
+		std::lock_guard<std::mutex> lock(*bench->lock);
+		bench->lockedQueue->push(bench);
+	}
+
+	return (NULL);
+}
+
+
+void *popFromLockedQueue(void *info)
+{
+	QueueBenchmarkInfo *bench = (QueueBenchmarkInfo*)info;
+	while (bench->popCount->load() < bench->totalItems)
+	{
+		bool popped = false;
+		{
+			std::lock_guard<std::mutex> lock(*bench->lock);
+			if (!bench->lockedQueue->empty())
+			{
+				bench->lockedQueue->pop();
+				popped = true;
+			}
+		}
+
+		if (popped)
+		{
+			(*bench->popCount)++;
+		}
+		else
+		{
+			sched_yield();
+		}
+	}
+
+	return (NULL);
+}
+
+
+void *pushToRing(void *info)
+{
+	QueueBenchmarkInfo *bench = (QueueBenchmarkInfo*)info;
+	for (int i = 0; i < bench->itemCount; i++)
+	{
+		while (!bench->ring->TryPush(bench))
+		{
+			sched_yield();
+		}
+	}
+
+	return (NULL);
+}
+
+
+void *popFromRing(void *info)
+{
+	QueueBenchmarkInfo *bench = (QueueBenchmarkInfo*)info;
+	while (bench->popCount->load() < bench->totalItems)
+	{
+		void *item;
+		if (bench->ring->TryPop(item))
+		{
+			(*bench->popCount)++;
+		}
+		else
+		{
+			sched_yield();
+		}
+	}
+
+	return (NULL);
+}
+
+
+/**
+ * Runs the given number of pushing and popping threads at once, and prints how many items got through each second.
+ */
+void benchmarkQueue(const char *name, Thread::UserFunction push, Thread::UserFunction pop, int threadCount, int itemsPerThread)
+{
+	std::queue<void*> lockedQueue;
+	std::mutex lock;
+	BoundedQueue ring(1024);
+	std::atomic<int> popCount(0);
+
+	QueueBenchmarkInfo bench;
+	bench.lockedQueue = &lockedQueue;
+	bench.lock = &lock;
+	bench.ring = &ring;
+	bench.itemCount = itemsPerThread;
+	bench.popCount = &popCount;
+	bench.totalItems = itemsPerThread * threadCount;
+
+	std::vector<Thread*> threads;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < threadCount; i++)
+	{
+		threads.push_back(new Thread());
+		threads.back()->Start(push, &bench);
+		threads.push_back(new Thread());
+		threads.back()->Start(pop, &bench);
+	}
+
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i]->Join(NULL);
+		delete threads[i];
+	}
+
+	double seconds = secondsSince(start);
+	printf("%s, %i pushing and %i popping threads: %.2f million items per second\n", name, threadCount, threadCount, bench.totalItems / seconds / 1e6);
+}
+
+
+std::atomic<int> g_jobsRun(0);
+ThreadPool *g_spawningPool = NULL;
+
+
+void *countJob(void *unused)
+{
+	g_jobsRun++;
+
+	return (NULL);
+}
+
+
+/**
+ * Adds a job to the pool from outside it, over and over.
+ */
+void *submitJobs(void *jobCount)
+{
+	int count = (int)(intptr_t)jobCount;
+	for (int i = 0; i < count; i++)
+	{
+		g_spawningPool->AddJob(countJob);
+	}
+
+	return (NULL);
+}
+
+
+/**
+ * Adds two more jobs with one less level to go, until the level gets to 0, like a parallel build of a binary tree.
+ */
+void *spawnTree(void *levels)
+{
+	g_jobsRun++;
+
+	intptr_t levelsLeft = (intptr_t)levels;
+	if (levelsLeft > 0)
+	{
+		g_spawningPool->AddJob(spawnTree, (void*)(levelsLeft - 1));
+		g_spawningPool->AddJob(spawnTree, (void*)(levelsLeft - 1));
+	}
+
+	return (NULL);
+}
+
+
 int main()
 {
 	int cpuCount = ThreadPool::GetNumberOfProcessors();
@@ -94,4 +305,142 @@ int main()
 	printf("Joined all threads in pool.\n");
 
 	printf("Count is %i\n", count);
+
+	// Add a whole batch of jobs at once, more than fit in the ring.
+	std::vector<long long> numbers(10000);
+	for (size_t i = 0; i < numbers.size(); i++)
+	{
+		numbers[i] = i;
+	}
+
+	ThreadPool squarePool(cpuCount);
+	squarePool.StartProcessing();
+	squarePool.AddJobs(squareNumber, numbers);
+	squarePool.JoinAll();
+
+	long long sum = 0;
+	for (size_t i = 0; i < numbers.size(); i++)
+	{
+		sum += numbers[i];
+	}
+	printf("Sum of squares is %lli, should be 333283335000\n", sum);
+
+	// Time how long an idle pool takes to pick up a single job, and finish.
+	const int LATENCY_RUNS = 100;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < LATENCY_RUNS; i++)
+	{
+		ThreadPool latencyPool(1);
+		latencyPool.StartProcessing();
+		latencyPool.AddJob(doNothing);
+		latencyPool.JoinAll();
+	}
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+	printf("Starting a pool, running one job, and joining took %.1f us on average\n", elapsed.count() / LATENCY_RUNS);
+
+	// See how the queues hold up with lots of threads pushing and popping at once.
+	const int ITEMS_PER_THREAD = 200000;
+	int benchmarkThreads = (cpuCount > 2) ? cpuCount : 2;
+	benchmarkQueue("Mutex and std::queue", pushToLockedQueue, popFromLockedQueue, benchmarkThreads, ITEMS_PER_THREAD);
+	benchmarkQueue("Lock-free ring", pushToRing, popFromRing, benchmarkThreads, ITEMS_PER_THREAD);
+
+	// Several threads adding jobs to the pool at once, from outside it.
+	{
+		g_jobsRun = 0;
+		ThreadPool submitPool(cpuCount);
+		g_spawningPool = &submitPool;
+		submitPool.StartProcessing();
+
+		std::vector<Thread*> submitters;
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < benchmarkThreads; i++)
+		{
+			submitters.push_back(new Thread());
+			submitters.back()->Start(submitJobs, (void*)(intptr_t)ITEMS_PER_THREAD);
+		}
+
+		for (size_t i = 0; i < submitters.size(); i++)
+		{
+			submitters[i]->Join(NULL);
+			delete submitters[i];
+		}
+
+		submitPool.JoinAll();
+		double seconds = secondsSince(start);
+		printf("%i threads adding jobs to the pool: ran %i jobs, %.2f million per second\n", benchmarkThreads, g_jobsRun.load(), g_jobsRun.load() / seconds / 1e6);
+	}
+
+	// Jobs adding more jobs from inside the pool.
+	{
+		const int TREE_LEVELS = 18;
+		g_jobsRun = 0;
+		ThreadPool spawnPool(cpuCount);
+		g_spawningPool = &spawnPool;
+		start = std::chrono::high_resolution_clock::now();
+		spawnPool.StartProcessing();
+		spawnPool.AddJob(spawnTree, (void*)(intptr_t)TREE_LEVELS);
+		spawnPool.JoinAll();
+		double seconds = secondsSince(start);
+		printf("Jobs spawning a tree of jobs: ran %i jobs, should be %i, %.2f million per second\n", g_jobsRun.load(), (2 << TREE_LEVELS) - 1, g_jobsRun.load() / seconds / 1e6);
+	}
+
+	g_spawningPool = NULL;
+
+	// Tasks that wait on each other, in a diamond: two halves are summed at once, then added together.
+	{
+		TaskGraph graph(cpuCount);
+		Future<long long> firstHalf = graph.Async<long long>([]()
+		{
+			long long sum = 0;
+			for (int i = 0; i < 500; i++)
+			{
+				sum += i;
+			}
+			return (sum);
+		});
+		Future<long long> secondHalf = graph.Async<long long>([]()
+		{
+			long long sum = 0;
+			for (int i = 500; i < 1000; i++)
+			{
+				sum += i;
+			}
+			return (sum);
+		});
+		Future<long long> total = graph.Async<long long>([firstHalf, secondHalf]() mutable
+		{
+			return (firstHalf.Get() + secondHalf.Get());
+		}, std::vector<TaskHandle>{firstHalf, secondHalf});
+		printf("Sum from tasks is %lli, should be 499500\n", total.Get());
+
+		// A failed task skips everything that depends on it, and its exception comes out of the last one.
+		TaskHandle failing = graph.Add([]() { throw std::runtime_error("task failed"); });
+		TaskHandle skipped = graph.Add([]() { printf("This should never be printed!\n"); }, std::vector<TaskHandle>(1, failing));
+		try
+		{
+			skipped->Wait();
+			printf("The failure was lost!\n");
+		}
+		catch (std::runtime_error &e)
+		{
+			printf("Caught \"%s\" from a task that depended on a failed one\n", e.what());
+		}
+	}
+
+	// A task that waits on one it added itself.  With one thread, the waiting thread has to run it,
+	// and with two, it has to sleep until the other thread is done with it.
+	for (int threads = 1; threads <= 2; threads++)
+	{
+		TaskGraph graph(threads);
+		Future<int> outer = graph.Async<int>([&graph]()
+		{
+			Future<int> inner = graph.Async<int>([]()
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				return (42);
+			});
+			return (inner.Get());
+		});
+		printf("Nested task on %i threads gave %i, should be 42\n", threads, outer.Get());
+	}
 }